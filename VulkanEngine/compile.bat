@@ -3,4 +3,11 @@ C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/simple_shader.frag -o shaders/simpl
 
 C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/point_light_shader.vert -o shaders/point_light_shader.vert.spv
 C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/point_light_shader.frag -o shaders/point_light_shader.frag.spv
+
+C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/gpu_driven.vert -o shaders/gpu_driven.vert.spv
+C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/gpu_cull.comp -o shaders/gpu_cull.comp.spv
+C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/depth_pyramid.comp -o shaders/depth_pyramid.comp.spv
+
+C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/depth_prepass.vert -o shaders/depth_prepass.vert.spv
+C:/VulkanSDK/1.3.236.0/Bin/glslc.exe shaders/depth_prepass.frag -o shaders/depth_prepass.frag.spv
 pause
\ No newline at end of file
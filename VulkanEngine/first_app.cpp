@@ -2,8 +2,15 @@
 #include "lve_camera.h"
 #include "keyboard_movement_controller.h"
 #include "lve_buffer.h"
+#include "lve_cpu_profiler.h"
+#include "lve_culling.h"
+#include "lve_draw_queue.h"
+#include "lve_light_clusters.h"
+#include "lve_parallel_recorder.h"
+#include "lve_shader_hot_reload.h"
 #include "systems/simple_render_system.h"
 #include "systems/point_light_system.h"
+#include "systems/gpu_driven_render_system.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -13,16 +20,36 @@
 #include <stdexcept>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
 
 namespace lve{
 
-	FirstApp::FirstApp() {
+	FirstApp::FirstApp(const Options& options) : _options{ options } {
 		globalPool = LveDescriptorPool::Builder(_lveDevice)
 			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
 			.build();
 
+		if (_options.benchmark) {
+			// the generated scene is all a benchmark renders, so results only depend on its settings
+			generateBenchmarkScene(_lveDevice, _options.benchmarkSettings, gameObjects);
+			return;
+		}
+
 		loadGameObjects();
+		if (_options.mixedStateScene) {
+			loadMixedStateObjects();
+		}
+		if (_options.stressObjects > 0) {
+			loadStressObjects(_options.stressObjects);
+		}
+		if (_options.stressLights > 0) {
+			loadStressLights(_options.stressLights);
+		}
 	}
 
 	FirstApp::~FirstApp() {}
@@ -39,69 +66,546 @@ namespace lve{
 
 		auto globalSetLayout = LveDescriptorSetLayout::Builder(_lveDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
 			.build();
 
+		LveLightClusters lightClusters{ _lveDevice };
 		std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		auto writeGlobalSet = [&](int frameIndex, bool allocate) {
+			auto bufferInfo = uboBuffers[frameIndex]->descriptorInfo();
+			auto lightInfo = lightClusters.lightBufferInfo(frameIndex);
+			auto clusterInfo = lightClusters.clusterBufferInfo(frameIndex);
+			auto indexInfo = lightClusters.indexBufferInfo(frameIndex);
+			LveDescriptorWriter writer(*globalSetLayout, *globalPool);
+			writer.writeBuffer(0, &bufferInfo)
+				.writeBuffer(1, &lightInfo)
+				.writeBuffer(2, &clusterInfo)
+				.writeBuffer(3, &indexInfo);
+			if (allocate) {
+				writer.build(globalDescriptorSets[frameIndex]);
+			}
+			else {
+				writer.overwrite(globalDescriptorSets[frameIndex]);
+			}
+		};
 		for (int i = 0; i < globalDescriptorSets.size(); ++i) {
-			auto bufferInfo = uboBuffers[i]->descriptorInfo();
-			LveDescriptorWriter(*globalSetLayout, *globalPool)
-				.writeBuffer(0, &bufferInfo)
-				.build(globalDescriptorSets[i]);
+			writeGlobalSet(i, true);
 		}
 
+		if (_options.dynamicResolution) {
+			if (_options.gpuDriven && _options.occlusionCulling) {
+				std::cerr << "Dynamic resolution disabled: occlusion culling renders to the swap chain depth images" << std::endl;
+			}
+			else {
+				lveRenderer.enableDynamicResolution(_options.resolutionSettings);
+			}
+		}
+
+		if (_options.gpuProfiler) {
+			bool pipelineStatistics = _options.gpuPipelineStatistics;
+			if (pipelineStatistics && _options.recordThreads > 0) {
+				std::cerr << "Pipeline statistics disabled: the main pass executes secondary command buffers" << std::endl;
+				pipelineStatistics = false;
+			}
+			lveRenderer.enableGpuProfiler(pipelineStatistics);
+		}
+
+		// declared before the systems so it is torn down after them, they unwatch their pipelines
+		// and wait for rebuilds using their layouts when they go
+		std::unique_ptr<LveShaderHotReloader> shaderHotReloader;
+		if (ENABLE_SHADER_HOT_RELOAD) {
+			shaderHotReloader = std::make_unique<LveShaderHotReloader>(pipelineCompiler);
+		}
+
+		// both systems queue their pipelines on the compiler's workers before either one waits
 		SimpleRenderSystem simpleRenderSystem{ 
-			_lveDevice, lveRenderer.getSwapchainRenderpass() ,
-			globalSetLayout->getDescriptorSetLayout()};
+			_lveDevice, pipelineCompiler, pipelineStateCache, lveRenderer.getPipelineTarget() ,
+			globalSetLayout->getDescriptorSetLayout(), _options.extendedDynamicState };
+		simpleRenderSystem.setDepthPrepassEnabled(_options.depthPrepass);
 
 		PointLightSystem pointLightSystem{
-			_lveDevice, lveRenderer.getSwapchainRenderpass() ,
+			_lveDevice, pipelineCompiler, lveRenderer.getPipelineTarget() ,
 			globalSetLayout->getDescriptorSetLayout() };
+		if (_options.perObjectLights) {
+			SimpleRenderSystem::ShaderVariant variant{};
+			variant.perObjectLights = true;
+			simpleRenderSystem.selectVariant(variant);
+			pointLightSystem.setLightBvhEnabled(true);
+		}
+
+		std::unique_ptr<GpuDrivenRenderSystem> gpuDrivenRenderSystem;
+		if (_options.gpuDriven) {
+			gpuDrivenRenderSystem = std::make_unique<GpuDrivenRenderSystem>(
+				_lveDevice, pipelineCompiler, lveRenderer.getPipelineTarget(),
+				globalSetLayout->getDescriptorSetLayout());
+			gpuDrivenRenderSystem->setReadbackEnabled(_options.readbackDraws);
+			gpuDrivenRenderSystem->setOcclusionCullingEnabled(_options.occlusionCulling);
+			if (_options.occlusionCulling && !lveRenderer.isDepthSampleable()) {
+				std::cerr << "Occlusion culling disabled: the depth format cannot be sampled" << std::endl;
+			}
+		}
+		std::unique_ptr<LveBenchmarkRecorder> benchmarkRecorder;
+		std::unique_ptr<LveBenchmarkCameraPath> benchmarkCameraPath;
+		uint64_t gpuFrameSamplesSeen = 0;
+		if (_options.benchmark) {
+			lveRenderer.enableGpuTiming();
+			benchmarkRecorder = std::make_unique<LveBenchmarkRecorder>(_options.benchmarkSettings);
+			benchmarkCameraPath = std::make_unique<LveBenchmarkCameraPath>(_options.benchmarkSettings);
+		}
+
+		std::unique_ptr<LveLatencyTest> latencyTest;
+		uint64_t latencySamplesSeen = 0;
+		if (_options.latencyTest) {
+			latencyTest = std::make_unique<LveLatencyTest>(
+				_options.latencyTestSettings, _lveDevice.getSwapChainSupport().presentModes);
+			std::cout << "Latency test: " << latencyTest->getConfigurationCount() << " configurations" << std::endl;
+			lveRenderer.setFramePacing(latencyTest->getPacing());
+		}
 
+		std::vector<VkDrawIndexedIndirectCommand> readbackDraws;
+		uint32_t depthTargetsGeneration = 0;
+		GpuDrivenRenderSystem::CullStats cullTotals{};
+		uint64_t culledFrames = 0;
+
+		if (shaderHotReloader) {
+			pipelineStateCache.watchShaders(*shaderHotReloader);
+			simpleRenderSystem.watchShaders(*shaderHotReloader);
+			pointLightSystem.watchShaders(*shaderHotReloader);
+			if (gpuDrivenRenderSystem) {
+				gpuDrivenRenderSystem->watchShaders(*shaderHotReloader);
+			}
+		}
 
         LveCamera camera{};
 
         auto viewerObject = LveGameObject::createGameObject();
 		viewerObject.transform.translation.z = -2.5f;
         KeyboardMovementController cameraController{};
+		LveObjectCuller objectCuller{};
+		LveDrawQueue drawQueue{};
+		std::unique_ptr<LveParallelRecorder> parallelRecorder;
+		if (_options.recordThreads > 0) {
+			parallelRecorder = std::make_unique<LveParallelRecorder>(_lveDevice, _options.recordThreads);
+		}
+		double recordMilliseconds = 0.0;
+		uint64_t recordedFrames = 0;
 
         auto currentTime = std::chrono::high_resolution_clock::now();
+		auto runStart = currentTime;
+		auto lastProfilerLog = currentTime;
+		bool prepassKeyWasDown = false;
+
+		LVE_PROFILE_THREAD("main");
+		auto& cpuProfiler = LveCpuProfiler::instance();
+		bool cpuTraceWritten = false;
+		if (_options.cpuTraceFrames > 0) {
+			cpuProfiler.startCapture(_options.cpuTraceFrames, _options.cpuTraceSkipFrames);
+		}
 
 		while (!_lveWindow.shouldClose()) {
-			glfwPollEvents();
+			// recordedFrames counts every frame that reached endFrame
+			if (_options.maxFrames > 0 && recordedFrames >= _options.maxFrames) {
+				break;
+			}
+			if (benchmarkRecorder && benchmarkRecorder->isComplete()) {
+				break;
+			}
+			if (latencyTest && latencyTest->isComplete()) {
+				break;
+			}
+			if (_options.maxSeconds > 0.0f && std::chrono::duration<float, std::chrono::seconds::period>(
+				std::chrono::high_resolution_clock::now() - runStart).count() >= _options.maxSeconds)
+			{
+				break;
+			}
+
+			// marks the end of the last frame, the capture starts and stops on these
+			LVE_PROFILE_FRAME();
+			LVE_PROFILE_ZONE("frame");
+			if (_options.cpuTraceFrames > 0 && !cpuTraceWritten && cpuProfiler.isCaptureComplete()) {
+				writeCpuTrace();
+				cpuTraceWritten = true;
+			}
         
             auto newTime = std::chrono::high_resolution_clock::now();
             auto frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
             currentTime = newTime;
+			double wallFrameMilliseconds = frameTime * 1000.0;
+			if (benchmarkRecorder) {
+				frameTime = BENCHMARK_FRAME_TIME;
+			}
+
+			// in low latency mode this waits for the GPU, the input is sampled as late as possible
+			auto inputWaitStart = std::chrono::high_resolution_clock::now();
+			lveRenderer.waitToSampleInput();
+			double inputWaitMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(
+				std::chrono::high_resolution_clock::now() - inputWaitStart).count();
+
+			// a headless run has no window to take input from
+			if (!_lveWindow.isHeadless()) {
+				LVE_PROFILE_ZONE("poll events");
+				glfwPollEvents();
+			}
+			// benchmarks take no input either, their camera follows the scripted path
+			if (!_lveWindow.isHeadless() && !benchmarkRecorder) {
+				// update viewer object
+				cameraController.moveInPlaneXZ(_lveWindow.getGLFWWindow(), frameTime, viewerObject);
 
-            // update viewer object
-            cameraController.moveInPlaneXZ(_lveWindow.getGLFWWindow(), frameTime, viewerObject);
-            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+				bool prepassKeyDown = glfwGetKey(_lveWindow.getGLFWWindow(), TOGGLE_DEPTH_PREPASS_KEY) == GLFW_PRESS;
+				if (prepassKeyDown && !prepassKeyWasDown) {
+					simpleRenderSystem.setDepthPrepassEnabled(!simpleRenderSystem.isDepthPrepassEnabled());
+					std::cout << "Depth pre-pass " << (simpleRenderSystem.isDepthPrepassEnabled() ? "on" : "off") << std::endl;
+				}
+				prepassKeyWasDown = prepassKeyDown;
+			}
+			if (benchmarkCameraPath) {
+				benchmarkCameraPath->apply(recordedFrames, lveRenderer.getAspectRatio(), camera);
+			}
+			else {
+				camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
-            float aspect = lveRenderer.getAspectRatio();
-            camera.setPerspectiveProjection(glm::radians(50.0f), aspect, .1f, 10.f);
+				float aspect = lveRenderer.getAspectRatio();
+				camera.setPerspectiveProjection(glm::radians(50.0f), aspect, .1f, 10.f);
+			}
 
+			auto beginFrameStart = std::chrono::high_resolution_clock::now();
 			if (auto commandBuffer = lveRenderer.beginFrame()) {
+				// waiting for the frame's fence and the next image is not CPU work of this frame
+				double beginFrameMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(
+					std::chrono::high_resolution_clock::now() - beginFrameStart).count();
+
+				if (shaderHotReloader) {
+					shaderHotReloader->update();
+				}
+
 				int frameIndex = lveRenderer.getFrameIndex();
 				FrameInfo frameInfo{ frameIndex, frameTime, commandBuffer,
 					camera , globalDescriptorSets[frameIndex], gameObjects};
+				frameInfo.gpuProfiler = lveRenderer.getGpuProfiler();
+				// the GPU-driven path culls on the GPU
+				if (!gpuDrivenRenderSystem) {
+					frameInfo.visibleObjects = &objectCuller.cull(camera.getFrustum(), gameObjects);
+				}
 
 				// update
 				GlobalUbo ubo{};
 				ubo.projectionMatrix = camera.getProjection();
 				ubo.viewMatrix = camera.getView();
-				pointLightSystem.update(frameInfo, ubo);
-				uboBuffers[frameIndex]->writeToBuffer(&ubo);
-				uboBuffers[frameIndex]->flush();
+				{
+					LVE_PROFILE_ZONE("update lights");
+					pointLightSystem.update(frameInfo);
+					frameInfo.lightBvh = pointLightSystem.getLightBvh();
+				}
+				{
+					LVE_PROFILE_ZONE("build light clusters");
+					if (lightClusters.build(frameIndex, camera, lveRenderer.getRenderExtent(), pointLightSystem.getLights(), ubo)) {
+						// the frame's fence has signalled, its set is no longer in use
+						writeGlobalSet(frameIndex, false);
+					}
+				}
+				{
+					LVE_PROFILE_ZONE("write UBO");
+					uboBuffers[frameIndex]->writeToBuffer(&ubo);
+					uboBuffers[frameIndex]->flush();
+				}
+
+				GpuDrivenRenderSystem::CullStats frameCullStats{};
+				if (gpuDrivenRenderSystem) {
+					LVE_PROFILE_ZONE("GPU-driven setup");
+					if (depthTargetsGeneration != lveRenderer.getSwapchainGeneration()) {
+						std::vector<VkImageView> depthViews;
+						if (lveRenderer.isDepthSampleable()) {
+							for (size_t i = 0; i < lveRenderer.getSwapchainImageCount(); ++i) {
+								depthViews.push_back(lveRenderer.getDepthImageView(static_cast<int>(i)));
+							}
+						}
+						gpuDrivenRenderSystem->setDepthTargets(lveRenderer.getSwapchainExtent(), depthViews);
+						depthTargetsGeneration = lveRenderer.getSwapchainGeneration();
+					}
+
+					// the fence of this frame index has signalled, its last draw list is complete
+					if (_options.readbackDraws) {
+						readbackDraws = gpuDrivenRenderSystem->readBackDrawList(frameIndex);
+					}
+					auto cullStats = gpuDrivenRenderSystem->readBackCullStats(frameIndex);
+					frameCullStats = cullStats;
+					if (cullStats.tested > 0) {
+						cullTotals.tested += cullStats.tested;
+						cullTotals.frustumCulled += cullStats.frustumCulled;
+						cullTotals.occlusionCulled += cullStats.occlusionCulled;
+						cullTotals.drawnEarly += cullStats.drawnEarly;
+						cullTotals.drawnLate += cullStats.drawnLate;
+						culledFrames++;
+					}
+					gpuDrivenRenderSystem->cull(frameInfo);
+				}
+
+				{
+					LVE_PROFILE_ZONE("submit draws");
+					drawQueue.begin();
+					if (!gpuDrivenRenderSystem) {
+						simpleRenderSystem.submit(frameInfo, drawQueue);
+					}
+					pointLightSystem.submit(frameInfo, drawQueue);
+				}
 
 				// render
-				lveRenderer.beginSwapchainRenderpass(commandBuffer);
-				simpleRenderSystem.renderGameObjects(frameInfo);
-				pointLightSystem.render(frameInfo);
-				lveRenderer.endSwapchainRenderpass(commandBuffer);
+				auto recordStart = std::chrono::high_resolution_clock::now();
+				bool occlusionCulling = gpuDrivenRenderSystem && gpuDrivenRenderSystem->isOcclusionCullingEnabled();
+				auto renderPassType = LveSwapChain::RENDER_PASS_MAIN;
+				if (occlusionCulling) {
+					// last frame's visible objects, the pyramid built from their depth culls the rest
+					{
+						LVE_PROFILE_ZONE("record early pass");
+						LveGpuScope earlyPassScope{ frameInfo.gpuProfiler, commandBuffer, "early pass" };
+						lveRenderer.beginSwapchainRenderpass(
+							commandBuffer, VK_SUBPASS_CONTENTS_INLINE, LveSwapChain::RENDER_PASS_EARLY);
+						gpuDrivenRenderSystem->renderGameObjects(frameInfo);
+						lveRenderer.endSwapchainRenderpass(commandBuffer);
+					}
+					gpuDrivenRenderSystem->cullOccluded(frameInfo, lveRenderer.getImageIndex());
+					renderPassType = LveSwapChain::RENDER_PASS_LATE;
+				}
+				auto renderGpuDriven = [&](FrameInfo& info) {
+					if (occlusionCulling) {
+						gpuDrivenRenderSystem->renderOccludedObjects(info);
+					}
+					else {
+						gpuDrivenRenderSystem->renderGameObjects(info);
+					}
+				};
+
+				{
+					LVE_PROFILE_ZONE("record main pass");
+					LveGpuScope mainPassScope{ frameInfo.gpuProfiler, commandBuffer, "main pass" };
+					if (parallelRecorder) {
+						lveRenderer.beginSwapchainRenderpass(
+							commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, renderPassType);
+						parallelRecorder->begin(frameIndex, lveRenderer.getPipelineTarget(),
+							lveRenderer.getCurrentFramebuffer(), lveRenderer.getRenderExtent());
+						if (gpuDrivenRenderSystem) {
+							parallelRecorder->record(1, [&](uint32_t, VkCommandBuffer secondary) {
+								FrameInfo secondaryInfo = frameInfo;
+								secondaryInfo.commandBuffer = secondary;
+								secondaryInfo.gpuProfiler = nullptr;
+								renderGpuDriven(secondaryInfo);
+							});
+						}
+						drawQueue.execute(frameInfo, *parallelRecorder);
+						parallelRecorder->execute(commandBuffer);
+					}
+					else {
+						lveRenderer.beginSwapchainRenderpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE, renderPassType);
+						if (gpuDrivenRenderSystem) {
+							renderGpuDriven(frameInfo);
+						}
+						drawQueue.execute(frameInfo);
+					}
+					lveRenderer.endSwapchainRenderpass(commandBuffer);
+				}
+				recordMilliseconds += std::chrono::duration<double, std::chrono::milliseconds::period>(
+					std::chrono::high_resolution_clock::now() - recordStart).count();
+				recordedFrames++;
 				lveRenderer.endFrame();
+
+				if (benchmarkRecorder) {
+					LveBenchmarkFrame benchmarkFrame{};
+					benchmarkFrame.cpuMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(
+						std::chrono::high_resolution_clock::now() - newTime).count()
+						- inputWaitMilliseconds - beginFrameMilliseconds;
+					benchmarkFrame.frameMilliseconds = wallFrameMilliseconds;
+					if (lveRenderer.getGpuFrameSampleCount() != gpuFrameSamplesSeen) {
+						gpuFrameSamplesSeen = lveRenderer.getGpuFrameSampleCount();
+						benchmarkFrame.gpuMilliseconds = lveRenderer.getGpuFrameMilliseconds();
+					}
+					if (gpuDrivenRenderSystem) {
+						// the counts arrive with the frame's fence, like the GPU time they belong to an earlier frame
+						uint32_t drawn = static_cast<uint32_t>(frameCullStats.drawnEarly + frameCullStats.drawnLate);
+						benchmarkFrame.drawCalls = gpuDrivenRenderSystem->getDrawCallCount();
+						benchmarkFrame.instances = drawn;
+						benchmarkFrame.culledTested = static_cast<uint32_t>(frameCullStats.tested);
+						benchmarkFrame.culledVisible = drawn;
+					}
+					else {
+						auto frameRenderStats = simpleRenderSystem.getRenderStats();
+						benchmarkFrame.drawCalls = frameRenderStats.drawCalls;
+						benchmarkFrame.instances = frameRenderStats.instances;
+						benchmarkFrame.culledTested = objectCuller.getStats().tested;
+						benchmarkFrame.culledVisible = objectCuller.getStats().visible;
+					}
+					auto& frameQueueStats = drawQueue.getStats();
+					benchmarkFrame.packets = frameQueueStats.packets;
+					benchmarkFrame.pipelineBinds = frameQueueStats.pipelineBinds;
+					benchmarkFrame.modelBinds = frameQueueStats.modelBinds;
+					benchmarkRecorder->addFrame(benchmarkFrame);
+				}
+
+				if (latencyTest && lveRenderer.getInputLatencySampleCount() != latencySamplesSeen) {
+					latencySamplesSeen = lveRenderer.getInputLatencySampleCount();
+					if (latencyTest->addFrame(lveRenderer.getInputToPresentMilliseconds(), wallFrameMilliseconds)
+						&& !latencyTest->isComplete())
+					{
+						lveRenderer.setFramePacing(latencyTest->getPacing());
+					}
+				}
+			}
+
+			auto* gpuProfiler = lveRenderer.getGpuProfiler();
+			if (gpuProfiler && _options.gpuProfilerLogSeconds > 0.0f && std::chrono::duration<float, std::chrono::seconds::period>(
+				currentTime - lastProfilerLog).count() >= _options.gpuProfilerLogSeconds)
+			{
+				gpuProfiler->writeReport(std::cout);
+				lastProfilerLog = currentTime;
+			}
+
+			for (const auto& decision : lveRenderer.takeResolutionDecisions()) {
+				std::cout << "Resolution scale " << decision.previousScale << " -> " << decision.scale
+					<< " after " << decision.frame << " measured frames, GPU average "
+					<< decision.averageMilliseconds << " ms" << std::endl;
 			}
 		}
+		// low latency pacing may have acquired the image of a frame the loop did not get to
+		lveRenderer.finishAcquiredFrame();
 		vkDeviceWaitIdle(_lveDevice.device());
+		double runSeconds = std::chrono::duration<double, std::chrono::seconds::period>(
+			std::chrono::high_resolution_clock::now() - runStart).count();
+
+		std::cout << "Frames (" << (_lveWindow.isHeadless() ? "headless" : "windowed") << "): "
+			<< recordedFrames << " in " << runSeconds << " s";
+		if (recordedFrames > 0) {
+			std::cout << ", " << runSeconds * 1000.0 / static_cast<double>(recordedFrames) << " ms/frame average";
+		}
+		std::cout << "\n";
+
+		auto& stateStats = pipelineStateCache.getStats();
+		std::cout << "Pipeline state cache: " << pipelineStateCache.size() << " pipelines, "
+			<< stateStats.hits << " hits, " << stateStats.misses << " misses, "
+			<< stateStats.compileMilliseconds << " ms compiling\n";
+
+		// the GPU-driven path reports its culling below
+		if (!gpuDrivenRenderSystem) {
+			std::cout << "Frustum culling (" << cullingKernelName() << "): "
+				<< objectCuller.getStats().visible << " of " << objectCuller.getStats().tested << " objects visible\n";
+		}
+
+		auto renderStats = simpleRenderSystem.getRenderStats();
+		std::cout << "Simple render system (extended dynamic state "
+			<< (simpleRenderSystem.usesExtendedDynamicState() ? "on" : "off") << ", depth pre-pass "
+			<< (simpleRenderSystem.isDepthPrepassEnabled() ? "on" : "off") << "): "
+			<< simpleRenderSystem.getPipelineCount() << " pipelines, last frame "
+			<< renderStats.instances << " instances in " << renderStats.drawCalls << " draws, "
+			<< renderStats.dynamicStateChanges << " dynamic state changes\n";
+
+		auto& queueStats = drawQueue.getStats();
+		std::cout << "Draw queue, last frame: " << queueStats.packets << " packets in " << queueStats.runs << " runs, "
+			<< queueStats.pipelineBinds << " pipeline binds (" << queueStats.pipelineBindsAvoided << " avoided), "
+			<< queueStats.modelBinds << " model binds (" << queueStats.modelBindsAvoided << " avoided)\n";
+
+		auto& clusterStats = lightClusters.getStats();
+		std::cout << "Light clusters, last frame: " << clusterStats.lights << " lights, "
+			<< clusterStats.lightIndices << " indices in " << clusterStats.occupiedClusters << " of "
+			<< LveLightClusters::CLUSTER_COUNT << " clusters, at most " << clusterStats.maxClusterLights
+			<< " per cluster, " << clusterStats.droppedLightIndices << " dropped\n";
+
+		if (auto* lightBvh = pointLightSystem.getLightBvh()) {
+			auto& bvhStats = lightBvh->getStats();
+			std::cout << "Light BVH, last frame: " << bvhStats.lights << " lights in " << bvhStats.nodes << " nodes, "
+				<< bvhStats.queries << " objects tested " << bvhStats.lightsTested << " lights and selected "
+				<< bvhStats.lightsSelected << " (at most " << SimpleRenderSystem::MAX_OBJECT_LIGHTS << " each)\n";
+		}
+
+		if (recordedFrames > 0) {
+			std::cout << "Render pass recording ("
+				<< (parallelRecorder ? std::to_string(parallelRecorder->getWorkerCount()) + " workers" : std::string("inline"))
+				<< "): " << recordMilliseconds / static_cast<double>(recordedFrames) << " ms/frame average\n";
+		}
+
+		if (auto* resolutionController = lveRenderer.getResolutionController()) {
+			auto extent = lveRenderer.getRenderExtent();
+			std::cout << "Dynamic resolution: scale " << resolutionController->getScale() << " ("
+				<< extent.width << "x" << extent.height << "), GPU average "
+				<< resolutionController->getAverageMilliseconds() << " ms over "
+				<< resolutionController->getSampleCount() << " measured frames\n";
+		}
+
+		if (auto* gpuProfiler = lveRenderer.getGpuProfiler()) {
+			gpuProfiler->writeReport(std::cout);
+		}
+
+		if (culledFrames > 0) {
+			auto average = [culledFrames](uint64_t total) { return total / static_cast<double>(culledFrames); };
+			std::cout << "GPU culling (occlusion "
+				<< (gpuDrivenRenderSystem->isOcclusionCullingEnabled() ? "on" : "off") << "), per frame average: "
+				<< average(cullTotals.tested) << " objects, "
+				<< average(cullTotals.frustumCulled) << " frustum culled, "
+				<< average(cullTotals.occlusionCulled) << " occlusion culled, "
+				<< average(cullTotals.drawnEarly) << " drawn early, "
+				<< average(cullTotals.drawnLate) << " drawn late\n";
+		}
+
+		if (benchmarkRecorder) {
+			writeBenchmarkReport(*benchmarkRecorder);
+		}
+
+		if (latencyTest) {
+			latencyTest->writeReport(std::cout);
+		}
+
+		if (_options.cpuTraceFrames > 0 && !cpuTraceWritten) {
+			// the run ended first, what was captured is still worth looking at
+			std::cerr << "CPU trace stopped before " << _options.cpuTraceFrames << " frames were captured" << std::endl;
+			writeCpuTrace();
+		}
+
+		if (gpuDrivenRenderSystem && _options.readbackDraws) {
+			std::cout << "GPU-driven: " << readbackDraws.size() << " draws written for "
+				<< gpuDrivenRenderSystem->getObjectCount() << " objects\n";
+			for (const auto& draw : readbackDraws) {
+				std::cout << "  indexCount " << draw.indexCount << ", firstIndex " << draw.firstIndex
+					<< ", vertexOffset " << draw.vertexOffset << ", object " << draw.firstInstance << "\n";
+			}
+		}
+	}
+
+	void FirstApp::writeBenchmarkReport(const LveBenchmarkRecorder& recorder)
+	{
+		LveBenchmarkEnvironment environment{};
+		environment.deviceName = _lveDevice.properties.deviceName;
+		environment.extent = lveRenderer.getSwapchainExtent();
+		environment.headless = _lveWindow.isHeadless();
+		environment.dynamicRendering = lveRenderer.usesDynamicRendering();
+		environment.gpuDriven = _options.gpuDriven;
+		environment.recordThreads = _options.recordThreads;
+		environment.memory = _lveDevice.queryMemoryUsage();
+
+		if (recorder.getMeasuredFrameCount() < _options.benchmarkSettings.frames) {
+			std::cerr << "Benchmark stopped after " << recorder.getMeasuredFrameCount() << " of "
+				<< _options.benchmarkSettings.frames << " measured frames" << std::endl;
+		}
+
+		const auto& outputPath = _options.benchmarkSettings.outputPath;
+		if (outputPath.empty()) {
+			recorder.writeReport(std::cout, environment);
+			return;
+		}
+		std::ofstream file{ outputPath };
+		if (!file) {
+			throw std::runtime_error("Failed to open benchmark report " + outputPath);
+		}
+		recorder.writeReport(file, environment);
+		std::cout << "Benchmark report written to " << outputPath << "\n";
+	}
+
+	void FirstApp::writeCpuTrace()
+	{
+		std::ofstream file{ _options.cpuTracePath };
+		if (!file) {
+			throw std::runtime_error("Failed to open CPU trace " + _options.cpuTracePath);
+		}
+		size_t events = LveCpuProfiler::instance().writeChromeTrace(file);
+		std::cout << "CPU trace of " << events << " zones written to " << _options.cpuTracePath << "\n";
 	}
 
 	void FirstApp::loadGameObjects()
@@ -148,4 +652,91 @@ namespace lve{
 		}
 
 	}
-}
\ No newline at end of file
+
+	void FirstApp::loadMixedStateObjects()
+	{
+		std::shared_ptr<LveModel> lveModel =
+			LveModel::createModelFromFile(_lveDevice, "models/smooth_vase.obj");
+
+		std::array<VkCullModeFlags, 3> cullModes{
+			VK_CULL_MODE_NONE, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_BIT };
+		std::array<VkFrontFace, 2> frontFaces{
+			VK_FRONT_FACE_CLOCKWISE, VK_FRONT_FACE_COUNTER_CLOCKWISE };
+		std::array<VkCompareOp, 2> depthCompareOps{
+			VK_COMPARE_OP_LESS, VK_COMPARE_OP_LESS_OR_EQUAL };
+		std::array<VkPolygonMode, 2> polygonModes{
+			VK_POLYGON_MODE_FILL, VK_POLYGON_MODE_LINE };
+		size_t polygonModeCount = _lveDevice.features().fillModeNonSolid ? polygonModes.size() : 1;
+
+		// 24 distinct states, each a separate pipeline unless they are set dynamically
+		int index = 0;
+		for (size_t polygon = 0; polygon < polygonModeCount; ++polygon) {
+			for (auto cullMode : cullModes) {
+				for (auto frontFace : frontFaces) {
+					for (auto depthCompareOp : depthCompareOps) {
+						auto obj = LveGameObject::createGameObject();
+						obj.model = lveModel;
+						obj.transform.translation = {
+							-1.5f + .25f * static_cast<float>(index % 12),
+							.5f,
+							1.f + .5f * static_cast<float>(index / 12) };
+						obj.transform.scale = { .5f, .5f, .5f };
+						obj.renderState.cullMode = cullMode;
+						obj.renderState.frontFace = frontFace;
+						obj.renderState.depthCompareOp = depthCompareOp;
+						obj.renderState.polygonMode = polygonModes[polygon];
+						gameObjects.emplace(obj.getId(), std::move(obj));
+						index++;
+					}
+				}
+			}
+		}
+	}
+
+	void FirstApp::loadStressObjects(uint32_t count)
+	{
+		std::shared_ptr<LveModel> lveModel = LveModel::createModelFromFile(_lveDevice, "models/cube.obj");
+
+		// a cube of cubes filling the view in front of the starting camera
+		uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+		float spacing = 2.4f / static_cast<float>(side);
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t x = i % side;
+			uint32_t y = (i / side) % side;
+			uint32_t z = i / (side * side);
+
+			auto obj = LveGameObject::createGameObject();
+			obj.model = lveModel;
+			obj.transform.translation = {
+				-1.2f + spacing * static_cast<float>(x),
+				-1.2f + spacing * static_cast<float>(y),
+				1.f + spacing * static_cast<float>(z) };
+			obj.transform.scale = glm::vec3{ spacing * .3f };
+			gameObjects.emplace(obj.getId(), std::move(obj));
+		}
+	}
+
+	void FirstApp::loadStressLights(uint32_t count)
+	{
+		std::vector<glm::vec3> lightColors{
+		  {1.f, .1f, .1f},
+		  {.1f, .1f, 1.f},
+		  {.1f, 1.f, .1f},
+		  {1.f, 1.f, .1f},
+		  {.1f, 1.f, 1.f},
+		  {1.f, 1.f, 1.f}
+		};
+
+		// a ring of short range lights above the floor, orbiting with the others
+		for (uint32_t i = 0; i < count; ++i) {
+			float angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(count);
+			float ringRadius = .4f + 1.1f * static_cast<float>(i % 7) / 6.f;
+
+			auto pointLight = LveGameObject::makePointLight(.05f, .02f, lightColors[i % lightColors.size()]);
+			pointLight.pointLight->range = .5f;
+			pointLight.transform.translation = {
+				ringRadius * std::cos(angle), .3f, ringRadius * std::sin(angle) };
+			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+		}
+	}
+}
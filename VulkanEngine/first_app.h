@@ -1,12 +1,17 @@
 #pragma once
 
+#include "lve_benchmark.h"
 #include "lve_device.h"
 #include "lve_game_object.h"
+#include "lve_latency_test.h"
 #include "lve_renderer.h"
 #include "lve_window.h"
 #include "lve_descriptors.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_pipeline_state_cache.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve {
@@ -15,7 +20,73 @@ namespace lve {
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
 
-		FirstApp();
+#ifdef NDEBUG
+		static constexpr bool ENABLE_SHADER_HOT_RELOAD = false;
+#else
+		static constexpr bool ENABLE_SHADER_HOT_RELOAD = true;
+#endif
+
+		struct Options {
+			// adds a grid of objects cycling through cull, winding, depth and fill states
+			bool mixedStateScene = false;
+			// forces the baked pipeline permutations even when the device has the extension
+			bool extendedDynamicState = true;
+			// culls and builds draws in a compute pass, rendered with one indirect draw
+			bool gpuDriven = false;
+			// with gpuDriven, reads the compacted draw list back and reports it on exit
+			bool readbackDraws = false;
+			// records the draw queue into secondary command buffers on this many workers, 0 records inline
+			uint32_t recordThreads = 0;
+			// adds a dense grid of this many small cubes in front of the camera
+			uint32_t stressObjects = 0;
+			// starts with the depth pre-pass on, TOGGLE_DEPTH_PREPASS_KEY switches it at runtime
+			bool depthPrepass = false;
+			// with gpuDriven, tests objects against a depth pyramid of what was visible last frame
+			bool occlusionCulling = false;
+			// adds this many short range point lights above the floor
+			uint32_t stressLights = 0;
+			// shades each object's most influential lights, picked from a light BVH, instead of the
+			// cluster lists, in the simple render system only
+			bool perObjectLights = false;
+			// begins rendering on the swap chain image views when VK_KHR_dynamic_rendering is supported,
+			// false forces the render pass and framebuffer path
+			bool dynamicRendering = true;
+			// renders the scene below the swap chain resolution when the GPU frame time exceeds the
+			// budget and blits it up, needs dynamic rendering and is not combined with occlusion culling
+			bool dynamicResolution = false;
+			LveResolutionController::Settings resolutionSettings{};
+			// renders into offscreen images without a window or surface, and without input
+			bool headless = false;
+			// stop after this many frames or seconds, 0 runs until the window is closed
+			uint32_t maxFrames = 0;
+			float maxSeconds = 0.0f;
+			// times passes and systems on the GPU with timestamp queries, optionally with pipeline
+			// statistics, and reports the averages on exit and every gpuProfilerLogSeconds if set
+			bool gpuProfiler = false;
+			bool gpuPipelineStatistics = false;
+			float gpuProfilerLogSeconds = 0.0f;
+			// replaces the scene with a generated one, flies a scripted camera through it at a fixed
+			// time step, and writes frame time percentiles, draw counts and memory use when done
+			bool benchmark = false;
+			LveBenchmarkSettings benchmarkSettings{};
+			// records CPU zones of this many frames, after cpuTraceSkipFrames, and writes them as a
+			// Chrome trace to cpuTracePath; 0 records nothing
+			uint32_t cpuTraceFrames = 0;
+			uint32_t cpuTraceSkipFrames = 0;
+			std::string cpuTracePath = "cpu_trace.json";
+			// frames in flight, present mode and whether input is sampled only once the GPU drained
+			LveFramePacing framePacing{};
+			// renders every frame pacing configuration in turn and reports input to present latency
+			// and throughput of each, needs a window; framePacing is only the starting point
+			bool latencyTest = false;
+			LveLatencyTestSettings latencyTestSettings{};
+		};
+
+		static constexpr int TOGGLE_DEPTH_PREPASS_KEY = GLFW_KEY_P;
+		// the time step benchmark frames animate with, whatever they actually take
+		static constexpr float BENCHMARK_FRAME_TIME = 1.0f / 60.0f;
+
+		explicit FirstApp(const Options& options);
 		~FirstApp();
 
 		FirstApp(const FirstApp&) = delete;
@@ -25,10 +96,19 @@ namespace lve {
 
 	private:
 		void loadGameObjects();
+		void loadMixedStateObjects();
+		void loadStressObjects(uint32_t count);
+		void loadStressLights(uint32_t count);
+		void writeBenchmarkReport(const LveBenchmarkRecorder& recorder);
+		void writeCpuTrace();
+
+		Options _options;
 
-		LveWindow _lveWindow{WIDTH, HEIGHT, "Hello Vulkan!!"};
+		LveWindow _lveWindow{ WIDTH, HEIGHT, "Hello Vulkan!!", _options.headless };
 		LveDevice _lveDevice{ _lveWindow };
-		LveRenderer lveRenderer{ _lveWindow, _lveDevice };
+		LveRenderer lveRenderer{ _lveWindow, _lveDevice, _options.dynamicRendering, _options.framePacing };
+		LvePipelineCompiler pipelineCompiler{ _lveDevice };
+		LvePipelineStateCache pipelineStateCache{ _lveDevice, pipelineCompiler.getPipelineCache() };
 
 		std::unique_ptr<LveDescriptorPool> globalPool{};
 		LveGameObject::Map gameObjects;
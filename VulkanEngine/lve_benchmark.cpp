@@ -0,0 +1,265 @@
+#include "lve_benchmark.h"
+#include "lve_model.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+
+namespace lve {
+
+	namespace {
+		struct BenchmarkModel {
+			const char* path;
+			// brings the model to roughly the same size as the others
+			float scale;
+		};
+
+		constexpr std::array<BenchmarkModel, 5> BENCHMARK_MODELS{ {
+			{ "models/cube.obj", .15f },
+			{ "models/smooth_vase.obj", 1.f },
+			{ "models/colored_cube.obj", .15f },
+			{ "models/flat_vase.obj", 1.f },
+			{ "models/quad.obj", .2f },
+		} };
+
+		// average distance between neighbouring objects
+		constexpr float OBJECT_SPACING = .6f;
+
+		float sceneHalfExtent(uint32_t objectCount) {
+			return std::max(1.f, .5f * OBJECT_SPACING * std::cbrt(static_cast<float>(objectCount)));
+		}
+
+		void writeSummary(std::ostream& out, const char* name, const std::vector<double>& samples) {
+			out << "  \"" << name << "\": ";
+			if (samples.empty()) {
+				out << "null";
+				return;
+			}
+			auto summary = summarizeFrameTimes(samples);
+			out << "{ \"count\": " << summary.count
+				<< ", \"mean\": " << summary.mean
+				<< ", \"p50\": " << summary.p50
+				<< ", \"p90\": " << summary.p90
+				<< ", \"p95\": " << summary.p95
+				<< ", \"p99\": " << summary.p99
+				<< ", \"max\": " << summary.max << " }";
+		}
+
+		void writeString(std::ostream& out, const std::string& value) {
+			out << '"';
+			for (char c : value) {
+				if (c == '"' || c == '\\') {
+					out << '\\' << c;
+				}
+				else if (static_cast<unsigned char>(c) >= 0x20) {
+					out << c;
+				}
+			}
+			out << '"';
+		}
+	}
+
+	float LveBenchmarkRandom::uniform(float min, float max)
+	{
+		// the top 24 bits fill a float mantissa exactly
+		float unit = static_cast<float>(_engine() >> 8) * (1.f / 16777216.f);
+		return min + (max - min) * unit;
+	}
+
+	uint32_t LveBenchmarkRandom::index(uint32_t count)
+	{
+		return static_cast<uint32_t>((static_cast<uint64_t>(_engine() & 0xffffffffu) * count) >> 32);
+	}
+
+	void generateBenchmarkScene(LveDevice& device, const LveBenchmarkSettings& settings, LveGameObject::Map& gameObjects)
+	{
+		// loaded once per instance, the same file twice is still two sets of buffers to bind
+		std::vector<std::shared_ptr<LveModel>> models;
+		std::vector<float> modelScales;
+		for (uint32_t i = 0; i < std::max(1u, settings.models); ++i) {
+			const auto& model = BENCHMARK_MODELS[i % BENCHMARK_MODELS.size()];
+			models.push_back(LveModel::createModelFromFile(device, model.path));
+			modelScales.push_back(model.scale);
+		}
+
+		// braced initializers evaluate left to right, so the draws below happen in a fixed order
+		LveBenchmarkRandom random{ settings.seed };
+		float halfExtent = sceneHalfExtent(settings.objects);
+		for (uint32_t i = 0; i < settings.objects; ++i) {
+			uint32_t modelIndex = random.index(static_cast<uint32_t>(models.size()));
+
+			auto obj = LveGameObject::createGameObject();
+			obj.model = models[modelIndex];
+			obj.transform.translation = glm::vec3{
+				random.uniform(-halfExtent, halfExtent),
+				random.uniform(-halfExtent, halfExtent),
+				random.uniform(-halfExtent, halfExtent) };
+			obj.transform.rotation = glm::vec3{
+				random.uniform(0.f, glm::two_pi<float>()),
+				random.uniform(0.f, glm::two_pi<float>()),
+				random.uniform(0.f, glm::two_pi<float>()) };
+			obj.transform.scale = glm::vec3{ modelScales[modelIndex] * random.uniform(.75f, 1.5f) };
+			gameObjects.emplace(obj.getId(), std::move(obj));
+		}
+
+		for (uint32_t i = 0; i < settings.lights; ++i) {
+			glm::vec3 color{ random.uniform(.2f, 1.f), random.uniform(.2f, 1.f), random.uniform(.2f, 1.f) };
+			auto pointLight = LveGameObject::makePointLight(.2f, .05f, color);
+			pointLight.pointLight->range = random.uniform(1.f, 2.5f);
+			pointLight.transform.translation = glm::vec3{
+				random.uniform(-halfExtent, halfExtent),
+				random.uniform(-halfExtent, halfExtent),
+				random.uniform(-halfExtent, halfExtent) };
+			gameObjects.emplace(pointLight.getId(), std::move(pointLight));
+		}
+	}
+
+	LveBenchmarkCameraPath::LveBenchmarkCameraPath(const LveBenchmarkSettings& settings)
+		: _sceneRadius{ sceneHalfExtent(settings.objects) * std::sqrt(3.f) }
+	{
+	}
+
+	void LveBenchmarkCameraPath::apply(uint64_t frame, float aspect, LveCamera& camera) const
+	{
+		float angle = glm::two_pi<float>() * static_cast<float>(frame % ORBIT_FRAMES) / static_cast<float>(ORBIT_FRAMES);
+		// dips into the corners of the scene twice per orbit, then looks at all of it from outside
+		float distance = _sceneRadius * (1.3f + .5f * std::sin(2.f * angle));
+		glm::vec3 position{
+			distance * std::sin(angle),
+			-.4f * _sceneRadius * std::sin(angle),
+			-distance * std::cos(angle) };
+
+		camera.setViewTarget(position, glm::vec3{ 0.f });
+		camera.setPerspectiveProjection(glm::radians(50.f), aspect, .1f, distance + _sceneRadius + 1.f);
+	}
+
+	LveFrameTimeSummary summarizeFrameTimes(std::vector<double> milliseconds)
+	{
+		LveFrameTimeSummary summary{};
+		if (milliseconds.empty()) {
+			return summary;
+		}
+
+		std::sort(milliseconds.begin(), milliseconds.end());
+		size_t count = milliseconds.size();
+		auto percentile = [&](size_t percent) {
+			// the smallest sample at least percent of all samples are not above
+			size_t rank = (percent * count + 99) / 100;
+			return milliseconds[std::max<size_t>(rank, 1) - 1];
+		};
+
+		double total = 0.0;
+		for (double sample : milliseconds) {
+			total += sample;
+		}
+
+		summary.count = count;
+		summary.mean = total / static_cast<double>(count);
+		summary.p50 = percentile(50);
+		summary.p90 = percentile(90);
+		summary.p95 = percentile(95);
+		summary.p99 = percentile(99);
+		summary.max = milliseconds.back();
+		return summary;
+	}
+
+	LveBenchmarkRecorder::LveBenchmarkRecorder(const LveBenchmarkSettings& settings) : _settings{ settings }
+	{
+		_frames.reserve(settings.frames);
+	}
+
+	void LveBenchmarkRecorder::addFrame(const LveBenchmarkFrame& frame)
+	{
+		if (!isMeasuring()) {
+			_warmupFramesSeen++;
+			return;
+		}
+		if (!isComplete()) {
+			_frames.push_back(frame);
+		}
+	}
+
+	void LveBenchmarkRecorder::writeReport(std::ostream& out, const LveBenchmarkEnvironment& environment) const
+	{
+		std::vector<double> cpuMilliseconds;
+		std::vector<double> frameMilliseconds;
+		std::vector<double> gpuMilliseconds;
+		double drawCalls = 0.0;
+		double instances = 0.0;
+		double packets = 0.0;
+		double pipelineBinds = 0.0;
+		double modelBinds = 0.0;
+		double culledTested = 0.0;
+		double culledVisible = 0.0;
+		for (const auto& frame : _frames) {
+			cpuMilliseconds.push_back(frame.cpuMilliseconds);
+			frameMilliseconds.push_back(frame.frameMilliseconds);
+			if (frame.gpuMilliseconds >= 0.0f) {
+				gpuMilliseconds.push_back(frame.gpuMilliseconds);
+			}
+			drawCalls += frame.drawCalls;
+			instances += frame.instances;
+			packets += frame.packets;
+			pipelineBinds += frame.pipelineBinds;
+			modelBinds += frame.modelBinds;
+			culledTested += frame.culledTested;
+			culledVisible += frame.culledVisible;
+		}
+		double frameCount = std::max<double>(1.0, static_cast<double>(_frames.size()));
+
+		auto flags = out.flags();
+		auto precision = out.precision();
+		out << std::fixed << std::setprecision(3);
+
+		out << "{\n";
+		out << "  \"scene\": { \"objects\": " << _settings.objects << ", \"models\": " << _settings.models
+			<< ", \"lights\": " << _settings.lights << ", \"seed\": " << _settings.seed
+			<< ", \"warmupFrames\": " << _settings.warmupFrames << ", \"frames\": " << _frames.size() << " },\n";
+
+		out << "  \"config\": { \"device\": ";
+		writeString(out, environment.deviceName);
+		out << ", \"extent\": [" << environment.extent.width << ", " << environment.extent.height << "]"
+			<< ", \"headless\": " << (environment.headless ? "true" : "false")
+			<< ", \"dynamicRendering\": " << (environment.dynamicRendering ? "true" : "false")
+			<< ", \"gpuDriven\": " << (environment.gpuDriven ? "true" : "false")
+			<< ", \"recordThreads\": " << environment.recordThreads << " },\n";
+
+		writeSummary(out, "cpuMs", cpuMilliseconds);
+		out << ",\n";
+		writeSummary(out, "frameMs", frameMilliseconds);
+		out << ",\n";
+		// null when the graphics queue cannot write timestamps
+		writeSummary(out, "gpuMs", gpuMilliseconds);
+		out << ",\n";
+
+		out << "  \"drawsPerFrame\": { \"drawCalls\": " << drawCalls / frameCount
+			<< ", \"instances\": " << instances / frameCount
+			<< ", \"packets\": " << packets / frameCount
+			<< ", \"pipelineBinds\": " << pipelineBinds / frameCount
+			<< ", \"modelBinds\": " << modelBinds / frameCount << " },\n";
+
+		out << "  \"cullingPerFrame\": { \"tested\": " << culledTested / frameCount
+			<< ", \"visible\": " << culledVisible / frameCount << " },\n";
+
+		out << "  \"memory\": { \"deviceLocalHeapBytes\": " << environment.memory.deviceLocalHeapSize;
+		if (environment.memory.budgetKnown) {
+			out << ", \"deviceLocalUsageBytes\": " << environment.memory.deviceLocalUsage
+				<< ", \"deviceLocalBudgetBytes\": " << environment.memory.deviceLocalBudget;
+		}
+		else {
+			out << ", \"deviceLocalUsageBytes\": null, \"deviceLocalBudgetBytes\": null";
+		}
+		out << " }\n";
+		out << "}\n";
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "lve_camera.h"
+#include "lve_device.h"
+#include "lve_game_object.h"
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+	struct LveBenchmarkSettings {
+		uint32_t objects = 1000;
+		// distinct model instances the objects are spread over, each one a separate vertex and index buffer
+		uint32_t models = 4;
+		uint32_t lights = 16;
+		uint32_t seed = 1;
+		// rendered before measuring starts, pipelines and caches settle meanwhile
+		uint32_t warmupFrames = 60;
+		uint32_t frames = 600;
+		// empty writes the report to stdout
+		std::string outputPath;
+	};
+
+	// Draws from std::mt19937, whose sequence the standard fixes, and converts the bits itself
+	// because the standard distributions are implementation defined. The same seed generates
+	// the same scene on every compiler.
+	class LveBenchmarkRandom {
+	public:
+		explicit LveBenchmarkRandom(uint32_t seed) : _engine{ seed } {}
+
+		// in [min, max)
+		float uniform(float min, float max);
+		// in [0, count)
+		uint32_t index(uint32_t count);
+
+	private:
+		std::mt19937 _engine;
+	};
+
+	// Adds settings.objects objects spread over settings.models models and settings.lights point
+	// lights, laid out from settings.seed in a cube sized so the density stays the same for any count.
+	void generateBenchmarkScene(LveDevice& device, const LveBenchmarkSettings& settings, LveGameObject::Map& gameObjects);
+
+	// Orbits the camera around the generated scene, moving in and out, as a function of the frame
+	// number only, so every run sees the same views however long its frames take.
+	class LveBenchmarkCameraPath {
+	public:
+		// frames for one orbit, independent of the run length so runs of different lengths share a prefix
+		static constexpr uint32_t ORBIT_FRAMES = 600;
+
+		explicit LveBenchmarkCameraPath(const LveBenchmarkSettings& settings);
+
+		void apply(uint64_t frame, float aspect, LveCamera& camera) const;
+
+	private:
+		float _sceneRadius;
+	};
+
+	// Nearest rank percentiles, in milliseconds
+	struct LveFrameTimeSummary {
+		size_t count = 0;
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	LveFrameTimeSummary summarizeFrameTimes(std::vector<double> milliseconds);
+
+	// One measured frame
+	struct LveBenchmarkFrame {
+		// the frame's work on the CPU, without the wait for a free frame in beginFrame
+		double cpuMilliseconds = 0.0;
+		// wall clock time since the previous frame started
+		double frameMilliseconds = 0.0;
+		// a GPU measurement that arrived this frame, it belongs to an earlier one; negative without
+		float gpuMilliseconds = -1.0f;
+		// with GPU-driven rendering the indirect draws recorded and the objects the GPU drew
+		uint32_t drawCalls = 0;
+		uint32_t instances = 0;
+		uint32_t packets = 0;
+		uint32_t pipelineBinds = 0;
+		uint32_t modelBinds = 0;
+		// objects frustum (and occlusion) culling tested and kept, counted on the GPU for an
+		// earlier frame with GPU-driven rendering
+		uint32_t culledTested = 0;
+		uint32_t culledVisible = 0;
+	};
+
+	// What the report records about the run besides the scene
+	struct LveBenchmarkEnvironment {
+		std::string deviceName;
+		VkExtent2D extent{};
+		bool headless = false;
+		bool dynamicRendering = false;
+		bool gpuDriven = false;
+		uint32_t recordThreads = 0;
+		LveDeviceMemoryUsage memory{};
+	};
+
+	// Collects the measured frames after the warmup and writes them as one JSON object. Keys and
+	// their order are fixed so reports of two builds can be diffed line by line.
+	class LveBenchmarkRecorder {
+	public:
+		explicit LveBenchmarkRecorder(const LveBenchmarkSettings& settings);
+
+		// counts warmup frames and drops them, records the rest
+		void addFrame(const LveBenchmarkFrame& frame);
+		bool isComplete() const { return _frames.size() >= _settings.frames; }
+		bool isMeasuring() const { return _warmupFramesSeen >= _settings.warmupFrames; }
+		size_t getMeasuredFrameCount() const { return _frames.size(); }
+
+		void writeReport(std::ostream& out, const LveBenchmarkEnvironment& environment) const;
+
+	private:
+		LveBenchmarkSettings _settings;
+		uint32_t _warmupFramesSeen = 0;
+		std::vector<LveBenchmarkFrame> _frames;
+	};
+}
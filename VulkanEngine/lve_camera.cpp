@@ -4,6 +4,26 @@
 #include <limits>
 
 namespace lve { 
+
+	LveFrustum LveFrustum::fromViewProjection(const glm::mat4& viewProjection) {
+		// Gribb/Hartmann, with the near plane at z = 0 of the [0, 1] depth range
+		auto row = [&viewProjection](int i) {
+			return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		};
+
+		LveFrustum frustum{};
+		frustum.planes[PLANE_LEFT] = row(3) + row(0);
+		frustum.planes[PLANE_RIGHT] = row(3) - row(0);
+		frustum.planes[PLANE_BOTTOM] = row(3) + row(1);
+		frustum.planes[PLANE_TOP] = row(3) - row(1);
+		frustum.planes[PLANE_NEAR] = row(2);
+		frustum.planes[PLANE_FAR] = row(3) - row(2);
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
 	void LveCamera::setOrthographicProjection(
 		float left, float right, float top, float bottom, float near, float far) {
 		projectionMatrix = glm::mat4{ 1.0f };
@@ -5,6 +5,17 @@
 #include <glm/glm.hpp>
 
 namespace lve {
+
+	// World space planes, xyz is the normal pointing into the frustum and w the distance,
+	// so a point p is inside a plane when dot(xyz, p) + w >= 0
+	struct LveFrustum {
+		enum Plane { PLANE_LEFT = 0, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+		glm::vec4 planes[PLANE_COUNT];
+
+		static LveFrustum fromViewProjection(const glm::mat4& viewProjection);
+	};
+
 	class LveCamera {
 	public:
 
@@ -18,6 +29,7 @@ namespace lve {
 
 		const glm::mat4& getProjection() const { return projectionMatrix; }
 		const glm::mat4& getView() const { return viewMatrix; }
+		LveFrustum getFrustum() const { return LveFrustum::fromViewProjection(projectionMatrix * viewMatrix); }
 	private:
 		glm::mat4 projectionMatrix{ 1.f };
 		glm::mat4 viewMatrix{ 1.f };
@@ -0,0 +1,51 @@
+#include "lve_compute_pipeline.h"
+
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+	LveComputePipeline::LveComputePipeline(
+		LveDevice& device,
+		const std::string& compFilepath,
+		VkPipelineLayout pipelineLayout,
+		const LveSpecializationConstants& specializationConstants,
+		VkPipelineCache pipelineCache)
+		: _device{ device }
+	{
+		assert(
+			pipelineLayout != VK_NULL_HANDLE &&
+			"Cannot create compute pipeline: no pipelineLayout provided");
+
+		_compShaderModule = _device.shaderModuleCache().acquire(compFilepath);
+
+		VkSpecializationInfo specializationInfo = specializationConstants.getSpecializationInfo();
+
+		VkPipelineShaderStageCreateInfo shaderStage{};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		shaderStage.module = _compShaderModule->getShaderModule();
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = specializationConstants.empty() ? nullptr : &specializationInfo;
+
+		VkComputePipelineCreateInfo pipelineCreateInfo{};
+		pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCreateInfo.stage = shaderStage;
+		pipelineCreateInfo.layout = pipelineLayout;
+		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineCreateInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(_device.device(), pipelineCache, 1,
+			&pipelineCreateInfo, nullptr, &_computePipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline.");
+		}
+	}
+
+	LveComputePipeline::~LveComputePipeline() {
+		vkDestroyPipeline(_device.device(), _computePipeline, nullptr);
+	}
+
+	void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePipeline);
+	}
+}
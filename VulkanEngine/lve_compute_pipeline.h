@@ -0,0 +1,38 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_pipeline.h"
+#include "lve_shader_cache.h"
+
+#include <memory>
+#include <string>
+
+namespace lve {
+
+	// Single-stage compute pipeline, the compute counterpart of LvePipeline.
+	class LveComputePipeline {
+	public:
+		LveComputePipeline(
+			LveDevice& device,
+			const std::string& compFilepath,
+			VkPipelineLayout pipelineLayout,
+			const LveSpecializationConstants& specializationConstants = LveSpecializationConstants{},
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		~LveComputePipeline();
+
+		LveComputePipeline(const LveComputePipeline&) = delete;
+		LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+		// Group count needed to cover itemCount invocations with the shader's local size.
+		static uint32_t groupCount(uint32_t itemCount, uint32_t localSize) {
+			return (itemCount + localSize - 1) / localSize;
+		}
+
+	private:
+		LveDevice& _device;
+		VkPipeline _computePipeline;
+		std::shared_ptr<LveShaderModule> _compShaderModule;
+	};
+}
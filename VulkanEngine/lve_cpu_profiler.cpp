@@ -0,0 +1,167 @@
+#include "lve_cpu_profiler.h"
+
+#include <iomanip>
+
+namespace lve {
+
+	namespace {
+		void writeName(std::ostream& out, const char* name) {
+			out << '"';
+			for (const char* c = name; *c != '\0'; ++c) {
+				if (*c == '"' || *c == '\\') {
+					out << '\\' << *c;
+				}
+				else if (static_cast<unsigned char>(*c) >= 0x20) {
+					out << *c;
+				}
+			}
+			out << '"';
+		}
+	}
+
+	LveCpuProfiler& LveCpuProfiler::instance()
+	{
+		static LveCpuProfiler profiler;
+		return profiler;
+	}
+
+	LveCpuProfiler::LveCpuProfiler() : _epoch{ std::chrono::steady_clock::now() } {}
+
+	LveCpuProfiler::ThreadRing& LveCpuProfiler::threadRing()
+	{
+		thread_local ThreadRing* ring = nullptr;
+		if (ring == nullptr) {
+			std::lock_guard<std::mutex> lock{ _ringsMutex };
+			_rings.push_back(std::make_unique<ThreadRing>());
+			ring = _rings.back().get();
+			ring->threadIndex = static_cast<uint32_t>(_rings.size() - 1);
+		}
+		return *ring;
+	}
+
+	void LveCpuProfiler::startCapture(uint32_t frameCount, uint32_t skipFrames)
+	{
+		_capturing.store(false, std::memory_order_relaxed);
+		_captureComplete.store(false, std::memory_order_relaxed);
+		_frameMarks.clear();
+		_waitingForStart = frameCount > 0;
+		_skipFrames = skipFrames;
+		_framesLeft = frameCount;
+	}
+
+	void LveCpuProfiler::markFrame()
+	{
+		uint64_t time = now();
+		if (_waitingForStart) {
+			if (_skipFrames > 0) {
+				_skipFrames--;
+				return;
+			}
+			_waitingForStart = false;
+			_captureStartTime = time;
+			_captureEndTime = UINT64_MAX;
+			_frameMarks.push_back(time);
+			_capturing.store(true, std::memory_order_relaxed);
+			return;
+		}
+		if (!isCapturing()) {
+			return;
+		}
+
+		_frameMarks.push_back(time);
+		if (--_framesLeft == 0) {
+			_captureEndTime = time;
+			_capturing.store(false, std::memory_order_relaxed);
+			_captureComplete.store(true, std::memory_order_release);
+		}
+	}
+
+	void LveCpuProfiler::setThreadName(const char* name)
+	{
+		threadRing().name.store(name, std::memory_order_release);
+	}
+
+	void LveCpuProfiler::recordZone(const char* name, uint64_t start, uint64_t end)
+	{
+		ThreadRing& ring = threadRing();
+		uint64_t count = ring.count.load(std::memory_order_relaxed);
+		Slot& slot = ring.slots[count % RING_CAPACITY];
+		// a reader that sees any of the new fields sees the slot as being written
+		slot.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.start.store(start, std::memory_order_relaxed);
+		slot.end.store(end, std::memory_order_relaxed);
+		slot.sequence.store(count + 1, std::memory_order_release);
+		// publishes the event to writeChromeTrace
+		ring.count.store(count + 1, std::memory_order_release);
+	}
+
+	size_t LveCpuProfiler::writeChromeTrace(std::ostream& out) const
+	{
+		auto flags = out.flags();
+		auto precision = out.precision();
+		// microseconds with nanosecond precision
+		out << std::fixed << std::setprecision(3);
+		auto microseconds = [this](uint64_t time) { return static_cast<double>(time - _captureStartTime) / 1000.0; };
+
+		size_t eventCount = 0;
+		const char* separator = "\n";
+		out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		std::lock_guard<std::mutex> lock{ _ringsMutex };
+		std::vector<Event> events;
+		for (const auto& ring : _rings) {
+			uint64_t count = ring->count.load(std::memory_order_acquire);
+			uint64_t first = count > RING_CAPACITY ? count - RING_CAPACITY : 0;
+			events.clear();
+			for (uint64_t i = first; i < count; ++i) {
+				const Slot& slot = ring->slots[i % RING_CAPACITY];
+				if (slot.sequence.load(std::memory_order_acquire) != i + 1) continue;
+				Event event{
+					slot.name.load(std::memory_order_relaxed),
+					slot.start.load(std::memory_order_relaxed),
+					slot.end.load(std::memory_order_relaxed) };
+				// the writer kept going, a slot it started to overwrite while we copied is dropped
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.sequence.load(std::memory_order_relaxed) != i + 1) continue;
+				events.push_back(event);
+			}
+
+			uint32_t tid = ring->threadIndex;
+			const char* name = ring->name.load(std::memory_order_acquire);
+			out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+			if (name != nullptr) {
+				writeName(out, name);
+			}
+			else {
+				out << "\"thread " << tid << "\"";
+			}
+			out << "}}";
+			separator = ",\n";
+
+			for (size_t i = 0; i < events.size(); ++i) {
+				const Event& event = events[i];
+				if (event.start < _captureStartTime || event.end > _captureEndTime) {
+					continue;
+				}
+				out << separator << "{\"name\":";
+				writeName(out, event.name);
+				out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << microseconds(event.start)
+					<< ",\"dur\":" << static_cast<double>(event.end - event.start) / 1000.0 << "}";
+				eventCount++;
+			}
+		}
+
+		for (size_t i = 0; i < _frameMarks.size(); ++i) {
+			out << separator << "{\"name\":\"frame " << i << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":"
+				<< microseconds(_frameMarks[i]) << "}";
+			separator = ",\n";
+		}
+		out << "\n]}\n";
+
+		out.flags(flags);
+		out.precision(precision);
+		return eventCount;
+	}
+}
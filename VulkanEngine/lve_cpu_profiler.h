@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Define LVE_CPU_PROFILER as 0 to compile every zone out. The capture API stays, it records nothing.
+#ifndef LVE_CPU_PROFILER
+#define LVE_CPU_PROFILER 1
+#endif
+
+#define LVE_PROFILE_CONCAT_INNER(a, b) a##b
+#define LVE_PROFILE_CONCAT(a, b) LVE_PROFILE_CONCAT_INNER(a, b)
+
+#if LVE_CPU_PROFILER
+// Times the rest of the enclosing block. name must be a string literal or otherwise outlive the capture.
+#define LVE_PROFILE_ZONE(name) ::lve::LveCpuZone LVE_PROFILE_CONCAT(lveCpuZone, __LINE__){ name }
+// Names the calling thread in the trace, same lifetime rule as zone names.
+#define LVE_PROFILE_THREAD(name) ::lve::LveCpuProfiler::instance().setThreadName(name)
+// A frame boundary, call from the thread running the frame loop, at the same point of every frame.
+#define LVE_PROFILE_FRAME() ::lve::LveCpuProfiler::instance().markFrame()
+#else
+#define LVE_PROFILE_ZONE(name) ((void)0)
+#define LVE_PROFILE_THREAD(name) ((void)0)
+#define LVE_PROFILE_FRAME() ((void)0)
+#endif
+
+namespace lve {
+
+	// Collects timed zones from every thread into per-thread ring buffers and writes them in the
+	// Chrome trace event format, which Perfetto and chrome://tracing open. Each ring has a single
+	// writer, its own thread, so recording a zone is two clock reads and a release store; the only
+	// lock is taken once per thread, the first time it records.
+	//
+	// Zones are only recorded during a capture of a number of frames. writeChromeTrace reads the
+	// rings without stopping the writers, each slot is a seqlock so events overwritten while it
+	// reads are skipped. Call it between frames once the capture is complete for a consistent trace.
+	class LveCpuProfiler {
+	public:
+		static constexpr bool ENABLED = LVE_CPU_PROFILER != 0;
+		// per thread, older events are overwritten once a capture records more
+		static constexpr uint32_t RING_CAPACITY = 1u << 16;
+
+		static LveCpuProfiler& instance();
+
+		LveCpuProfiler(const LveCpuProfiler&) = delete;
+		LveCpuProfiler& operator=(const LveCpuProfiler&) = delete;
+
+		// Records frameCount frames, starting at the frame mark after the next skipFrames ones.
+		// Replaces anything captured before. Call from the frame loop thread, like markFrame and
+		// writeChromeTrace.
+		void startCapture(uint32_t frameCount, uint32_t skipFrames = 0);
+		bool isCapturing() const { return _capturing.load(std::memory_order_relaxed); }
+		// true once every requested frame was captured, until the next startCapture
+		bool isCaptureComplete() const { return _captureComplete.load(std::memory_order_acquire); }
+
+		void markFrame();
+		void setThreadName(const char* name);
+
+		// records a zone of the calling thread, start and end from now()
+		void recordZone(const char* name, uint64_t start, uint64_t end);
+		// nanoseconds since the profiler was created
+		uint64_t now() const {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - _epoch).count());
+		}
+
+		// Returns the number of events written.
+		size_t writeChromeTrace(std::ostream& out) const;
+
+	private:
+		struct Event {
+			const char* name;
+			uint64_t start;
+			uint64_t end;
+		};
+
+		// Written by the ring's thread while writeChromeTrace may read it. sequence is the index of
+		// the event in the slot plus one, 0 while it is being written.
+		struct Slot {
+			std::atomic<uint64_t> sequence{ 0 };
+			std::atomic<const char*> name{ nullptr };
+			std::atomic<uint64_t> start{ 0 };
+			std::atomic<uint64_t> end{ 0 };
+		};
+
+		struct ThreadRing {
+			uint32_t threadIndex = 0;
+			std::atomic<const char*> name{ nullptr };
+			std::unique_ptr<Slot[]> slots{ new Slot[RING_CAPACITY] };
+			// events written so far, slot count % RING_CAPACITY is next
+			std::atomic<uint64_t> count{ 0 };
+		};
+
+		LveCpuProfiler();
+
+		ThreadRing& threadRing();
+
+		std::chrono::steady_clock::time_point _epoch;
+		std::atomic<bool> _capturing{ false };
+		std::atomic<bool> _captureComplete{ false };
+		// capture state below belongs to the frame loop thread
+		bool _waitingForStart = false;
+		uint32_t _skipFrames = 0;
+		uint32_t _framesLeft = 0;
+		// the rings are not cleared between captures, events outside these times are left out
+		uint64_t _captureStartTime = 0;
+		uint64_t _captureEndTime = 0;
+		std::vector<uint64_t> _frameMarks;
+
+		// taken to register a thread and to export, the rings outlive their threads
+		mutable std::mutex _ringsMutex;
+		std::vector<std::unique_ptr<ThreadRing>> _rings;
+	};
+
+	// RAII zone behind LVE_PROFILE_ZONE, a relaxed load when no capture is running.
+	class LveCpuZone {
+	public:
+		explicit LveCpuZone(const char* name) : _name{ name } {
+			auto& profiler = LveCpuProfiler::instance();
+			if (profiler.isCapturing()) {
+				_start = profiler.now();
+				_recording = true;
+			}
+		}
+
+		~LveCpuZone() {
+			if (_recording) {
+				auto& profiler = LveCpuProfiler::instance();
+				profiler.recordZone(_name, _start, profiler.now());
+			}
+		}
+
+		LveCpuZone(const LveCpuZone&) = delete;
+		LveCpuZone& operator=(const LveCpuZone&) = delete;
+
+	private:
+		const char* _name;
+		uint64_t _start = 0;
+		bool _recording = false;
+	};
+}
@@ -0,0 +1,324 @@
+#include "lve_culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LVE_CULL_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LVE_CULL_SSE 1
+#endif
+
+namespace lve {
+
+	namespace {
+
+#if defined(LVE_CULL_AVX)
+		using SimdFloat = __m256;
+		constexpr size_t SIMD_WIDTH = 8;
+		inline SimdFloat simdLoad(const float* values) { return _mm256_loadu_ps(values); }
+		inline SimdFloat simdSet(float value) { return _mm256_set1_ps(value); }
+		inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+		inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+		inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+		inline SimdFloat simdAnd(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a, b); }
+		inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		inline SimdFloat simdTrue() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+		inline int simdMask(SimdFloat a) { return _mm256_movemask_ps(a); }
+#elif defined(LVE_CULL_SSE)
+		using SimdFloat = __m128;
+		constexpr size_t SIMD_WIDTH = 4;
+		inline SimdFloat simdLoad(const float* values) { return _mm_loadu_ps(values); }
+		inline SimdFloat simdSet(float value) { return _mm_set1_ps(value); }
+		inline SimdFloat simdAdd(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+		inline SimdFloat simdMul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+		inline SimdFloat simdSub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+		inline SimdFloat simdAnd(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+		inline SimdFloat simdGreaterEqual(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a, b); }
+		inline SimdFloat simdTrue() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+		inline int simdMask(SimdFloat a) { return _mm_movemask_ps(a); }
+#endif
+
+		inline void appendLanes(int mask, size_t base, size_t laneCount, std::vector<uint32_t>& visible) {
+			for (size_t lane = 0; lane < laneCount; ++lane) {
+				if (mask & (1 << lane)) {
+					visible.push_back(static_cast<uint32_t>(base + lane));
+				}
+			}
+		}
+
+		inline bool sphereVisible(const LveFrustum& frustum, const LveSphereBatch& spheres, size_t i) {
+			for (const auto& plane : frustum.planes) {
+				float distance = plane.x * spheres.centerX[i] + plane.y * spheres.centerY[i]
+					+ plane.z * spheres.centerZ[i] + plane.w;
+				if (distance < -spheres.radius[i]) return false;
+			}
+			return true;
+		}
+
+		inline bool boxVisible(const LveFrustum& frustum, const LveBoxBatch& boxes, size_t i) {
+			for (const auto& plane : frustum.planes) {
+				float distance = plane.x * boxes.centerX[i] + plane.y * boxes.centerY[i]
+					+ plane.z * boxes.centerZ[i] + plane.w;
+				// projected half size of the box onto the plane normal
+				float radius = std::abs(plane.x) * boxes.extentX[i] + std::abs(plane.y) * boxes.extentY[i]
+					+ std::abs(plane.z) * boxes.extentZ[i];
+				if (distance < -radius) return false;
+			}
+			return true;
+		}
+	}
+
+	// *************** Batches *********************
+
+	void LveSphereBatch::clear() {
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		radius.clear();
+	}
+
+	void LveSphereBatch::reserve(size_t count) {
+		centerX.reserve(count);
+		centerY.reserve(count);
+		centerZ.reserve(count);
+		radius.reserve(count);
+	}
+
+	void LveSphereBatch::add(const glm::vec3& center, float sphereRadius) {
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		radius.push_back(sphereRadius);
+	}
+
+	void LveBoxBatch::clear() {
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		extentX.clear();
+		extentY.clear();
+		extentZ.clear();
+	}
+
+	void LveBoxBatch::reserve(size_t count) {
+		centerX.reserve(count);
+		centerY.reserve(count);
+		centerZ.reserve(count);
+		extentX.reserve(count);
+		extentY.reserve(count);
+		extentZ.reserve(count);
+	}
+
+	void LveBoxBatch::add(const glm::vec3& center, const glm::vec3& extent) {
+		centerX.push_back(center.x);
+		centerY.push_back(center.y);
+		centerZ.push_back(center.z);
+		extentX.push_back(extent.x);
+		extentY.push_back(extent.y);
+		extentZ.push_back(extent.z);
+	}
+
+	// *************** Kernels *********************
+
+	const char* cullingKernelName() {
+#if defined(LVE_CULL_AVX)
+		return "AVX";
+#elif defined(LVE_CULL_SSE)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+	void cullSpheresScalar(const LveFrustum& frustum, const LveSphereBatch& spheres, std::vector<uint32_t>& visible) {
+		for (size_t i = 0; i < spheres.size(); ++i) {
+			if (sphereVisible(frustum, spheres, i)) {
+				visible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void cullBoxesScalar(const LveFrustum& frustum, const LveBoxBatch& boxes, std::vector<uint32_t>& visible) {
+		for (size_t i = 0; i < boxes.size(); ++i) {
+			if (boxVisible(frustum, boxes, i)) {
+				visible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void cullSpheres(const LveFrustum& frustum, const LveSphereBatch& spheres, std::vector<uint32_t>& visible) {
+		size_t i = 0;
+#if defined(LVE_CULL_AVX) || defined(LVE_CULL_SSE)
+		SimdFloat planeX[LveFrustum::PLANE_COUNT];
+		SimdFloat planeY[LveFrustum::PLANE_COUNT];
+		SimdFloat planeZ[LveFrustum::PLANE_COUNT];
+		SimdFloat planeW[LveFrustum::PLANE_COUNT];
+		for (int p = 0; p < LveFrustum::PLANE_COUNT; ++p) {
+			planeX[p] = simdSet(frustum.planes[p].x);
+			planeY[p] = simdSet(frustum.planes[p].y);
+			planeZ[p] = simdSet(frustum.planes[p].z);
+			planeW[p] = simdSet(frustum.planes[p].w);
+		}
+
+		const SimdFloat zero = simdSet(0.f);
+		for (; i + SIMD_WIDTH <= spheres.size(); i += SIMD_WIDTH) {
+			SimdFloat x = simdLoad(&spheres.centerX[i]);
+			SimdFloat y = simdLoad(&spheres.centerY[i]);
+			SimdFloat z = simdLoad(&spheres.centerZ[i]);
+			SimdFloat negativeRadius = simdSub(zero, simdLoad(&spheres.radius[i]));
+
+			SimdFloat inside = simdTrue();
+			for (int p = 0; p < LveFrustum::PLANE_COUNT; ++p) {
+				SimdFloat distance = simdAdd(
+					simdAdd(simdMul(planeX[p], x), simdMul(planeY[p], y)),
+					simdAdd(simdMul(planeZ[p], z), planeW[p]));
+				inside = simdAnd(inside, simdGreaterEqual(distance, negativeRadius));
+			}
+			appendLanes(simdMask(inside), i, SIMD_WIDTH, visible);
+		}
+#endif
+		for (; i < spheres.size(); ++i) {
+			if (sphereVisible(frustum, spheres, i)) {
+				visible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void cullBoxes(const LveFrustum& frustum, const LveBoxBatch& boxes, std::vector<uint32_t>& visible) {
+		size_t i = 0;
+#if defined(LVE_CULL_AVX) || defined(LVE_CULL_SSE)
+		SimdFloat planeX[LveFrustum::PLANE_COUNT];
+		SimdFloat planeY[LveFrustum::PLANE_COUNT];
+		SimdFloat planeZ[LveFrustum::PLANE_COUNT];
+		SimdFloat planeW[LveFrustum::PLANE_COUNT];
+		SimdFloat absPlaneX[LveFrustum::PLANE_COUNT];
+		SimdFloat absPlaneY[LveFrustum::PLANE_COUNT];
+		SimdFloat absPlaneZ[LveFrustum::PLANE_COUNT];
+		for (int p = 0; p < LveFrustum::PLANE_COUNT; ++p) {
+			planeX[p] = simdSet(frustum.planes[p].x);
+			planeY[p] = simdSet(frustum.planes[p].y);
+			planeZ[p] = simdSet(frustum.planes[p].z);
+			planeW[p] = simdSet(frustum.planes[p].w);
+			absPlaneX[p] = simdSet(std::abs(frustum.planes[p].x));
+			absPlaneY[p] = simdSet(std::abs(frustum.planes[p].y));
+			absPlaneZ[p] = simdSet(std::abs(frustum.planes[p].z));
+		}
+
+		const SimdFloat zero = simdSet(0.f);
+		for (; i + SIMD_WIDTH <= boxes.size(); i += SIMD_WIDTH) {
+			SimdFloat x = simdLoad(&boxes.centerX[i]);
+			SimdFloat y = simdLoad(&boxes.centerY[i]);
+			SimdFloat z = simdLoad(&boxes.centerZ[i]);
+			SimdFloat ex = simdLoad(&boxes.extentX[i]);
+			SimdFloat ey = simdLoad(&boxes.extentY[i]);
+			SimdFloat ez = simdLoad(&boxes.extentZ[i]);
+
+			SimdFloat inside = simdTrue();
+			for (int p = 0; p < LveFrustum::PLANE_COUNT; ++p) {
+				SimdFloat distance = simdAdd(
+					simdAdd(simdMul(planeX[p], x), simdMul(planeY[p], y)),
+					simdAdd(simdMul(planeZ[p], z), planeW[p]));
+				SimdFloat radius = simdAdd(
+					simdAdd(simdMul(absPlaneX[p], ex), simdMul(absPlaneY[p], ey)),
+					simdMul(absPlaneZ[p], ez));
+				inside = simdAnd(inside, simdGreaterEqual(distance, simdSub(zero, radius)));
+			}
+			appendLanes(simdMask(inside), i, SIMD_WIDTH, visible);
+		}
+#endif
+		for (; i < boxes.size(); ++i) {
+			if (boxVisible(frustum, boxes, i)) {
+				visible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	// *************** Object Culler *********************
+
+	const std::vector<LveGameObject*>& LveObjectCuller::cull(const LveFrustum& frustum, LveGameObject::Map& gameObjects)
+	{
+		_spheres.clear();
+		_candidates.clear();
+		_visibleIndices.clear();
+		_visibleObjects.clear();
+
+		for (auto& kv : gameObjects) {
+			auto& obj = kv.second;
+			if (obj.model == nullptr) continue;
+
+			const glm::vec4& sphere = obj.model->getBoundingSphere();
+			glm::vec3 scale = glm::abs(obj.transform.scale);
+			float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+			glm::vec3 center = glm::vec3(obj.transform.mat4() * glm::vec4(glm::vec3(sphere), 1.f));
+
+			_spheres.add(center, sphere.w * maxScale);
+			_candidates.push_back(&obj);
+		}
+
+		cullSpheres(frustum, _spheres, _visibleIndices);
+		for (uint32_t index : _visibleIndices) {
+			_visibleObjects.push_back(_candidates[index]);
+		}
+
+		_stats.tested = static_cast<uint32_t>(_candidates.size());
+		_stats.visible = static_cast<uint32_t>(_visibleObjects.size());
+		return _visibleObjects;
+	}
+
+	// *************** Benchmark *********************
+
+	void runCullingBenchmark(std::ostream& out)
+	{
+		LveCamera camera{};
+		camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, .1f, 100.f);
+		camera.setViewDirection(glm::vec3(0.f), glm::vec3(0.f, 0.f, 1.f));
+		LveFrustum frustum = camera.getFrustum();
+
+		std::mt19937 random{ 1234 };
+		std::uniform_real_distribution<float> position{ -100.f, 100.f };
+		std::uniform_real_distribution<float> size{ .1f, 2.f };
+
+		out << "Frustum culling benchmark, vector kernel: " << cullingKernelName() << "\n";
+		for (size_t objectCount : { size_t{ 10000 }, size_t{ 100000 }, size_t{ 1000000 } }) {
+			LveSphereBatch spheres;
+			LveBoxBatch boxes;
+			spheres.reserve(objectCount);
+			boxes.reserve(objectCount);
+			for (size_t i = 0; i < objectCount; ++i) {
+				glm::vec3 center{ position(random), position(random), position(random) };
+				float extent = size(random);
+				spheres.add(center, extent * std::sqrt(3.f));
+				boxes.add(center, glm::vec3(extent));
+			}
+
+			// roughly 10M tests per measurement regardless of the object count
+			size_t iterations = std::max<size_t>(1, 10000000 / objectCount);
+			std::vector<uint32_t> visible;
+			visible.reserve(objectCount);
+
+			auto measure = [&](const char* name, auto kernel, const auto& batch) {
+				size_t visibleCount = 0;
+				auto start = std::chrono::high_resolution_clock::now();
+				for (size_t iteration = 0; iteration < iterations; ++iteration) {
+					visible.clear();
+					kernel(frustum, batch, visible);
+					visibleCount = visible.size();
+				}
+				double milliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(
+					std::chrono::high_resolution_clock::now() - start).count() / iterations;
+				out << "  " << objectCount << " objects, " << name << ": " << milliseconds << " ms, "
+					<< milliseconds * 1e6 / objectCount << " ns/object, " << visibleCount << " visible\n";
+			};
+
+			measure("spheres scalar", cullSpheresScalar, spheres);
+			measure("spheres vector", cullSpheres, spheres);
+			measure("boxes scalar  ", cullBoxesScalar, boxes);
+			measure("boxes vector  ", cullBoxes, boxes);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "lve_camera.h"
+#include "lve_game_object.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace lve {
+
+	// World space bounding spheres in structure-of-arrays form, so the kernels can load
+	// one coordinate of several spheres with a single instruction.
+	struct LveSphereBatch {
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> radius;
+
+		size_t size() const { return radius.size(); }
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::vec3& center, float sphereRadius);
+	};
+
+	// World space axis-aligned boxes as center and half extents.
+	struct LveBoxBatch {
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+
+		size_t size() const { return centerX.size(); }
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::vec3& center, const glm::vec3& extent);
+	};
+
+	// Appends the index of every volume that is not fully outside one of the frustum planes.
+	// The vectorized kernels use AVX when the build targets it, SSE2 otherwise.
+	void cullSpheres(const LveFrustum& frustum, const LveSphereBatch& spheres, std::vector<uint32_t>& visible);
+	void cullBoxes(const LveFrustum& frustum, const LveBoxBatch& boxes, std::vector<uint32_t>& visible);
+	void cullSpheresScalar(const LveFrustum& frustum, const LveSphereBatch& spheres, std::vector<uint32_t>& visible);
+	void cullBoxesScalar(const LveFrustum& frustum, const LveBoxBatch& boxes, std::vector<uint32_t>& visible);
+	const char* cullingKernelName();
+
+	// Builds the visible object list each frame from the objects' model bounding spheres.
+	class LveObjectCuller {
+	public:
+		struct Stats {
+			uint32_t tested = 0;
+			uint32_t visible = 0;
+		};
+
+		// Objects without a model are skipped. The result stays valid until the next call.
+		const std::vector<LveGameObject*>& cull(const LveFrustum& frustum, LveGameObject::Map& gameObjects);
+
+		const std::vector<LveGameObject*>& getVisibleObjects() const { return _visibleObjects; }
+		const Stats& getStats() const { return _stats; }
+
+	private:
+		LveSphereBatch _spheres;
+		std::vector<LveGameObject*> _candidates;
+		std::vector<uint32_t> _visibleIndices;
+		std::vector<LveGameObject*> _visibleObjects;
+		Stats _stats{};
+	};
+
+	// Times the scalar and vectorized kernels at 10k, 100k and 1M random objects.
+	void runCullingBenchmark(std::ostream& out);
+}
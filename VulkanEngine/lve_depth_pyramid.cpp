@@ -0,0 +1,254 @@
+#include "lve_depth_pyramid.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+	struct DepthPyramidPushConstants {
+		int32_t sourceSize[2];
+		int32_t destinationSize[2];
+	};
+
+	LveDepthPyramid::LveDepthPyramid(LveDevice& device, VkPipelineCache pipelineCache)
+		: _lveDevice{ device }
+	{
+		_setLayout = LveDescriptorSetLayout::Builder(_lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		createPipeline(pipelineCache);
+		createSampler();
+	}
+
+	LveDepthPyramid::~LveDepthPyramid() {
+		destroyImage();
+		_pipeline.reset();
+		vkDestroySampler(_lveDevice.device(), _sampler, nullptr);
+		vkDestroyPipelineLayout(_lveDevice.device(), _pipelineLayout, nullptr);
+	}
+
+	void LveDepthPyramid::createPipeline(VkPipelineCache pipelineCache)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(DepthPyramidPushConstants);
+
+		VkDescriptorSetLayout setLayout = _setLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(_lveDevice.device(), &pipelineLayoutInfo, nullptr,
+			&_pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout.");
+		}
+
+		_pipeline = std::make_unique<LveComputePipeline>(
+			_lveDevice, "shaders/depth_pyramid.comp.spv", _pipelineLayout,
+			LveSpecializationConstants{}, pipelineCache);
+	}
+
+	void LveDepthPyramid::createSampler()
+	{
+		// only read with texelFetch, filtering never applies
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		if (vkCreateSampler(_lveDevice.device(), &samplerInfo, nullptr, &_sampler) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid sampler.");
+		}
+	}
+
+	void LveDepthPyramid::destroyImage()
+	{
+		for (auto levelView : _levelViews) {
+			vkDestroyImageView(_lveDevice.device(), levelView, nullptr);
+		}
+		_levelViews.clear();
+		if (_image != VK_NULL_HANDLE) {
+			vkDestroyImageView(_lveDevice.device(), _imageView, nullptr);
+			vkDestroyImage(_lveDevice.device(), _image, nullptr);
+			vkFreeMemory(_lveDevice.device(), _imageMemory, nullptr);
+		}
+		_imageView = VK_NULL_HANDLE;
+		_image = VK_NULL_HANDLE;
+		_imageMemory = VK_NULL_HANDLE;
+
+		_levelDescriptorSets.clear();
+		_depthDescriptorSets.clear();
+		_descriptorPool.reset();
+	}
+
+	void LveDepthPyramid::resize(VkExtent2D depthExtent, const std::vector<VkImageView>& depthViews)
+	{
+		if (_image != VK_NULL_HANDLE) {
+			vkDeviceWaitIdle(_lveDevice.device());
+		}
+		destroyImage();
+
+		_depthExtent = depthExtent;
+		_levelExtents.clear();
+		VkExtent2D levelExtent{ std::max(depthExtent.width / 2, 1u), std::max(depthExtent.height / 2, 1u) };
+		while (true) {
+			_levelExtents.push_back(levelExtent);
+			if (levelExtent.width == 1 && levelExtent.height == 1) break;
+			levelExtent = { std::max(levelExtent.width / 2, 1u), std::max(levelExtent.height / 2, 1u) };
+		}
+		uint32_t levelCount = getLevelCount();
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { _levelExtents[0].width, _levelExtents[0].height, 1 };
+		imageInfo.mipLevels = levelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		_lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _image, _imageMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = _image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = levelCount;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(_lveDevice.device(), &viewInfo, nullptr, &_imageView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid view.");
+		}
+
+		_levelViews.resize(levelCount);
+		viewInfo.subresourceRange.levelCount = 1;
+		for (uint32_t level = 0; level < levelCount; ++level) {
+			viewInfo.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(_lveDevice.device(), &viewInfo, nullptr, &_levelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create depth pyramid view.");
+			}
+		}
+
+		// the pyramid never leaves GENERAL, it is written as storage and read as sampled
+		VkCommandBuffer commandBuffer = _lveDevice.beginSingleTimeCommands();
+		VkImageMemoryBarrier layoutBarrier{};
+		layoutBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		layoutBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		layoutBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		layoutBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		layoutBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		layoutBarrier.image = _image;
+		layoutBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+		layoutBarrier.srcAccessMask = 0;
+		layoutBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &layoutBarrier);
+		_lveDevice.endSingleTimeCommands(commandBuffer);
+
+		uint32_t setCount = levelCount - 1 + static_cast<uint32_t>(depthViews.size());
+		if (setCount == 0) return;
+
+		_descriptorPool = LveDescriptorPool::Builder(_lveDevice)
+			.setMaxSets(setCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+			.build();
+
+		auto writeSet = [this](VkImageView sourceView, VkImageLayout sourceLayout, uint32_t level) {
+			VkDescriptorImageInfo sourceInfo{ _sampler, sourceView, sourceLayout };
+			VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, _levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorSet set;
+			if (!LveDescriptorWriter(*_setLayout, *_descriptorPool)
+				.writeImage(0, &sourceInfo)
+				.writeImage(1, &destinationInfo)
+				.build(set))
+			{
+				throw std::runtime_error("Failed to allocate depth pyramid descriptor set.");
+			}
+			return set;
+		};
+
+		for (auto depthView : depthViews) {
+			_depthDescriptorSets.push_back(
+				writeSet(depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 0));
+		}
+		_levelDescriptorSets.resize(levelCount, VK_NULL_HANDLE);
+		for (uint32_t level = 1; level < levelCount; ++level) {
+			_levelDescriptorSets[level] = writeSet(_levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL, level);
+		}
+	}
+
+	void LveDepthPyramid::build(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		assert(canBuild() && "Depth pyramid was created without depth views.");
+		assert(imageIndex < _depthDescriptorSets.size() && "No depth view for this swap chain image.");
+
+		// last frame's culling may still be reading the levels about to be overwritten
+		VkMemoryBarrier readBarrier{};
+		readBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		readBarrier.srcAccessMask = 0;
+		readBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &readBarrier, 0, nullptr, 0, nullptr);
+
+		_pipeline->bind(commandBuffer);
+		VkExtent2D sourceExtent = _depthExtent;
+		for (uint32_t level = 0; level < getLevelCount(); ++level) {
+			VkExtent2D levelExtent = _levelExtents[level];
+			VkDescriptorSet set = level == 0 ? _depthDescriptorSets[imageIndex] : _levelDescriptorSets[level];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+				_pipelineLayout, 0, 1, &set, 0, nullptr);
+
+			DepthPyramidPushConstants push{};
+			push.sourceSize[0] = static_cast<int32_t>(sourceExtent.width);
+			push.sourceSize[1] = static_cast<int32_t>(sourceExtent.height);
+			push.destinationSize[0] = static_cast<int32_t>(levelExtent.width);
+			push.destinationSize[1] = static_cast<int32_t>(levelExtent.height);
+			vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+				0, sizeof(DepthPyramidPushConstants), &push);
+			vkCmdDispatch(commandBuffer,
+				LveComputePipeline::groupCount(levelExtent.width, LOCAL_SIZE),
+				LveComputePipeline::groupCount(levelExtent.height, LOCAL_SIZE), 1);
+
+			// the next level, or the culling pass after the last one, reads this level
+			VkMemoryBarrier levelBarrier{};
+			levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			sourceExtent = levelExtent;
+		}
+	}
+
+	VkDescriptorImageInfo LveDepthPyramid::descriptorInfo() const
+	{
+		assert(isCreated() && "Depth pyramid has not been created.");
+		return VkDescriptorImageInfo{ _sampler, _imageView, VK_IMAGE_LAYOUT_GENERAL };
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_compute_pipeline.h"
+#include "lve_descriptors.h"
+
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+	// Hierarchical depth buffer for occlusion culling. Level 0 is half the depth attachment and
+	// every texel holds the farthest depth of the texels it covers, so a sphere whose nearest
+	// point is behind a texel of a level that covers its screen rectangle is hidden. Built with
+	// a compute pass per level and kept in VK_IMAGE_LAYOUT_GENERAL.
+	class LveDepthPyramid {
+	public:
+		static constexpr uint32_t LOCAL_SIZE = 8;
+
+		LveDepthPyramid(LveDevice& device, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		~LveDepthPyramid();
+
+		LveDepthPyramid(const LveDepthPyramid&) = delete;
+		LveDepthPyramid& operator=(const LveDepthPyramid&) = delete;
+
+		// Recreates the pyramid for depth attachments of depthExtent, one view per swap chain image.
+		// The views must be sampleable, an empty list creates a pyramid that can be bound but not
+		// built. Waits for the device if a previous pyramid may still be in use.
+		void resize(VkExtent2D depthExtent, const std::vector<VkImageView>& depthViews);
+
+		// Reduces the depth attachment of imageIndex into every level. The attachment must be in
+		// VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL with its writes visible to compute shaders.
+		// Leaves the pyramid visible to compute shader reads.
+		void build(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+		bool isCreated() const { return _image != VK_NULL_HANDLE; }
+		bool canBuild() const { return !_depthDescriptorSets.empty(); }
+		VkExtent2D getDepthExtent() const { return _depthExtent; }
+		uint32_t getLevelCount() const { return static_cast<uint32_t>(_levelExtents.size()); }
+
+		// All levels, for sampling with texelFetch.
+		VkDescriptorImageInfo descriptorInfo() const;
+
+	private:
+		void createPipeline(VkPipelineCache pipelineCache);
+		void createSampler();
+		void destroyImage();
+
+		LveDevice& _lveDevice;
+
+		std::unique_ptr<LveDescriptorSetLayout> _setLayout;
+		std::unique_ptr<LveDescriptorPool> _descriptorPool;
+		VkPipelineLayout _pipelineLayout;
+		std::unique_ptr<LveComputePipeline> _pipeline;
+		VkSampler _sampler = VK_NULL_HANDLE;
+
+		VkExtent2D _depthExtent{};
+		std::vector<VkExtent2D> _levelExtents;
+		VkImage _image = VK_NULL_HANDLE;
+		VkDeviceMemory _imageMemory = VK_NULL_HANDLE;
+		VkImageView _imageView = VK_NULL_HANDLE;
+		std::vector<VkImageView> _levelViews;
+
+		// set i reduces level i - 1 into level i, level 0 has one set per depth attachment
+		std::vector<VkDescriptorSet> _levelDescriptorSets;
+		std::vector<VkDescriptorSet> _depthDescriptorSets;
+	};
+}
@@ -1,4 +1,5 @@
 #include "lve_device.h"
+#include "lve_shader_cache.h"
 
 // std headers
 #include <cstring>
@@ -48,16 +49,19 @@ namespace lve {
     }
 
     // class member functions
-    LveDevice::LveDevice(LveWindow& window) : window{ window } {
+    LveDevice::LveDevice(LveWindow& window) : window{ window }, headless_{ window.isHeadless() } {
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        loadDeviceFunctions();
         createCommandPool();
+        shaderModuleCache_ = std::make_unique<LveShaderModuleCache>(*this);
     }
 
     LveDevice::~LveDevice() {
+        shaderModuleCache_.reset();
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -65,7 +69,9 @@ namespace lve {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface_, nullptr);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface_, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
     }
 
@@ -80,7 +86,7 @@ namespace lve {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -151,18 +157,127 @@ namespace lve {
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
+        // query optional features through the pNext chain, then enable exactly what is supported
+        auto availableExtensions = getAvailableDeviceExtensions(physicalDevice);
+        std::vector<const char*> enabledExtensions = getRequiredDeviceExtensions();
+
+        VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+        dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamicState2Features{};
+        dynamicState2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+        dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+        synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+        void* featureChain = nullptr;
+        if (availableExtensions.count(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+            dynamicStateFeatures.pNext = featureChain;
+            featureChain = &dynamicStateFeatures;
+        }
+        if (availableExtensions.count(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+            dynamicState2Features.pNext = featureChain;
+            featureChain = &dynamicState2Features;
+        }
+        if (availableExtensions.count(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            dynamicState3Features.pNext = featureChain;
+            featureChain = &dynamicState3Features;
+        }
+        if (availableExtensions.count(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+            synchronization2Features.pNext = featureChain;
+            featureChain = &synchronization2Features;
+        }
+        // on Vulkan 1.1 dynamic rendering depends on depth stencil resolve and create renderpass 2
+        bool dynamicRenderingAvailable = availableExtensions.count(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)
+            && availableExtensions.count(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME)
+            && availableExtensions.count(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+        if (dynamicRenderingAvailable) {
+            dynamicRenderingFeatures.pNext = featureChain;
+            featureChain = &dynamicRenderingFeatures;
+        }
+
+        VkPhysicalDeviceFeatures2 supportedFeatures{};
+        supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures.pNext = featureChain;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+        features_.extendedDynamicState = dynamicStateFeatures.extendedDynamicState == VK_TRUE;
+        features_.extendedDynamicState2 = dynamicState2Features.extendedDynamicState2 == VK_TRUE;
+        features_.fillModeNonSolid = supportedFeatures.features.fillModeNonSolid == VK_TRUE;
+        features_.extendedDynamicState3PolygonMode =
+            dynamicState3Features.extendedDynamicState3PolygonMode == VK_TRUE && features_.fillModeNonSolid;
+        features_.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+        features_.drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+        features_.pipelineStatisticsQuery = supportedFeatures.features.pipelineStatisticsQuery == VK_TRUE;
+        features_.drawIndirectCount = availableExtensions.count(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) != 0;
+        features_.synchronization2 = synchronization2Features.synchronization2 == VK_TRUE;
+        features_.dynamicRendering = dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+        features_.memoryBudget = availableExtensions.count(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) != 0;
+
+        // reuse the query structs as the enable chain, keeping only the features we use
+        void* enabledChain = nullptr;
+        if (features_.extendedDynamicState) {
+            enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+            dynamicStateFeatures.pNext = enabledChain;
+            enabledChain = &dynamicStateFeatures;
+        }
+        if (features_.extendedDynamicState2) {
+            enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+            dynamicState2Features.extendedDynamicState2LogicOp = VK_FALSE;
+            dynamicState2Features.extendedDynamicState2PatchControlPoints = VK_FALSE;
+            dynamicState2Features.pNext = enabledChain;
+            enabledChain = &dynamicState2Features;
+        }
+        if (features_.extendedDynamicState3PolygonMode) {
+            enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+            dynamicState3Features = {};
+            dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+            dynamicState3Features.extendedDynamicState3PolygonMode = VK_TRUE;
+            dynamicState3Features.pNext = enabledChain;
+            enabledChain = &dynamicState3Features;
+        }
+
+        if (features_.synchronization2) {
+            enabledExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            synchronization2Features.pNext = enabledChain;
+            enabledChain = &synchronization2Features;
+        }
+
+        if (features_.dynamicRendering) {
+            enabledExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+            enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            dynamicRenderingFeatures.pNext = enabledChain;
+            enabledChain = &dynamicRenderingFeatures;
+        }
+
+        if (features_.drawIndirectCount) {
+            enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+
+        if (features_.memoryBudget) {
+            enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.fillModeNonSolid = features_.fillModeNonSolid ? VK_TRUE : VK_FALSE;
+        deviceFeatures.multiDrawIndirect = features_.multiDrawIndirect ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = features_.drawIndirectFirstInstance ? VK_TRUE : VK_FALSE;
+        deviceFeatures.pipelineStatisticsQuery = features_.pipelineStatisticsQuery ? VK_TRUE : VK_FALSE;
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = enabledChain;
 
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -182,6 +297,47 @@ namespace lve {
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
     }
 
+    void LveDevice::loadDeviceFunctions() {
+        if (features_.extendedDynamicState) {
+            functions_.cmdSetCullMode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetCullModeEXT"));
+            functions_.cmdSetFrontFace = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetFrontFaceEXT"));
+            functions_.cmdSetPrimitiveTopology = reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetPrimitiveTopologyEXT"));
+            functions_.cmdSetDepthTestEnable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetDepthTestEnableEXT"));
+            functions_.cmdSetDepthWriteEnable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetDepthWriteEnableEXT"));
+            functions_.cmdSetDepthCompareOp = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetDepthCompareOpEXT"));
+        }
+        if (features_.extendedDynamicState2) {
+            functions_.cmdSetPrimitiveRestartEnable = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetPrimitiveRestartEnableEXT"));
+            functions_.cmdSetDepthBiasEnable = reinterpret_cast<PFN_vkCmdSetDepthBiasEnableEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetDepthBiasEnableEXT"));
+        }
+        if (features_.extendedDynamicState3PolygonMode) {
+            functions_.cmdSetPolygonMode = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(
+                vkGetDeviceProcAddr(device_, "vkCmdSetPolygonModeEXT"));
+        }
+        if (features_.drawIndirectCount) {
+            functions_.cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+        if (features_.synchronization2) {
+            functions_.cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdPipelineBarrier2KHR"));
+        }
+        if (features_.dynamicRendering) {
+            functions_.cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+            functions_.cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+        }
+    }
+
     void LveDevice::createCommandPool() {
         QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
 
@@ -196,15 +352,22 @@ namespace lve {
         }
     }
 
-    void LveDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+    void LveDevice::createSurface() {
+        if (headless_) {
+            surface_ = VK_NULL_HANDLE;
+            return;
+        }
+        window.createWindowSurface(instance, &surface_);
+    }
 
     bool LveDevice::isDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        // headless rendering goes to images the swap chain creates itself
+        bool swapChainAdequate = headless_;
+        if (extensionsSupported && !headless_) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -264,11 +427,14 @@ namespace lve {
     }
 
     std::vector<const char*> LveDevice::getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char*> extensions;
+        // the surface extensions, GLFW is not initialized without a window
+        if (!headless_) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -300,6 +466,24 @@ namespace lve {
         }
     }
 
+    std::set<std::string> LveDevice::getAvailableDeviceExtensions(VkPhysicalDevice device) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+            device,
+            nullptr,
+            &extensionCount,
+            availableExtensions.data());
+
+        std::set<std::string> available;
+        for (const auto& extension : availableExtensions) {
+            available.insert(extension.extensionName);
+        }
+        return available;
+    }
+
     bool LveDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -311,6 +495,7 @@ namespace lve {
             &extensionCount,
             availableExtensions.data());
 
+        auto deviceExtensions = getRequiredDeviceExtensions();
         std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
         for (const auto& extension : availableExtensions) {
@@ -320,6 +505,13 @@ namespace lve {
         return requiredExtensions.empty();
     }
 
+    std::vector<const char*> LveDevice::getRequiredDeviceExtensions() const {
+        if (headless_) {
+            return {};
+        }
+        return deviceExtensions;
+    }
+
     QueueFamilyIndices LveDevice::findQueueFamilies(VkPhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -336,7 +528,13 @@ namespace lve {
                 indices.graphicsFamilyHasValue = true;
             }
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            if (headless_) {
+                // nothing is presented, the graphics queue stands in for the present queue
+                presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+            }
+            else {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -380,20 +578,46 @@ namespace lve {
     VkFormat LveDevice::findSupportedFormat(
         const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
         for (VkFormat format : candidates) {
-            VkFormatProperties props;
-            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-                return format;
-            }
-            else if (
-                tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+            if (isFormatSupported(format, tiling, features)) {
                 return format;
             }
         }
         throw std::runtime_error("failed to find supported format!");
     }
 
+    bool LveDevice::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR) {
+            return (props.linearTilingFeatures & features) == features;
+        }
+        return (props.optimalTilingFeatures & features) == features;
+    }
+
+    LveDeviceMemoryUsage LveDevice::queryMemoryUsage() {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memProperties{};
+        memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memProperties.pNext = features_.memoryBudget ? &budgetProperties : nullptr;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+        LveDeviceMemoryUsage usage{};
+        usage.budgetKnown = features_.memoryBudget;
+        for (uint32_t i = 0; i < memProperties.memoryProperties.memoryHeapCount; i++) {
+            if ((memProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) {
+                continue;
+            }
+            usage.deviceLocalHeapSize += memProperties.memoryProperties.memoryHeaps[i].size;
+            if (usage.budgetKnown) {
+                usage.deviceLocalUsage += budgetProperties.heapUsage[i];
+                usage.deviceLocalBudget += budgetProperties.heapBudget[i];
+            }
+        }
+        return usage;
+    }
+
     uint32_t LveDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
         VkPhysicalDeviceMemoryProperties memProperties;
         vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
@@ -470,12 +694,13 @@ namespace lve {
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
-    void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+    void LveDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+        VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
         VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;  // Optional
-        copyRegion.dstOffset = 0;  // Optional
+        copyRegion.srcOffset = srcOffset;
+        copyRegion.dstOffset = dstOffset;
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
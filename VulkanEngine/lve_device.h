@@ -3,11 +3,15 @@
 #include "lve_window.h"
 
 // std lib headers
+#include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+    class LveShaderModuleCache;
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
@@ -22,6 +26,51 @@ namespace lve {
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    // Optional capabilities, detected and enabled when the logical device is created
+    struct LveDeviceFeatures {
+        bool extendedDynamicState = false;
+        bool extendedDynamicState2 = false;
+        bool extendedDynamicState3PolygonMode = false;
+        bool fillModeNonSolid = false;
+        bool multiDrawIndirect = false;
+        bool drawIndirectFirstInstance = false;
+        bool drawIndirectCount = false;
+        // vkCmdPipelineBarrier2, LveRenderGraph falls back to vkCmdPipelineBarrier without it
+        bool synchronization2 = false;
+        // vkCmdBeginRendering on image views, without render pass and framebuffer objects
+        bool dynamicRendering = false;
+        // VK_QUERY_TYPE_PIPELINE_STATISTICS query pools
+        bool pipelineStatisticsQuery = false;
+        // per heap usage and budget of this process in vkGetPhysicalDeviceMemoryProperties2
+        bool memoryBudget = false;
+    };
+
+    // Usage and budget are this process's allocations on the device local heaps and what the
+    // driver suggests it stays under, both only known with VK_EXT_memory_budget
+    struct LveDeviceMemoryUsage {
+        VkDeviceSize deviceLocalHeapSize = 0;
+        bool budgetKnown = false;
+        VkDeviceSize deviceLocalUsage = 0;
+        VkDeviceSize deviceLocalBudget = 0;
+    };
+
+    // Extension entry points are not exported by the loader, they are fetched per device
+    struct LveDeviceFunctions {
+        PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+        PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace = nullptr;
+        PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+        PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+        PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+        PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
+        PFN_vkCmdSetPrimitiveRestartEnableEXT cmdSetPrimitiveRestartEnable = nullptr;
+        PFN_vkCmdSetDepthBiasEnableEXT cmdSetDepthBiasEnable = nullptr;
+        PFN_vkCmdSetPolygonModeEXT cmdSetPolygonMode = nullptr;
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
+        PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2 = nullptr;
+        PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+        PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+    };
+
     class LveDevice {
     public:
 #ifdef NDEBUG
@@ -44,12 +93,21 @@ namespace lve {
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        LveShaderModuleCache& shaderModuleCache() { return *shaderModuleCache_; }
+        const LveDeviceFeatures& features() const { return features_; }
+        const LveDeviceFunctions& functions() const { return functions_; }
+        // Created for a headless window: no surface, no swap chain extension and the present
+        // queue is the graphics queue.
+        bool isHeadless() const { return headless_; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(
             const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+        bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
+        // Summed over all device local heaps
+        LveDeviceMemoryUsage queryMemoryUsage();
 
         // Buffer Helper Functions
         void createBuffer(
@@ -60,7 +118,8 @@ namespace lve {
             VkDeviceMemory& bufferMemory);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+            VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
         void copyBufferToImage(
             VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -79,6 +138,7 @@ namespace lve {
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void loadDeviceFunctions();
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,12 +148,15 @@ namespace lve {
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        std::vector<const char*> getRequiredDeviceExtensions() const;
+        std::set<std::string> getAvailableDeviceExtensions(VkPhysicalDevice device);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         LveWindow& window;
+        bool headless_;
         VkCommandPool commandPool;
 
         VkDevice device_;
@@ -101,6 +164,10 @@ namespace lve {
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
 
+        std::unique_ptr<LveShaderModuleCache> shaderModuleCache_;
+        LveDeviceFeatures features_{};
+        LveDeviceFunctions functions_{};
+
         const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
         const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     };
@@ -0,0 +1,240 @@
+#include "lve_draw_queue.h"
+#include "lve_gpu_profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+namespace lve {
+
+	void LveDrawQueue::begin() {
+		_packets.clear();
+		_pipelines.clear();
+		_models.resize(1);
+		_modelSlots.clear();
+	}
+
+	uint32_t LveDrawQueue::pipelineSlot(LvePipeline& pipeline, LveDrawQueueClient& client) {
+		// a frame binds a handful of pipelines, a linear scan is cheaper than hashing
+		for (size_t i = 0; i < _pipelines.size(); ++i) {
+			if (_pipelines[i].pipeline == &pipeline) return static_cast<uint32_t>(i);
+		}
+		assert(_pipelines.size() < (size_t{ 1 } << PIPELINE_BITS) && "Too many pipelines in one frame.");
+		_pipelines.push_back({ &pipeline, &client });
+		return static_cast<uint32_t>(_pipelines.size() - 1);
+	}
+
+	uint32_t LveDrawQueue::modelSlot(LveModel& model) {
+		auto it = _modelSlots.find(&model);
+		if (it != _modelSlots.end()) return it->second;
+
+		assert(_models.size() < (size_t{ 1 } << MODEL_BITS) && "Too many models in one frame.");
+		uint32_t slot = static_cast<uint32_t>(_models.size());
+		_models.push_back(&model);
+		_modelSlots.emplace(&model, slot);
+		return slot;
+	}
+
+	uint64_t LveDrawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t depth) {
+		assert(pass < (1u << PASS_BITS) && "Pass out of range.");
+		assert(material < (1u << MATERIAL_BITS) && "Material out of range.");
+		return (uint64_t{ pass } << PASS_SHIFT)
+			| (uint64_t{ pipeline } << PIPELINE_SHIFT)
+			| (uint64_t{ material } << MATERIAL_SHIFT)
+			| (uint64_t{ model } << MODEL_SHIFT)
+			| (uint64_t{ depth & ((1u << DEPTH_BITS) - 1) } << DEPTH_SHIFT);
+	}
+
+	uint32_t LveDrawQueue::quantizeDepth(float viewDepth) {
+		// bits of a non-negative float grow with its value, the top bits keep exponent and
+		// leading mantissa, which gives finer steps close to the camera
+		viewDepth = std::max(viewDepth, 0.f);
+		uint32_t bits;
+		std::memcpy(&bits, &viewDepth, sizeof(bits));
+		return bits >> (31 - DEPTH_BITS);
+	}
+
+	uint32_t LveDrawQueue::quantizeDepthBackToFront(float viewDepth) {
+		return ((1u << DEPTH_BITS) - 1) - quantizeDepth(viewDepth);
+	}
+
+	void LveDrawQueue::radixSort(std::vector<LveDrawPacket>& packets, std::vector<LveDrawPacket>& scratch) {
+		const size_t count = packets.size();
+		if (count < 2) return;
+		scratch.resize(count);
+
+		// one histogram pass for all eight digits
+		std::array<std::array<uint32_t, 256>, 8> histograms{};
+		for (const auto& packet : packets) {
+			for (uint32_t digit = 0; digit < 8; ++digit) {
+				histograms[digit][(packet.key >> (digit * 8)) & 0xff]++;
+			}
+		}
+
+		LveDrawPacket* source = packets.data();
+		LveDrawPacket* destination = scratch.data();
+		for (uint32_t digit = 0; digit < 8; ++digit) {
+			auto& histogram = histograms[digit];
+			uint32_t firstKeyBucket = (source[0].key >> (digit * 8)) & 0xff;
+			if (histogram[firstKeyBucket] == count) continue;
+
+			uint32_t offset = 0;
+			for (auto& bucket : histogram) {
+				uint32_t bucketCount = bucket;
+				bucket = offset;
+				offset += bucketCount;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				destination[histogram[(source[i].key >> (digit * 8)) & 0xff]++] = source[i];
+			}
+			std::swap(source, destination);
+		}
+
+		if (source != packets.data()) {
+			packets.swap(scratch);
+		}
+	}
+
+	void LveDrawQueue::sortAndBuildRuns() {
+		radixSort(_packets, _scratch);
+		_runs.clear();
+		_modelPackets = 0;
+
+		// packets that differ only in depth are drawn as one run
+		const uint64_t runMask = ~((uint64_t{ 1 } << MODEL_SHIFT) - 1);
+		std::vector<std::pair<LveDrawQueueClient*, uint32_t>> clientPackets;
+
+		uint32_t runStart = 0;
+		const uint32_t packetCount = static_cast<uint32_t>(_packets.size());
+		while (runStart < packetCount) {
+			uint64_t runKey = _packets[runStart].key & runMask;
+			uint32_t runEnd = runStart + 1;
+			while (runEnd < packetCount && (_packets[runEnd].key & runMask) == runKey) {
+				runEnd++;
+			}
+
+			LveDrawQueueClient* client = _pipelines[field(runKey, PIPELINE_SHIFT, PIPELINE_BITS)].client;
+			auto counter = std::find_if(clientPackets.begin(), clientPackets.end(),
+				[client](const std::pair<LveDrawQueueClient*, uint32_t>& entry) { return entry.first == client; });
+			if (counter == clientPackets.end()) {
+				clientPackets.emplace_back(client, 0);
+				counter = clientPackets.end() - 1;
+			}
+
+			_runs.push_back({ runStart, runEnd - runStart, counter->second });
+			counter->second += runEnd - runStart;
+			if (field(runKey, MODEL_SHIFT, MODEL_BITS) != NO_MODEL) {
+				_modelPackets += runEnd - runStart;
+			}
+			runStart = runEnd;
+		}
+	}
+
+	const char* LveDrawQueue::passName(uint32_t pass) {
+		switch (pass) {
+		case PASS_DEPTH_PREPASS: return "depth pre-pass";
+		case PASS_OPAQUE: return "opaque";
+		case PASS_LIGHTS: return "lights";
+		default: return "other pass";
+		}
+	}
+
+	void LveDrawQueue::recordPackets(FrameInfo& frameInfo, uint32_t begin, uint32_t end, Stats& stats) const {
+		if (begin >= end) return;
+
+		// the run containing begin, a slice may start in the middle of one
+		auto run = std::upper_bound(_runs.begin(), _runs.end(), begin,
+			[](uint32_t packet, const Run& candidate) { return packet < candidate.first; }) - 1;
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		uint32_t boundPipeline = UINT32_MAX;
+		uint32_t boundModel = NO_MODEL;
+		const LveDrawPacket* previous = nullptr;
+		// each pass is one GPU profiler scope, passes are sorted so they are contiguous
+		uint32_t scopePass = UINT32_MAX;
+		uint32_t scope = LveGpuProfiler::INVALID_SCOPE;
+
+		for (; run != _runs.end() && run->first < end; ++run) {
+			uint32_t first = std::max(run->first, begin);
+			uint32_t last = std::min(run->first + run->count, end);
+			uint64_t key = _packets[first].key;
+
+			uint32_t pass = field(key, PASS_SHIFT, PASS_BITS);
+			if (frameInfo.gpuProfiler && pass != scopePass) {
+				frameInfo.gpuProfiler->endScope(commandBuffer, scope);
+				scope = frameInfo.gpuProfiler->beginScope(commandBuffer, passName(pass));
+				scopePass = pass;
+			}
+
+			uint32_t pipelineIndex = field(key, PIPELINE_SHIFT, PIPELINE_BITS);
+			const PipelineSlot& slot = _pipelines[pipelineIndex];
+			if (pipelineIndex != boundPipeline) {
+				slot.pipeline->bind(commandBuffer);
+				slot.client->onPipelineBound(frameInfo);
+				boundPipeline = pipelineIndex;
+				previous = nullptr;
+				stats.pipelineBinds++;
+			}
+
+			uint32_t modelIndex = field(key, MODEL_SHIFT, MODEL_BITS);
+			if (modelIndex != NO_MODEL && modelIndex != boundModel) {
+				_models[modelIndex]->bind(commandBuffer);
+				boundModel = modelIndex;
+				stats.modelBinds++;
+			}
+
+			LveDrawRun drawRun{ &_packets[first], last - first, run->clientIndex + (first - run->first), previous };
+			slot.client->drawPackets(frameInfo, drawRun);
+			previous = &_packets[last - 1];
+			stats.runs++;
+		}
+
+		if (frameInfo.gpuProfiler) {
+			frameInfo.gpuProfiler->endScope(commandBuffer, scope);
+		}
+	}
+
+	void LveDrawQueue::finishStats(Stats& stats) const {
+		stats.packets = static_cast<uint32_t>(_packets.size());
+		stats.pipelineBindsAvoided = stats.packets - stats.pipelineBinds;
+		stats.modelBindsAvoided = _modelPackets - stats.modelBinds;
+	}
+
+	void LveDrawQueue::execute(FrameInfo& frameInfo) {
+		sortAndBuildRuns();
+
+		_stats = Stats{};
+		recordPackets(frameInfo, 0, static_cast<uint32_t>(_packets.size()), _stats);
+		finishStats(_stats);
+	}
+
+	void LveDrawQueue::execute(FrameInfo& frameInfo, LveParallelRecorder& recorder) {
+		sortAndBuildRuns();
+
+		_stats = Stats{};
+		const uint32_t packetCount = static_cast<uint32_t>(_packets.size());
+		if (packetCount > 0) {
+			uint32_t sliceCount = std::min(
+				std::max(packetCount / MIN_PACKETS_PER_SLICE, 1u), recorder.getWorkerCount());
+			std::vector<Stats> sliceStats(sliceCount);
+
+			recorder.record(sliceCount, [&](uint32_t slice, VkCommandBuffer commandBuffer) {
+				FrameInfo sliceInfo = frameInfo;
+				sliceInfo.commandBuffer = commandBuffer;
+				// the profiler records into the primary from one thread, the caller times the whole pass
+				sliceInfo.gpuProfiler = nullptr;
+				uint32_t begin = static_cast<uint32_t>(uint64_t{ packetCount } * slice / sliceCount);
+				uint32_t end = static_cast<uint32_t>(uint64_t{ packetCount } * (slice + 1) / sliceCount);
+				recordPackets(sliceInfo, begin, end, sliceStats[slice]);
+			});
+
+			for (const auto& stats : sliceStats) {
+				_stats.runs += stats.runs;
+				_stats.pipelineBinds += stats.pipelineBinds;
+				_stats.modelBinds += stats.modelBinds;
+			}
+		}
+		finishStats(_stats);
+	}
+}
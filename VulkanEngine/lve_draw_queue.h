@@ -0,0 +1,155 @@
+#pragma once
+
+#include "lve_frame_info.h"
+#include "lve_model.h"
+#include "lve_parallel_recorder.h"
+#include "lve_pipeline.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+	struct LveDrawPacket {
+		uint64_t key;
+		// meaning is up to the submitting client, usually an index into its per-frame data
+		uint32_t payload;
+	};
+
+	// Packets that share pass, pipeline, material and model, in sorted order.
+	struct LveDrawRun {
+		const LveDrawPacket* packets;
+		uint32_t count;
+		// position of packets[0] among the client's packets in sorted order, the same whichever
+		// thread records the run, so clients can use it to place per-packet data
+		uint32_t clientIndex;
+		// last packet the client drew into this command buffer since its pipeline was bound,
+		// null for the first run after a bind
+		const LveDrawPacket* previous;
+	};
+
+	// Implemented by render systems that submit packets to an LveDrawQueue. With parallel
+	// recording both calls happen concurrently on worker threads, each with its own command buffer
+	// in frameInfo, so they must not modify state shared between runs.
+	class LveDrawQueueClient {
+	public:
+		virtual ~LveDrawQueueClient() = default;
+
+		// Called after the queue bound one of this client's pipelines, bind layout-specific state here.
+		virtual void onPipelineBound(FrameInfo& frameInfo) = 0;
+
+		// Draws a run, the model (if any) is already bound.
+		virtual void drawPackets(FrameInfo& frameInfo, const LveDrawRun& run) = 0;
+	};
+
+	// Per-frame queue of draw packets from every render system. Packets are radix sorted by a
+	// 64-bit key, then executed front to back with pipeline and vertex buffer binds elided when
+	// consecutive packets share them.
+	//
+	// Key layout, most significant first:
+	//   pass 4 bits | pipeline 10 bits | material 10 bits | model 20 bits | depth 20 bits
+	class LveDrawQueue {
+	public:
+		static constexpr uint32_t PASS_BITS = 4;
+		static constexpr uint32_t PIPELINE_BITS = 10;
+		static constexpr uint32_t MATERIAL_BITS = 10;
+		static constexpr uint32_t MODEL_BITS = 20;
+		static constexpr uint32_t DEPTH_BITS = 20;
+
+		static constexpr uint32_t DEPTH_SHIFT = 0;
+		static constexpr uint32_t MODEL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+		static constexpr uint32_t MATERIAL_SHIFT = MODEL_SHIFT + MODEL_BITS;
+		static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+		static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+		// model slot used by packets that do not draw from an LveModel
+		static constexpr uint32_t NO_MODEL = 0;
+
+		enum Pass : uint32_t {
+			PASS_DEPTH_PREPASS = 0,
+			PASS_OPAQUE = 1,
+			PASS_LIGHTS = 2,
+		};
+
+		struct Stats {
+			uint32_t packets = 0;
+			// runs of packets handed to a client in one drawPackets call
+			uint32_t runs = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t modelBinds = 0;
+			// compared with binding the pipeline and model for every packet
+			uint32_t pipelineBindsAvoided = 0;
+			uint32_t modelBindsAvoided = 0;
+		};
+
+		LveDrawQueue() = default;
+		LveDrawQueue(const LveDrawQueue&) = delete;
+		LveDrawQueue& operator=(const LveDrawQueue&) = delete;
+
+		// Clears the packets and the pipeline and model slots of the previous frame.
+		void begin();
+
+		// Per-frame slot ids for the key, the same pipeline or model always gets the same slot.
+		uint32_t pipelineSlot(LvePipeline& pipeline, LveDrawQueueClient& client);
+		uint32_t modelSlot(LveModel& model);
+
+		void submit(uint64_t key, uint32_t payload) { _packets.push_back({ key, payload }); }
+
+		// Sorts and records every packet, call inside the render pass. With a GPU profiler in
+		// frameInfo each pass is timed as a scope named after it.
+		void execute(FrameInfo& frameInfo);
+		// Same, but records contiguous slices of the sorted packets into secondary command buffers
+		// on the recorder's workers. Each slice binds its own pipeline and model, so a run split
+		// across slices costs one extra bind and draw.
+		void execute(FrameInfo& frameInfo, LveParallelRecorder& recorder);
+
+		const Stats& getStats() const { return _stats; }
+
+		static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t model, uint32_t depth);
+		static uint32_t keyMaterial(uint64_t key) { return field(key, MATERIAL_SHIFT, MATERIAL_BITS); }
+
+		// View space depth (positive in front of the camera) mapped to DEPTH_BITS, nearest first.
+		static uint32_t quantizeDepth(float viewDepth);
+		// Farthest first, for blended passes.
+		static uint32_t quantizeDepthBackToFront(float viewDepth);
+
+		// LSD radix sort on the key, 8 bits per pass, skipping bytes every key shares. Stable.
+		static void radixSort(std::vector<LveDrawPacket>& packets, std::vector<LveDrawPacket>& scratch);
+
+		// slices smaller than this are not worth a secondary command buffer
+		static constexpr uint32_t MIN_PACKETS_PER_SLICE = 512;
+
+	private:
+		struct PipelineSlot {
+			LvePipeline* pipeline;
+			LveDrawQueueClient* client;
+		};
+
+		struct Run {
+			uint32_t first;
+			uint32_t count;
+			uint32_t clientIndex;
+		};
+
+		void sortAndBuildRuns();
+		void recordPackets(FrameInfo& frameInfo, uint32_t begin, uint32_t end, Stats& stats) const;
+		void finishStats(Stats& stats) const;
+		static const char* passName(uint32_t pass);
+
+		static uint32_t field(uint64_t key, uint32_t shift, uint32_t bits) {
+			return static_cast<uint32_t>((key >> shift) & ((uint64_t{ 1 } << bits) - 1));
+		}
+
+		std::vector<LveDrawPacket> _packets;
+		std::vector<LveDrawPacket> _scratch;
+		std::vector<Run> _runs;
+		uint32_t _modelPackets = 0;
+		std::vector<PipelineSlot> _pipelines;
+		// slot 0 is NO_MODEL
+		std::vector<LveModel*> _models{ nullptr };
+		// a scene may use thousands of models, looked up once per packet
+		std::unordered_map<LveModel*, uint32_t> _modelSlots;
+		Stats _stats{};
+	};
+}
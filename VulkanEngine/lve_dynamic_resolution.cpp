@@ -0,0 +1,195 @@
+#include "lve_dynamic_resolution.h"
+#include "lve_swap_chain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace lve {
+
+	LveResolutionController::LveResolutionController(const Settings& settings)
+		: _settings{ settings }, _scale{ settings.maxScale }
+	{
+		assert(settings.minScale > 0.0f && settings.minScale <= settings.maxScale
+			&& "Resolution scale bounds must satisfy 0 < minScale <= maxScale.");
+		assert(settings.budgetMilliseconds > 0.0f && "Frame time budget must be positive.");
+		assert(settings.smoothing > 0.0f && settings.smoothing <= 1.0f && "Smoothing must be in (0, 1].");
+	}
+
+	bool LveResolutionController::update(float gpuMilliseconds)
+	{
+		if (!(gpuMilliseconds > 0.0f)) {
+			return false;
+		}
+
+		_averageMilliseconds = _samples == 0
+			? gpuMilliseconds
+			: _averageMilliseconds + _settings.smoothing * (gpuMilliseconds - _averageMilliseconds);
+		_samples++;
+
+		if (_framesSinceChange < _settings.holdFrames) {
+			_framesSinceChange++;
+			return false;
+		}
+
+		// the pixel count that would land on the target time, scaled back to a side length
+		float lowerBound = _settings.budgetMilliseconds * (1.0f - _settings.headroom);
+		float targetMilliseconds;
+		if (_averageMilliseconds > _settings.budgetMilliseconds) {
+			targetMilliseconds = _settings.budgetMilliseconds;
+		}
+		else if (_averageMilliseconds < lowerBound) {
+			// aims for the middle of the band so the next sample does not cross the budget
+			targetMilliseconds = 0.5f * (lowerBound + _settings.budgetMilliseconds);
+		}
+		else {
+			return false;
+		}
+
+		float scale = _scale * std::sqrt(targetMilliseconds / _averageMilliseconds);
+		scale = std::clamp(scale, _scale - _settings.maxStep, _scale + _settings.maxStep);
+		scale = std::clamp(scale, _settings.minScale, _settings.maxScale);
+		// a bound was already reached, or the change is too small to be worth a different extent
+		if (std::abs(scale - _scale) < 0.01f) {
+			return false;
+		}
+
+		if (_pendingDecisions.size() == MAX_PENDING_DECISIONS) {
+			_pendingDecisions.erase(_pendingDecisions.begin());
+		}
+		_pendingDecisions.push_back({ _samples, _averageMilliseconds, _scale, scale });
+		_scale = scale;
+		_framesSinceChange = 0;
+		return true;
+	}
+
+	std::vector<LveResolutionController::Decision> LveResolutionController::takeDecisions()
+	{
+		std::vector<Decision> decisions;
+		decisions.swap(_pendingDecisions);
+		return decisions;
+	}
+
+	LveScaledRenderTarget::LveScaledRenderTarget(LveDevice& device, VkExtent2D swapchainExtent, float maxScale,
+		VkFormat colorFormat, VkFormat depthFormat, VkImageLayout presentLayout)
+		: _lveDevice{ device }, _swapchainExtent{ swapchainExtent },
+		_colorFormat{ colorFormat }, _depthFormat{ depthFormat }
+	{
+		_imageExtent = {
+			std::max(1u, static_cast<uint32_t>(std::ceil(swapchainExtent.width * maxScale))),
+			std::max(1u, static_cast<uint32_t>(std::ceil(swapchainExtent.height * maxScale))) };
+
+		_frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : _frames) {
+			createImage(_colorFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT, frame.colorImage, frame.colorMemory, frame.colorView);
+			createImage(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+				VK_IMAGE_ASPECT_DEPTH_BIT, frame.depthImage, frame.depthMemory, frame.depthView);
+		}
+
+		createUpscaleGraph(presentLayout);
+	}
+
+	LveScaledRenderTarget::~LveScaledRenderTarget()
+	{
+		for (auto& frame : _frames) {
+			vkDestroyImageView(_lveDevice.device(), frame.colorView, nullptr);
+			vkDestroyImage(_lveDevice.device(), frame.colorImage, nullptr);
+			vkFreeMemory(_lveDevice.device(), frame.colorMemory, nullptr);
+			vkDestroyImageView(_lveDevice.device(), frame.depthView, nullptr);
+			vkDestroyImage(_lveDevice.device(), frame.depthImage, nullptr);
+			vkFreeMemory(_lveDevice.device(), frame.depthMemory, nullptr);
+		}
+	}
+
+	bool LveScaledRenderTarget::isSupported(LveDevice& device, VkFormat colorFormat)
+	{
+		// swap chain images use optimal tiling, the same features cover both ends of the blit
+		return device.isFormatSupported(colorFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+	}
+
+	VkExtent2D LveScaledRenderTarget::scaledExtent(float scale) const
+	{
+		auto scaled = [scale](uint32_t size, uint32_t limit) {
+			uint32_t scaledSize = static_cast<uint32_t>(std::lround(static_cast<float>(size) * scale));
+			return std::clamp(scaledSize, 1u, limit);
+		};
+		return { scaled(_swapchainExtent.width, _imageExtent.width), scaled(_swapchainExtent.height, _imageExtent.height) };
+	}
+
+	void LveScaledRenderTarget::createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+		VkImage& image, VkDeviceMemory& memory, VkImageView& view)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { _imageExtent.width, _imageExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		_lveDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { aspect, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(_lveDevice.device(), &viewInfo, nullptr, &view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create scaled render target image view.");
+		}
+	}
+
+	void LveScaledRenderTarget::createUpscaleGraph(VkImageLayout presentLayout)
+	{
+		// the scene pass leaves the color image as an attachment, the swap chain image was last
+		// presented, its acquire semaphore is waited on at the color attachment output stage
+		_upscaleSource = _upscaleGraph.importImage("scaled color", _frames[0].colorImage, _frames[0].colorView,
+			_imageExtent, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_UNDEFINED, LveGraphUsage::COLOR_ATTACHMENT);
+		_upscaleDestination = _upscaleGraph.importImage("swap chain", VK_NULL_HANDLE, VK_NULL_HANDLE,
+			_swapchainExtent, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+			presentLayout, LveGraphUsage::COLOR_ATTACHMENT);
+
+		_upscaleGraph.addPass("upscale")
+			.use(_upscaleSource, LveGraphUsage::TRANSFER_SRC)
+			.use(_upscaleDestination, LveGraphUsage::TRANSFER_DST)
+			.record([this](VkCommandBuffer commandBuffer) {
+				VkImageBlit region{};
+				region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.srcOffsets[1] = {
+					static_cast<int32_t>(_upscaleExtent.width), static_cast<int32_t>(_upscaleExtent.height), 1 };
+				region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				region.dstOffsets[1] = {
+					static_cast<int32_t>(_swapchainExtent.width), static_cast<int32_t>(_swapchainExtent.height), 1 };
+				vkCmdBlitImage(commandBuffer,
+					_upscaleGraph.getImage(_upscaleSource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					_upscaleGraph.getImage(_upscaleDestination), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &region, VK_FILTER_LINEAR);
+			});
+
+		_upscaleGraph.compile(_lveDevice);
+	}
+
+	void LveScaledRenderTarget::upscale(VkCommandBuffer commandBuffer, int frameIndex, VkExtent2D renderExtent,
+		VkImage swapchainImage, VkImageView swapchainImageView)
+	{
+		assert(renderExtent.width <= _imageExtent.width && renderExtent.height <= _imageExtent.height
+			&& "Render extent is larger than the scaled render target.");
+
+		_upscaleExtent = renderExtent;
+		_upscaleGraph.setImportedImage(_upscaleSource, _frames[frameIndex].colorImage, _frames[frameIndex].colorView);
+		_upscaleGraph.setImportedImage(_upscaleDestination, swapchainImage, swapchainImageView);
+		_upscaleGraph.execute(commandBuffer);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_render_graph.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+	// Picks the render scale from measured GPU frame times. Samples are smoothed with an
+	// exponential moving average, and the scale only drops above the budget and only rises once
+	// the average is a headroom below it, so times near the budget do not make it oscillate.
+	// Frame time is taken as proportional to the pixel count, the square of the scale.
+	class LveResolutionController {
+	public:
+		struct Settings {
+			float minScale = 0.5f;
+			// above 1 renders more pixels than the swap chain has while there is time left
+			float maxScale = 1.0f;
+			float budgetMilliseconds = 14.0f;
+			// weight of the newest sample in the average
+			float smoothing = 0.1f;
+			// fraction of the budget the average must stay under before the scale rises
+			float headroom = 0.15f;
+			// frames a new scale is held before the next change, the average catches up meanwhile
+			uint32_t holdFrames = 30;
+			// largest change of one decision
+			float maxStep = 0.1f;
+		};
+
+		struct Decision {
+			uint64_t frame;
+			float averageMilliseconds;
+			float previousScale;
+			float scale;
+		};
+
+		explicit LveResolutionController(const Settings& settings);
+
+		// Feeds the GPU time of one frame, returns true when the scale changed.
+		bool update(float gpuMilliseconds);
+
+		float getScale() const { return _scale; }
+		float getAverageMilliseconds() const { return _averageMilliseconds; }
+		uint64_t getSampleCount() const { return _samples; }
+		const Settings& getSettings() const { return _settings; }
+
+		// Scale changes since the last call, oldest first. Only the latest MAX_PENDING_DECISIONS are kept.
+		std::vector<Decision> takeDecisions();
+
+		static constexpr size_t MAX_PENDING_DECISIONS = 64;
+
+	private:
+		Settings _settings;
+		float _scale;
+		float _averageMilliseconds = 0.0f;
+		uint64_t _samples = 0;
+		uint32_t _framesSinceChange = 0;
+		std::vector<Decision> _pendingDecisions;
+	};
+
+	// Color and depth images the scene renders into at a scale of the swap chain extent, one pair
+	// per frame in flight, and the blit that stretches the rendered region over the swap chain
+	// image. The images are sized for the largest scale, smaller ones render into their top left
+	// corner, so the scale can change every frame without recreating anything. The formats are
+	// the swap chain's, pipelines created for the swap chain render into them unchanged.
+	class LveScaledRenderTarget {
+	public:
+		// presentLayout is what the swap chain image is left in after the upscale
+		LveScaledRenderTarget(LveDevice& device, VkExtent2D swapchainExtent, float maxScale,
+			VkFormat colorFormat, VkFormat depthFormat, VkImageLayout presentLayout);
+		~LveScaledRenderTarget();
+
+		LveScaledRenderTarget(const LveScaledRenderTarget&) = delete;
+		LveScaledRenderTarget& operator=(const LveScaledRenderTarget&) = delete;
+
+		// True when the device can blit colorFormat with linear filtering, which upscale needs.
+		static bool isSupported(LveDevice& device, VkFormat colorFormat);
+
+		// The render extent for scale, clamped to the images.
+		VkExtent2D scaledExtent(float scale) const;
+		VkExtent2D getImageExtent() const { return _imageExtent; }
+
+		VkImage getColorImage(int frameIndex) const { return _frames[frameIndex].colorImage; }
+		VkImageView getColorImageView(int frameIndex) const { return _frames[frameIndex].colorView; }
+		VkImage getDepthImage(int frameIndex) const { return _frames[frameIndex].depthImage; }
+		VkImageView getDepthImageView(int frameIndex) const { return _frames[frameIndex].depthView; }
+
+		// Blits renderExtent of the frame's color image, left in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		// by the scene, over the whole swap chain image and leaves that in the present layout. The swap
+		// chain image needs VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+		void upscale(VkCommandBuffer commandBuffer, int frameIndex, VkExtent2D renderExtent,
+			VkImage swapchainImage, VkImageView swapchainImageView);
+
+	private:
+		struct FrameImages {
+			VkImage colorImage = VK_NULL_HANDLE;
+			VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+			VkImageView colorView = VK_NULL_HANDLE;
+			VkImage depthImage = VK_NULL_HANDLE;
+			VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+			VkImageView depthView = VK_NULL_HANDLE;
+		};
+
+		void createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+			VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+		void createUpscaleGraph(VkImageLayout presentLayout);
+
+		LveDevice& _lveDevice;
+		VkExtent2D _swapchainExtent;
+		VkExtent2D _imageExtent;
+		VkFormat _colorFormat;
+		VkFormat _depthFormat;
+		std::vector<FrameImages> _frames;
+
+		// declared once, the imports are rebound to the frame's images before every execution
+		LveRenderGraph _upscaleGraph;
+		LveGraphResource _upscaleSource;
+		LveGraphResource _upscaleDestination;
+		VkExtent2D _upscaleExtent{};
+	};
+}
@@ -5,12 +5,16 @@
 #include <vulkan/vulkan.h>
 #include "lve_game_object.h"
 
+#include <vector>
+
 namespace lve {
 
-#define MAX_LIGHTS 10
+class LveGpuProfiler;
+class LveLightBvh;
 
+// element of the light storage buffer, see LveLightClusters
 struct PointLight {
-	glm::vec4 position{}; // ignore w
+	glm::vec4 position{}; // w is range
 	glm::vec4 color{};	// w is intensity
 };
 
@@ -18,8 +22,8 @@ struct GlobalUbo {
 	glm::mat4 projectionMatrix{ 1.f };
 	glm::mat4 viewMatrix{ 1.f };
 	glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f, .02f };	// w is intensity
-	PointLight pointLights[MAX_LIGHTS];
-	int numLights;
+	glm::uvec4 clusterCounts{ 1, 1, 1, 0 };	// light cluster grid, w is the light count
+	glm::vec4 clusterParams{ 1.f, 1.f, 0.f, 0.f };	// cluster tile size in pixels, depth slice scale and bias
 };
 
 struct FrameInfo {
@@ -29,5 +33,11 @@ struct FrameInfo {
 	LveCamera& camera;
 	VkDescriptorSet& globalDescriptorSet;
 	LveGameObject::Map& gameObjects;
+	// frustum culled subset of gameObjects with a model, null when culling is off
+	const std::vector<LveGameObject*>* visibleObjects = nullptr;
+	// lights for per-object selection, null unless PointLightSystem builds them
+	LveLightBvh* lightBvh = nullptr;
+	// times LveGpuScopes recorded into commandBuffer, null when profiling is off
+	LveGpuProfiler* gpuProfiler = nullptr;
 };
 }
\ No newline at end of file
@@ -61,6 +61,16 @@ namespace lve {
 			}};
 	}
 
+	PackedTransform TransformComponent::packed() {
+		glm::mat4 model = mat4();
+		PackedTransform result;
+		for (int row = 0; row < 3; ++row) {
+			result.modelRows[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+		}
+		result.inverseScaleSquared = glm::vec4(1.0f / (scale * scale), 0.0f);
+		return result;
+	}
+
 
 	LveGameObject LveGameObject::makePointLight(
 		float lightintensity,
@@ -9,6 +9,15 @@
 
 namespace lve {
 
+	// Transform as stored in per-object storage buffers, 64 bytes instead of two mat4s.
+	// Shaders rebuild the model matrix from the rows of its upper 3x4 and the normal matrix
+	// R * S^-1 as mat3(model) * diag(inverseScaleSquared), which holds for the rotate-scale
+	// transforms TransformComponent produces.
+	struct PackedTransform {
+		glm::vec4 modelRows[3];
+		glm::vec4 inverseScaleSquared;	// w unused
+	};
+
 	struct TransformComponent {
 		glm::vec3 translation{};
 		glm::vec3 scale{ 1.f, 1.f , 1.f };
@@ -16,10 +25,31 @@ namespace lve {
 		
 		glm::mat4 mat4();
 		glm::mat3 normalMatrix();
+		PackedTransform packed();
+	};
+
+	// Fixed-function state an object wants, defaults match LvePipeline::defaultPipelineConfigInfo
+	struct RenderStateComponent {
+		VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+		VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkBool32 depthTestEnable = VK_TRUE;
+		VkBool32 depthWriteEnable = VK_TRUE;
+		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+		VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+
+		bool operator==(const RenderStateComponent& other) const {
+			return cullMode == other.cullMode && frontFace == other.frontFace && topology == other.topology
+				&& depthTestEnable == other.depthTestEnable && depthWriteEnable == other.depthWriteEnable
+				&& depthCompareOp == other.depthCompareOp && polygonMode == other.polygonMode;
+		}
+		bool operator!=(const RenderStateComponent& other) const { return !(*this == other); }
 	};
 
 	struct PointLightComponent {
 		float lightIntensity = 1.0f;
+		// distance at which the light fades out, lights are clustered by it
+		float range = 4.0f;
 	};
 
 	class LveGameObject {
@@ -48,6 +78,7 @@ namespace lve {
 
 		glm::vec3 color;
 		TransformComponent transform{};
+		RenderStateComponent renderState{};
 
 		std::shared_ptr<LveModel> model{};
 		std::unique_ptr<PointLightComponent> pointLight = nullptr;
@@ -0,0 +1,254 @@
+#include "lve_gpu_profiler.h"
+#include "lve_swap_chain.h"
+
+#include <cassert>
+#include <iomanip>
+#include <stdexcept>
+
+namespace lve {
+
+	namespace {
+		// results come back in bit order, the same order as PipelineStatistics
+		constexpr VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+			| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	}
+
+	LveGpuProfiler::LveGpuProfiler(LveDevice& device, bool pipelineStatistics)
+		: _lveDevice{ device }, _pipelineStatistics{ pipelineStatistics && device.features().pipelineStatisticsQuery }
+	{
+		assert(isSupported(device) && "The graphics queue cannot write timestamps.");
+
+		_frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : _frames) {
+			VkQueryPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			poolInfo.queryCount = 2 * MAX_SCOPES;
+			if (vkCreateQueryPool(_lveDevice.device(), &poolInfo, nullptr, &frame.timestampPool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create GPU profiler timestamp query pool.");
+			}
+
+			if (_pipelineStatistics) {
+				poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				poolInfo.queryCount = MAX_SCOPES;
+				poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+				if (vkCreateQueryPool(_lveDevice.device(), &poolInfo, nullptr, &frame.statisticsPool) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create GPU profiler pipeline statistics query pool.");
+				}
+			}
+			frame.scopes.reserve(MAX_SCOPES);
+		}
+	}
+
+	LveGpuProfiler::~LveGpuProfiler()
+	{
+		for (auto& frame : _frames) {
+			vkDestroyQueryPool(_lveDevice.device(), frame.timestampPool, nullptr);
+			vkDestroyQueryPool(_lveDevice.device(), frame.statisticsPool, nullptr);
+		}
+	}
+
+	bool LveGpuProfiler::isSupported(LveDevice& device)
+	{
+		return device.properties.limits.timestampComputeAndGraphics == VK_TRUE;
+	}
+
+	void LveGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+	{
+		assert(_openScopes == 0 && "A GPU profiler scope was left open in the last frame.");
+
+		_currentFrame = &_frames[frameIndex];
+		readResults(*_currentFrame);
+		_currentFrame->scopes.clear();
+		_currentFrame->statisticsQueryCount = 0;
+
+		vkCmdResetQueryPool(commandBuffer, _currentFrame->timestampPool, 0, 2 * MAX_SCOPES);
+		if (_pipelineStatistics) {
+			vkCmdResetQueryPool(commandBuffer, _currentFrame->statisticsPool, 0, MAX_SCOPES);
+		}
+	}
+
+	uint32_t LveGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+	{
+		assert(_currentFrame != nullptr && "Call beginFrame before recording GPU profiler scopes.");
+
+		auto& scopes = _currentFrame->scopes;
+		if (scopes.size() == MAX_SCOPES) {
+			_overflows++;
+			return INVALID_SCOPE;
+		}
+
+		FrameScope scope{ findResult(name), _openScopes, INVALID_SCOPE, false };
+		if (_pipelineStatistics && _openScopes == 0) {
+			scope.statisticsQuery = _currentFrame->statisticsQueryCount++;
+			vkCmdBeginQuery(commandBuffer, _currentFrame->statisticsPool, scope.statisticsQuery, 0);
+		}
+		uint32_t index = static_cast<uint32_t>(scopes.size());
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _currentFrame->timestampPool, 2 * index);
+		scopes.push_back(scope);
+		_openScopes++;
+		return index;
+	}
+
+	void LveGpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+	{
+		if (scope == INVALID_SCOPE) {
+			return;
+		}
+
+		auto& frameScope = _currentFrame->scopes[scope];
+		assert(!frameScope.ended && frameScope.depth + 1 == _openScopes
+			&& "GPU profiler scopes must end in reverse order of beginning.");
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _currentFrame->timestampPool,
+			2 * scope + 1);
+		if (frameScope.statisticsQuery != INVALID_SCOPE) {
+			vkCmdEndQuery(commandBuffer, _currentFrame->statisticsPool, frameScope.statisticsQuery);
+		}
+		frameScope.ended = true;
+		_openScopes--;
+	}
+
+	void LveGpuProfiler::readResults(Frame& frame)
+	{
+		if (frame.scopes.empty()) {
+			return;
+		}
+
+		// the frame's fence has signalled, so the results are normally available; a frame that is
+		// not ready is dropped rather than stalling the next one
+		uint32_t scopeCount = static_cast<uint32_t>(frame.scopes.size());
+		std::vector<uint64_t> timestamps(2 * scopeCount);
+		VkResult result = vkGetQueryPoolResults(_lveDevice.device(), frame.timestampPool, 0, 2 * scopeCount,
+			timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result != VK_SUCCESS) {
+			_droppedFrames++;
+			return;
+		}
+
+		std::vector<uint64_t> statistics(STATISTIC_COUNT * frame.statisticsQueryCount);
+		if (frame.statisticsQueryCount > 0) {
+			result = vkGetQueryPoolResults(_lveDevice.device(), frame.statisticsPool, 0, frame.statisticsQueryCount,
+				statistics.size() * sizeof(uint64_t), statistics.data(), STATISTIC_COUNT * sizeof(uint64_t),
+				VK_QUERY_RESULT_64_BIT);
+			if (result != VK_SUCCESS) {
+				_droppedFrames++;
+				return;
+			}
+		}
+
+		double period = static_cast<double>(_lveDevice.properties.limits.timestampPeriod);
+		for (uint32_t i = 0; i < scopeCount; ++i) {
+			const FrameScope& scope = frame.scopes[i];
+			uint64_t begin = timestamps[2 * i];
+			uint64_t end = timestamps[2 * i + 1];
+			if (!scope.ended || end < begin) {
+				continue;
+			}
+
+			Sample sample{};
+			sample.milliseconds = static_cast<float>(static_cast<double>(end - begin) * period / 1000000.0);
+			sample.hasStatistics = scope.statisticsQuery != INVALID_SCOPE;
+			if (sample.hasStatistics) {
+				for (uint32_t statistic = 0; statistic < STATISTIC_COUNT; ++statistic) {
+					sample.statistics[statistic] = statistics[STATISTIC_COUNT * scope.statisticsQuery + statistic];
+				}
+			}
+
+			Result& target = _results[scope.result];
+			target.depth = scope.depth;
+			target.lastMilliseconds = sample.milliseconds;
+			if (target.samples.size() < AVERAGE_FRAMES) {
+				target.samples.push_back(sample);
+			}
+			else {
+				target.samples[target.next] = sample;
+				target.next = (target.next + 1) % AVERAGE_FRAMES;
+			}
+		}
+	}
+
+	uint32_t LveGpuProfiler::findResult(const char* name)
+	{
+		// a frame has a few dozen scopes at most, a linear scan is cheaper than hashing
+		for (size_t i = 0; i < _results.size(); ++i) {
+			if (_results[i].name == name) return static_cast<uint32_t>(i);
+		}
+		_results.push_back({});
+		_results.back().name = name;
+		_results.back().samples.reserve(AVERAGE_FRAMES);
+		return static_cast<uint32_t>(_results.size() - 1);
+	}
+
+	std::vector<LveGpuProfiler::ScopeResult> LveGpuProfiler::getResults() const
+	{
+		std::vector<ScopeResult> results;
+		results.reserve(_results.size());
+		for (const auto& source : _results) {
+			ScopeResult result{};
+			result.name = source.name;
+			result.depth = source.depth;
+			result.lastMilliseconds = source.lastMilliseconds;
+			result.samples = static_cast<uint32_t>(source.samples.size());
+
+			double milliseconds = 0.0;
+			std::array<double, STATISTIC_COUNT> statistics{};
+			uint32_t statisticsSamples = 0;
+			for (const auto& sample : source.samples) {
+				milliseconds += sample.milliseconds;
+				if (sample.hasStatistics) {
+					for (uint32_t statistic = 0; statistic < STATISTIC_COUNT; ++statistic) {
+						statistics[statistic] += static_cast<double>(sample.statistics[statistic]);
+					}
+					statisticsSamples++;
+				}
+			}
+			if (result.samples > 0) {
+				result.averageMilliseconds = static_cast<float>(milliseconds / result.samples);
+			}
+			result.hasPipelineStatistics = statisticsSamples > 0;
+			if (result.hasPipelineStatistics) {
+				result.averageStatistics.inputAssemblyPrimitives = statistics[0] / statisticsSamples;
+				result.averageStatistics.vertexShaderInvocations = statistics[1] / statisticsSamples;
+				result.averageStatistics.clippingPrimitives = statistics[2] / statisticsSamples;
+				result.averageStatistics.fragmentShaderInvocations = statistics[3] / statisticsSamples;
+				result.averageStatistics.computeShaderInvocations = statistics[4] / statisticsSamples;
+			}
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	void LveGpuProfiler::writeReport(std::ostream& out) const
+	{
+		auto flags = out.flags();
+		auto precision = out.precision();
+		out << std::fixed << std::setprecision(3);
+
+		out << "GPU profile, average of the last " << AVERAGE_FRAMES << " frames:\n";
+		for (const auto& result : getResults()) {
+			out << std::string(2 + 2 * result.depth, ' ') << result.name << ": "
+				<< result.averageMilliseconds << " ms (last " << result.lastMilliseconds << " ms)";
+			if (result.hasPipelineStatistics) {
+				const auto& statistics = result.averageStatistics;
+				out << std::setprecision(0) << ", " << statistics.inputAssemblyPrimitives << " primitives, "
+					<< statistics.clippingPrimitives << " after clipping, "
+					<< statistics.vertexShaderInvocations << " vertex, "
+					<< statistics.fragmentShaderInvocations << " fragment, "
+					<< statistics.computeShaderInvocations << " compute invocations" << std::setprecision(3);
+			}
+			out << "\n";
+		}
+		if (_droppedFrames > 0 || _overflows > 0) {
+			out << "  " << _droppedFrames << " frames not ready in time, "
+				<< _overflows << " scopes over the limit of " << MAX_SCOPES << "\n";
+		}
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "lve_device.h"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+	// Times named scopes of the frame's command buffer with timestamp queries and, optionally,
+	// counts what the pipeline did in them with pipeline statistics queries. Every frame in flight
+	// has its own query pools, read back without waiting once the frame's fence has signalled, so
+	// results trail the recording by the frames in flight. Scopes are matched by name across
+	// frames and averaged over the last AVERAGE_FRAMES samples.
+	//
+	// Scopes nest. Queries of one type cannot be active together, so pipeline statistics are only
+	// collected for outermost scopes. Those must not execute secondary command buffers, which would
+	// need the inheritedQueries feature. Record scopes from one thread, into the primary command buffer.
+	class LveGpuProfiler {
+	public:
+		static constexpr uint32_t MAX_SCOPES = 64;
+		static constexpr uint32_t AVERAGE_FRAMES = 64;
+		static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+		struct PipelineStatistics {
+			double inputAssemblyPrimitives = 0.0;
+			double vertexShaderInvocations = 0.0;
+			double clippingPrimitives = 0.0;
+			double fragmentShaderInvocations = 0.0;
+			double computeShaderInvocations = 0.0;
+		};
+
+		struct ScopeResult {
+			std::string name;
+			// nesting depth of the scope the last time it was recorded, 0 is outermost
+			uint32_t depth;
+			float lastMilliseconds;
+			float averageMilliseconds;
+			// samples the averages are over, at most AVERAGE_FRAMES
+			uint32_t samples;
+			bool hasPipelineStatistics;
+			PipelineStatistics averageStatistics;
+		};
+
+		// Needs timestamps on the graphics queue, see isSupported. pipelineStatistics is ignored
+		// without the pipelineStatisticsQuery feature.
+		LveGpuProfiler(LveDevice& device, bool pipelineStatistics);
+		~LveGpuProfiler();
+
+		LveGpuProfiler(const LveGpuProfiler&) = delete;
+		LveGpuProfiler& operator=(const LveGpuProfiler&) = delete;
+
+		static bool isSupported(LveDevice& device);
+		bool collectsPipelineStatistics() const { return _pipelineStatistics; }
+
+		// Reads back the results last recorded for frameIndex and resets its queries. Call at the
+		// start of the frame's command buffer, after its fence was waited on, outside any render pass.
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+		// Scopes with the same name are averaged together. Returns INVALID_SCOPE once the frame
+		// has MAX_SCOPES scopes, endScope ignores it.
+		uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name);
+		void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+		// in the order the scopes were first recorded
+		std::vector<ScopeResult> getResults() const;
+		// frames whose results were not available yet when their slot came around again
+		uint64_t getDroppedFrameCount() const { return _droppedFrames; }
+		uint64_t getOverflowCount() const { return _overflows; }
+
+		void writeReport(std::ostream& out) const;
+
+	private:
+		static constexpr uint32_t STATISTIC_COUNT = 5;
+
+		// scope i writes timestamps 2 * i and 2 * i + 1
+		struct FrameScope {
+			uint32_t result;
+			uint32_t depth;
+			// INVALID_SCOPE for nested scopes and without pipeline statistics
+			uint32_t statisticsQuery;
+			bool ended;
+		};
+
+		struct Frame {
+			VkQueryPool timestampPool = VK_NULL_HANDLE;
+			VkQueryPool statisticsPool = VK_NULL_HANDLE;
+			std::vector<FrameScope> scopes;
+			uint32_t statisticsQueryCount = 0;
+		};
+
+		struct Sample {
+			float milliseconds;
+			bool hasStatistics;
+			std::array<uint64_t, STATISTIC_COUNT> statistics;
+		};
+
+		struct Result {
+			std::string name;
+			uint32_t depth = 0;
+			std::vector<Sample> samples;
+			// next slot of samples to overwrite once it holds AVERAGE_FRAMES
+			uint32_t next = 0;
+			float lastMilliseconds = 0.0f;
+		};
+
+		void readResults(Frame& frame);
+		uint32_t findResult(const char* name);
+
+		LveDevice& _lveDevice;
+		bool _pipelineStatistics;
+		std::vector<Frame> _frames;
+		Frame* _currentFrame = nullptr;
+		uint32_t _openScopes = 0;
+		std::vector<Result> _results;
+		uint64_t _droppedFrames = 0;
+		uint64_t _overflows = 0;
+	};
+
+	// Times the commands recorded during its lifetime, does nothing without a profiler.
+	class LveGpuScope {
+	public:
+		LveGpuScope(LveGpuProfiler* profiler, VkCommandBuffer commandBuffer, const char* name)
+			: _profiler{ profiler }, _commandBuffer{ commandBuffer }
+		{
+			if (_profiler) {
+				_scope = _profiler->beginScope(commandBuffer, name);
+			}
+		}
+
+		~LveGpuScope() {
+			if (_profiler) {
+				_profiler->endScope(_commandBuffer, _scope);
+			}
+		}
+
+		LveGpuScope(const LveGpuScope&) = delete;
+		LveGpuScope& operator=(const LveGpuScope&) = delete;
+
+	private:
+		LveGpuProfiler* _profiler;
+		VkCommandBuffer _commandBuffer;
+		uint32_t _scope = LveGpuProfiler::INVALID_SCOPE;
+	};
+}
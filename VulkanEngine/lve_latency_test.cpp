@@ -0,0 +1,89 @@
+#include "lve_latency_test.h"
+#include "lve_benchmark.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace lve {
+
+	LveLatencyTest::LveLatencyTest(const LveLatencyTestSettings& settings,
+		const std::vector<VkPresentModeKHR>& supportedPresentModes) : _settings{ settings }
+	{
+		const VkPresentModeKHR presentModes[] = {
+			VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+		for (int framesInFlight = 1; framesInFlight <= LveSwapChain::MAX_FRAMES_IN_FLIGHT; ++framesInFlight) {
+			for (VkPresentModeKHR presentMode : presentModes) {
+				// FIFO is always there, even when the list says otherwise
+				bool supported = presentMode == VK_PRESENT_MODE_FIFO_KHR || std::find(
+					supportedPresentModes.begin(), supportedPresentModes.end(), presentMode) != supportedPresentModes.end();
+				if (!supported) {
+					continue;
+				}
+				for (bool lowLatency : { false, true }) {
+					Run run{};
+					run.pacing.framesInFlight = framesInFlight;
+					run.pacing.presentMode = presentMode;
+					run.pacing.lowLatency = lowLatency;
+					run.latencyMilliseconds.reserve(settings.frames);
+					run.frameMilliseconds.reserve(settings.frames);
+					_runs.push_back(std::move(run));
+				}
+			}
+		}
+	}
+
+	bool LveLatencyTest::addFrame(double inputToPresentMilliseconds, double frameMilliseconds)
+	{
+		Run& run = _runs[_current];
+		if (run.warmupFramesSeen < _settings.warmupFrames) {
+			run.warmupFramesSeen++;
+			return false;
+		}
+
+		run.latencyMilliseconds.push_back(inputToPresentMilliseconds);
+		run.frameMilliseconds.push_back(frameMilliseconds);
+		if (run.frameMilliseconds.size() < _settings.frames) {
+			return false;
+		}
+		_current++;
+		return true;
+	}
+
+	void LveLatencyTest::writeReport(std::ostream& out) const
+	{
+		auto flags = out.flags();
+		auto precision = out.precision();
+		out << std::fixed << std::setprecision(2);
+
+		out << "Frame pacing, " << _settings.frames << " frames each, latency from input sample to present:\n";
+		out << "  in flight  present       low latency       fps  frame p50  frame p99"
+			<< "  latency mean  latency p50  latency p95  latency p99\n";
+		for (const auto& run : _runs) {
+			if (run.frameMilliseconds.empty()) {
+				continue;
+			}
+
+			auto frames = summarizeFrameTimes(run.frameMilliseconds);
+			auto latency = summarizeFrameTimes(run.latencyMilliseconds);
+			double totalMilliseconds = frames.mean * static_cast<double>(frames.count);
+			double framesPerSecond = totalMilliseconds > 0.0 ? 1000.0 * frames.count / totalMilliseconds : 0.0;
+			out << "  " << std::setw(9) << run.pacing.framesInFlight
+				<< "  " << std::left << std::setw(12) << LveSwapChain::presentModeName(run.pacing.presentMode)
+				<< "  " << std::setw(11) << (run.pacing.lowLatency ? "on" : "off") << std::right
+				<< "  " << std::setw(8) << framesPerSecond
+				<< "  " << std::setw(9) << frames.p50
+				<< "  " << std::setw(9) << frames.p99
+				<< "  " << std::setw(12) << latency.mean
+				<< "  " << std::setw(11) << latency.p50
+				<< "  " << std::setw(11) << latency.p95
+				<< "  " << std::setw(11) << latency.p99;
+			if (run.frameMilliseconds.size() < _settings.frames) {
+				out << "  (stopped after " << run.frameMilliseconds.size() << " frames)";
+			}
+			out << "\n";
+		}
+
+		out.flags(flags);
+		out.precision(precision);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "lve_renderer.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace lve {
+
+	struct LveLatencyTestSettings {
+		// rendered after every pacing change before measuring, the new swap chain settles meanwhile
+		uint32_t warmupFrames = 60;
+		uint32_t frames = 300;
+	};
+
+	// Steps through the frame pacing configurations, 1 to MAX_FRAMES_IN_FLIGHT frames in flight
+	// times each of FIFO, mailbox and immediate the surface supports times low latency off and on,
+	// and measures input to present latency and throughput of each.
+	class LveLatencyTest {
+	public:
+		LveLatencyTest(const LveLatencyTestSettings& settings, const std::vector<VkPresentModeKHR>& supportedPresentModes);
+
+		bool isComplete() const { return _current >= _runs.size(); }
+		size_t getConfigurationCount() const { return _runs.size(); }
+		// what to render with now, valid until the test is complete
+		const LveFramePacing& getPacing() const { return _runs[_current].pacing; }
+
+		// Takes a frame rendered with getPacing. Returns true when that configuration is done, the
+		// renderer must switch to the next getPacing then unless the test is complete.
+		bool addFrame(double inputToPresentMilliseconds, double frameMilliseconds);
+
+		// one line per configuration, the ones not reached are left out
+		void writeReport(std::ostream& out) const;
+
+	private:
+		struct Run {
+			LveFramePacing pacing;
+			uint32_t warmupFramesSeen = 0;
+			std::vector<double> latencyMilliseconds;
+			std::vector<double> frameMilliseconds;
+		};
+
+		LveLatencyTestSettings _settings;
+		std::vector<Run> _runs;
+		size_t _current = 0;
+	};
+}
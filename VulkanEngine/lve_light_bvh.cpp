@@ -0,0 +1,114 @@
+#include "lve_light_bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace lve {
+
+	void LveLightBvh::build(const std::vector<PointLight>& lights)
+	{
+		_lights = lights;
+		_lightOrder.resize(lights.size());
+		for (uint32_t i = 0; i < _lightOrder.size(); ++i) {
+			_lightOrder[i] = i;
+		}
+
+		_nodes.clear();
+		_nodes.reserve(2 * lights.size());
+		if (!lights.empty()) {
+			buildNode(0, static_cast<uint32_t>(lights.size()));
+		}
+
+		_stats = Stats{};
+		_stats.lights = static_cast<uint32_t>(lights.size());
+		_stats.nodes = static_cast<uint32_t>(_nodes.size());
+	}
+
+	uint32_t LveLightBvh::buildNode(uint32_t first, uint32_t count)
+	{
+		uint32_t nodeIndex = static_cast<uint32_t>(_nodes.size());
+		_nodes.emplace_back();
+
+		glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+		glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+		glm::vec3 centerMin = boundsMin;
+		glm::vec3 centerMax = boundsMax;
+		for (uint32_t i = first; i < first + count; ++i) {
+			const glm::vec4& position = _lights[_lightOrder[i]].position;
+			glm::vec3 center{ position };
+			boundsMin = glm::min(boundsMin, center - position.w);
+			boundsMax = glm::max(boundsMax, center + position.w);
+			centerMin = glm::min(centerMin, center);
+			centerMax = glm::max(centerMax, center);
+		}
+
+		if (count <= MAX_LEAF_LIGHTS) {
+			_nodes[nodeIndex] = { boundsMin, first, boundsMax, count };
+			return nodeIndex;
+		}
+
+		// median split on the axis the light centers spread along the most
+		glm::vec3 spread = centerMax - centerMin;
+		int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+		uint32_t half = count / 2;
+		std::nth_element(
+			_lightOrder.begin() + first, _lightOrder.begin() + first + half, _lightOrder.begin() + first + count,
+			[this, axis](uint32_t a, uint32_t b) { return _lights[a].position[axis] < _lights[b].position[axis]; });
+
+		buildNode(first, half);
+		uint32_t right = buildNode(first + half, count - half);
+		_nodes[nodeIndex] = { boundsMin, right, boundsMax, 0 };
+		return nodeIndex;
+	}
+
+	uint32_t LveLightBvh::selectLights(const glm::vec3& center, float radius, uint32_t maxLights, uint32_t* selected)
+	{
+		_stats.queries++;
+		if (_nodes.empty() || maxLights == 0) return 0;
+
+		_candidates.clear();
+		_stack.clear();
+		_stack.push_back(0);
+		while (!_stack.empty()) {
+			uint32_t nodeIndex = _stack.back();
+			_stack.pop_back();
+			const Node& node = _nodes[nodeIndex];
+
+			glm::vec3 offset = glm::max(glm::max(node.boundsMin - center, center - node.boundsMax), glm::vec3{ 0.f });
+			if (glm::dot(offset, offset) > radius * radius) continue;
+
+			if (node.count == 0) {
+				_stack.push_back(node.offset);
+				_stack.push_back(nodeIndex + 1);
+				continue;
+			}
+
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				uint32_t lightIndex = _lightOrder[i];
+				const PointLight& light = _lights[lightIndex];
+				float range = light.position.w;
+				_stats.lightsTested++;
+
+				// distance from the light to the nearest point of the sphere
+				float distance = std::max(glm::length(glm::vec3(light.position) - center) - radius, 0.f);
+				if (range <= 0.f || distance >= range) continue;
+
+				// matches simple_shader.frag, floored so lights inside the sphere rank by intensity
+				float distanceSquared = std::max(distance * distance, 1e-4f);
+				float rangeFraction = distanceSquared / (range * range);
+				float window = std::max(1.f - rangeFraction * rangeFraction, 0.f);
+				float brightness = light.color.w * std::max(light.color.r, std::max(light.color.g, light.color.b));
+				_candidates.push_back({ brightness * window * window / distanceSquared, lightIndex });
+			}
+		}
+
+		uint32_t count = std::min(maxLights, static_cast<uint32_t>(_candidates.size()));
+		std::partial_sort(_candidates.begin(), _candidates.begin() + count, _candidates.end(),
+			[](const Candidate& a, const Candidate& b) { return a.influence > b.influence; });
+		for (uint32_t i = 0; i < count; ++i) {
+			selected[i] = _candidates[i].light;
+		}
+		_stats.lightsSelected += count;
+		return count;
+	}
+}
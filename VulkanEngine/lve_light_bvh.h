@@ -0,0 +1,68 @@
+#pragma once
+
+#include "lve_frame_info.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+	// Bounding volume hierarchy over the range spheres of the point lights, rebuilt every frame.
+	// Nodes are boxes around their lights' spheres, split at the median of the longest axis, so
+	// a query only visits the lights whose range can reach the queried sphere.
+	class LveLightBvh {
+	public:
+		// leaves hold at most this many lights
+		static constexpr uint32_t MAX_LEAF_LIGHTS = 4;
+
+		struct Stats {
+			uint32_t lights = 0;
+			uint32_t nodes = 0;
+			// summed over every selectLights call since the last build
+			uint32_t queries = 0;
+			uint32_t lightsTested = 0;
+			uint32_t lightsSelected = 0;
+		};
+
+		LveLightBvh() = default;
+		LveLightBvh(const LveLightBvh&) = delete;
+		LveLightBvh& operator=(const LveLightBvh&) = delete;
+
+		// Light ranges are position.w, see PointLight. Indices returned by queries are into lights.
+		void build(const std::vector<PointLight>& lights);
+
+		// Writes the indices of at most maxLights lights reaching the world space sphere, most
+		// influential first, and returns how many were written. Influence is the light's intensity
+		// with the shader's windowed falloff at the sphere's nearest point.
+		uint32_t selectLights(const glm::vec3& center, float radius, uint32_t maxLights, uint32_t* selected);
+
+		const Stats& getStats() const { return _stats; }
+
+	private:
+		// an inner node's left child follows it, count is 0 and offset is its right child,
+		// a leaf's lights are _lightOrder[offset, offset + count)
+		struct Node {
+			glm::vec3 boundsMin;
+			uint32_t offset;
+			glm::vec3 boundsMax;
+			uint32_t count;
+		};
+
+		struct Candidate {
+			float influence;
+			uint32_t light;
+		};
+
+		uint32_t buildNode(uint32_t first, uint32_t count);
+
+		std::vector<PointLight> _lights;
+		std::vector<uint32_t> _lightOrder;
+		std::vector<Node> _nodes;
+
+		// query scratch, kept to reuse its capacity
+		std::vector<Candidate> _candidates;
+		std::vector<uint32_t> _stack;
+
+		Stats _stats;
+	};
+}
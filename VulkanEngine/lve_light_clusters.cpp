@@ -0,0 +1,206 @@
+#include "lve_light_clusters.h"
+
+#include "lve_swap_chain.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace lve {
+
+	namespace {
+		// Screen rectangle (min ndc, max ndc) of a view space sphere, see projectSphere in
+		// gpu_cull.comp. Fails for spheres crossing the near plane.
+		bool projectSphere(const glm::vec3& c, float r, float nearPlane, float P00, float P11, glm::vec4& rect) {
+			if (c.z < r + nearPlane) return false;
+
+			auto bounds = [r](float x, float z, float& minNdc, float& maxNdc) {
+				float lengthSquared = x * x + z * z;
+				float tangent = std::sqrt(lengthSquared - r * r);
+				// rotate the direction to the center by the angle of the tangent lines
+				float minX = (tangent * -x - r * -z);
+				float minZ = (r * -x + tangent * -z);
+				float maxX = (tangent * -x + r * -z);
+				float maxZ = (-r * -x + tangent * -z);
+				minNdc = minX / minZ;
+				maxNdc = maxX / maxZ;
+			};
+
+			bounds(c.x, c.z, rect.x, rect.z);
+			bounds(c.y, c.z, rect.y, rect.w);
+			rect *= glm::vec4(P00, P11, P00, P11);
+			return true;
+		}
+
+		uint32_t ndcToTile(float ndc, uint32_t tileCount) {
+			float tile = std::floor((ndc * .5f + .5f) * static_cast<float>(tileCount));
+			return static_cast<uint32_t>(std::clamp(tile, 0.f, static_cast<float>(tileCount - 1)));
+		}
+	}
+
+	LveLightClusters::LveLightClusters(LveDevice& device)
+		: _lveDevice{ device }, _frames(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+	{
+		for (auto& frame : _frames) {
+			ensureCapacity(frame.lightBuffer, sizeof(PointLight), 1);
+			ensureCapacity(frame.clusterBuffer, sizeof(ClusterRange), CLUSTER_COUNT);
+			ensureCapacity(frame.indexBuffer, sizeof(uint32_t), 1);
+		}
+	}
+
+	bool LveLightClusters::ensureCapacity(std::unique_ptr<LveBuffer>& buffer, VkDeviceSize elementSize, uint32_t count)
+	{
+		if (buffer != nullptr && buffer->getInstanceCount() >= count) {
+			return false;
+		}
+
+		uint32_t capacity = buffer == nullptr ? 1024 : buffer->getInstanceCount();
+		while (capacity < count) {
+			capacity *= 2;
+		}
+
+		buffer = std::make_unique<LveBuffer>(
+			_lveDevice, elementSize, capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer->map();
+		return true;
+	}
+
+	void LveLightClusters::binLight(uint32_t lightIndex, const PointLight& light, const glm::mat4& view,
+		const glm::mat4& projection, float nearPlane, float farPlane)
+	{
+		glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(light.position), 1.f));
+		float range = light.position.w;
+		if (range <= 0.f || center.z + range < nearPlane || center.z - range > farPlane) return;
+
+		auto depthSlice = [this](float depth) {
+			float slice = std::floor(std::log(depth) * _sliceScale + _sliceBias);
+			return static_cast<uint32_t>(std::clamp(slice, 0.f, static_cast<float>(GRID_Z - 1)));
+		};
+		auto sliceDepth = [this](uint32_t slice) {
+			return std::exp((static_cast<float>(slice) - _sliceBias) / _sliceScale);
+		};
+
+		uint32_t firstSlice = depthSlice(std::max(center.z - range, nearPlane));
+		uint32_t lastSlice = depthSlice(std::min(center.z + range, farPlane));
+
+		// a sphere crossing the near plane may cover any tile
+		float P00 = projection[0][0];
+		float P11 = projection[1][1];
+		uint32_t firstTile[2] = { 0, 0 };
+		uint32_t lastTile[2] = { GRID_X - 1, GRID_Y - 1 };
+		glm::vec4 rect;
+		if (projectSphere(center, range, nearPlane, P00, P11, rect)) {
+			if (rect.x > 1.f || rect.y > 1.f || rect.z < -1.f || rect.w < -1.f) return;
+			firstTile[0] = ndcToTile(rect.x, GRID_X);
+			firstTile[1] = ndcToTile(rect.y, GRID_Y);
+			lastTile[0] = ndcToTile(rect.z, GRID_X);
+			lastTile[1] = ndcToTile(rect.w, GRID_Y);
+		}
+
+		// the rectangle is the sphere's widest extent, test each froxel's view space box so
+		// the slices near the sphere's poles only get the tiles they touch
+		float rangeSquared = range * range;
+		for (uint32_t z = firstSlice; z <= lastSlice; ++z) {
+			float zNear = sliceDepth(z);
+			float zFar = sliceDepth(z + 1);
+			float dz = std::max({ zNear - center.z, 0.f, center.z - zFar });
+
+			for (uint32_t y = firstTile[1]; y <= lastTile[1]; ++y) {
+				float ndcY0 = -1.f + 2.f * static_cast<float>(y) / GRID_Y;
+				float ndcY1 = -1.f + 2.f * static_cast<float>(y + 1) / GRID_Y;
+				float minY = std::min(ndcY0 * zNear, ndcY0 * zFar) / P11;
+				float maxY = std::max(ndcY1 * zNear, ndcY1 * zFar) / P11;
+				float dy = std::max({ minY - center.y, 0.f, center.y - maxY });
+
+				for (uint32_t x = firstTile[0]; x <= lastTile[0]; ++x) {
+					float ndcX0 = -1.f + 2.f * static_cast<float>(x) / GRID_X;
+					float ndcX1 = -1.f + 2.f * static_cast<float>(x + 1) / GRID_X;
+					float minX = std::min(ndcX0 * zNear, ndcX0 * zFar) / P00;
+					float maxX = std::max(ndcX1 * zNear, ndcX1 * zFar) / P00;
+					float dx = std::max({ minX - center.x, 0.f, center.x - maxX });
+
+					if (dx * dx + dy * dy + dz * dz <= rangeSquared) {
+						_assignments.push_back({ (z * GRID_Y + y) * GRID_X + x, lightIndex });
+					}
+				}
+			}
+		}
+	}
+
+	bool LveLightClusters::build(int frameIndex, const LveCamera& camera, VkExtent2D extent,
+		const std::vector<PointLight>& lights, GlobalUbo& ubo)
+	{
+		const glm::mat4& projection = camera.getProjection();
+		const glm::mat4& view = camera.getView();
+		assert(projection[2][3] != 0.f && "Light clustering needs a perspective projection.");
+
+		// depth = P22 + P32 / z, solved for the planes at depth 0 and 1
+		float nearPlane = -projection[3][2] / projection[2][2];
+		float farPlane = projection[3][2] / (1.f - projection[2][2]);
+		float logDepthRange = std::log(farPlane / nearPlane);
+		_sliceScale = static_cast<float>(GRID_Z) / logDepthRange;
+		_sliceBias = -static_cast<float>(GRID_Z) * std::log(nearPlane) / logDepthRange;
+
+		_assignments.clear();
+		for (uint32_t i = 0; i < lights.size(); ++i) {
+			binLight(i, lights[i], view, projection, nearPlane, farPlane);
+		}
+
+		// counting sort of the assignments by cluster
+		_stats = Stats{};
+		_stats.lights = static_cast<uint32_t>(lights.size());
+		_clusters.assign(CLUSTER_COUNT, ClusterRange{ 0, 0 });
+		for (const auto& assignment : _assignments) {
+			_clusters[assignment.cluster].count++;
+		}
+
+		uint32_t indexCount = 0;
+		for (auto& cluster : _clusters) {
+			if (cluster.count > MAX_LIGHTS_PER_CLUSTER) {
+				_stats.droppedLightIndices += cluster.count - MAX_LIGHTS_PER_CLUSTER;
+				cluster.count = MAX_LIGHTS_PER_CLUSTER;
+			}
+			if (cluster.count > 0) {
+				_stats.occupiedClusters++;
+			}
+			_stats.maxClusterLights = std::max(_stats.maxClusterLights, cluster.count);
+			cluster.firstIndex = indexCount;
+			indexCount += cluster.count;
+		}
+		_stats.lightIndices = indexCount;
+
+		_lightIndices.resize(indexCount);
+		_clusterFill.assign(CLUSTER_COUNT, 0);
+		for (const auto& assignment : _assignments) {
+			const ClusterRange& cluster = _clusters[assignment.cluster];
+			uint32_t& clusterFilled = _clusterFill[assignment.cluster];
+			if (clusterFilled < cluster.count) {
+				_lightIndices[cluster.firstIndex + clusterFilled++] = assignment.light;
+			}
+		}
+
+		// the fence of this frame index was waited on, its buffers are free to replace
+		auto& frame = _frames[frameIndex];
+		bool reallocated = ensureCapacity(frame.lightBuffer, sizeof(PointLight), static_cast<uint32_t>(lights.size()));
+		reallocated = ensureCapacity(frame.indexBuffer, sizeof(uint32_t), indexCount) || reallocated;
+
+		if (!lights.empty()) {
+			std::memcpy(frame.lightBuffer->getMappedMemory(), lights.data(), sizeof(PointLight) * lights.size());
+		}
+		std::memcpy(frame.clusterBuffer->getMappedMemory(), _clusters.data(), sizeof(ClusterRange) * CLUSTER_COUNT);
+		if (indexCount > 0) {
+			std::memcpy(frame.indexBuffer->getMappedMemory(), _lightIndices.data(), sizeof(uint32_t) * indexCount);
+		}
+
+		ubo.clusterCounts = glm::uvec4(GRID_X, GRID_Y, GRID_Z, static_cast<uint32_t>(lights.size()));
+		ubo.clusterParams = glm::vec4(
+			static_cast<float>(extent.width) / GRID_X,
+			static_cast<float>(extent.height) / GRID_Y,
+			_sliceScale,
+			_sliceBias);
+		return reallocated;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_buffer.h"
+#include "lve_camera.h"
+#include "lve_frame_info.h"
+
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+	// Clustered light assignment. The view frustum is split into GRID_X * GRID_Y screen tiles and
+	// GRID_Z depth slices, spaced exponentially between the near and far plane, and every light
+	// is binned into the clusters its range sphere touches. Fragments look up their cluster and
+	// only loop over its lights, so shading cost follows the local light density.
+	//
+	// Binning runs on the CPU. Lights, per-cluster (first index, count) pairs and the index lists
+	// live in host visible storage buffers, bindings 1 to 3 of the global descriptor set.
+	class LveLightClusters {
+	public:
+		static constexpr uint32_t GRID_X = 16;
+		static constexpr uint32_t GRID_Y = 9;
+		static constexpr uint32_t GRID_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+		// lights past this in one cluster are dropped, also the shader's loop bound
+		static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+
+		struct Stats {
+			uint32_t lights = 0;
+			uint32_t lightIndices = 0;
+			uint32_t occupiedClusters = 0;
+			uint32_t maxClusterLights = 0;
+			uint32_t droppedLightIndices = 0;
+		};
+
+		explicit LveLightClusters(LveDevice& device);
+
+		LveLightClusters(const LveLightClusters&) = delete;
+		LveLightClusters& operator=(const LveLightClusters&) = delete;
+
+		// Bins the lights for the camera and uploads them into the buffers of frameIndex, whose
+		// fence must have signalled. Fills the cluster fields and light count of ubo. Returns true
+		// when the frame's buffers were reallocated and its descriptor set must be rewritten.
+		bool build(int frameIndex, const LveCamera& camera, VkExtent2D extent,
+			const std::vector<PointLight>& lights, GlobalUbo& ubo);
+
+		VkDescriptorBufferInfo lightBufferInfo(int frameIndex) { return _frames[frameIndex].lightBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo clusterBufferInfo(int frameIndex) { return _frames[frameIndex].clusterBuffer->descriptorInfo(); }
+		VkDescriptorBufferInfo indexBufferInfo(int frameIndex) { return _frames[frameIndex].indexBuffer->descriptorInfo(); }
+
+		// Counters of the last build
+		const Stats& getStats() const { return _stats; }
+
+	private:
+		struct ClusterRange {
+			uint32_t firstIndex;
+			uint32_t count;
+		};
+
+		struct LightCluster {
+			uint32_t cluster;
+			uint32_t light;
+		};
+
+		struct FrameBuffers {
+			std::unique_ptr<LveBuffer> lightBuffer;
+			std::unique_ptr<LveBuffer> clusterBuffer;
+			std::unique_ptr<LveBuffer> indexBuffer;
+		};
+
+		void binLight(uint32_t lightIndex, const PointLight& light, const glm::mat4& view,
+			const glm::mat4& projection, float nearPlane, float farPlane);
+		bool ensureCapacity(std::unique_ptr<LveBuffer>& buffer, VkDeviceSize elementSize, uint32_t count);
+
+		LveDevice& _lveDevice;
+		std::vector<FrameBuffers> _frames;
+
+		float _sliceScale = 0.f;
+		float _sliceBias = 0.f;
+
+		// scratch reused across frames
+		std::vector<LightCluster> _assignments;
+		std::vector<ClusterRange> _clusters;
+		std::vector<uint32_t> _clusterFill;
+		std::vector<uint32_t> _lightIndices;
+
+		Stats _stats;
+	};
+}
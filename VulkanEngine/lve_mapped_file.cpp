@@ -0,0 +1,94 @@
+#include "lve_mapped_file.h"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lve {
+
+	LveMappedFile::LveMappedFile(const std::string& filepath) {
+		if (!std::filesystem::exists(filepath)) {
+			std::cout << "Current Path : " << std::filesystem::current_path() << std::endl;
+			throw std::runtime_error("File not found: " + filepath);
+		}
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+		_fileHandle = file;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		_size = static_cast<size_t>(fileSize.QuadPart);
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			close();
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+		_mappingHandle = mapping;
+
+		_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (_data == nullptr) {
+			close();
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+#else
+		_fileDescriptor = open(filepath.c_str(), O_RDONLY);
+		if (_fileDescriptor < 0) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		struct stat fileStat {};
+		if (fstat(_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+			close();
+			throw std::runtime_error("failed to map empty file: " + filepath);
+		}
+		_size = static_cast<size_t>(fileStat.st_size);
+
+		void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fileDescriptor, 0);
+		if (mapped == MAP_FAILED) {
+			close();
+			throw std::runtime_error("failed to map file: " + filepath);
+		}
+		_data = mapped;
+#endif
+	}
+
+	LveMappedFile::~LveMappedFile() {
+		close();
+	}
+
+	void LveMappedFile::close() {
+#ifdef _WIN32
+		if (_data != nullptr) UnmapViewOfFile(_data);
+		if (_mappingHandle != nullptr) CloseHandle(_mappingHandle);
+		if (_fileHandle != nullptr) CloseHandle(_fileHandle);
+		_mappingHandle = nullptr;
+		_fileHandle = nullptr;
+#else
+		if (_data != nullptr) munmap(_data, _size);
+		if (_fileDescriptor >= 0) ::close(_fileDescriptor);
+		_fileDescriptor = -1;
+#endif
+		_data = nullptr;
+		_size = 0;
+	}
+}
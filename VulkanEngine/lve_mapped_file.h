@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace lve {
+
+	// Read-only memory mapping of a whole file. The view is page aligned, so SPIR-V
+	// can be handed to vkCreateShaderModule without copying it into a vector first.
+	class LveMappedFile {
+	public:
+		explicit LveMappedFile(const std::string& filepath);
+		~LveMappedFile();
+
+		LveMappedFile(const LveMappedFile&) = delete;
+		LveMappedFile& operator=(const LveMappedFile&) = delete;
+
+		const char* data() const { return static_cast<const char*>(_data); }
+		size_t size() const { return _size; }
+
+	private:
+		void close();
+
+#ifdef _WIN32
+		void* _fileHandle = nullptr;
+		void* _mappingHandle = nullptr;
+#else
+		int _fileDescriptor = -1;
+#endif
+		void* _data = nullptr;
+		size_t _size = 0;
+	};
+}
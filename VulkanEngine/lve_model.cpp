@@ -7,7 +7,10 @@
 #define GLM_ENABLE_EXPERINENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 
 namespace std {
@@ -25,8 +28,12 @@ namespace lve {
 	LveModel::LveModel(LveDevice& device, const Builder& builder) 
 		: _lveDevice{ device }
 	{
+		static id_t nextId = 0;
+		_id = nextId++;
+
 		createVertexBuffers(builder.vertices);
 		createIndexBuffers(builder.indices);
+		computeBounds(builder.vertices);
 	}
 
 	LveModel::~LveModel() { }
@@ -40,27 +47,45 @@ namespace lve {
 	}
 
 
-	void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-		_vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(_vertexCount >= 3 && "Veretx count must be at least 3");
-
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * _vertexCount;
-		uint32_t vertexSize = sizeof(vertices[0]);
-
+	std::unique_ptr<LveBuffer> LveModel::createDeviceLocalBuffer(
+		const void* data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage)
+	{
 		LveBuffer stagingBuffer{
-			_lveDevice, vertexSize, _vertexCount,
+			_lveDevice, elementSize, elementCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
 		};
 		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		stagingBuffer.writeToBuffer(const_cast<void*>(data));
 
-		vertexBuffer = std::make_unique<LveBuffer>(
-			_lveDevice, vertexSize, _vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		// transfer source so GPU-driven rendering can merge models into one buffer
+		auto buffer = std::make_unique<LveBuffer>(
+			_lveDevice, elementSize, elementCount,
+			usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-		_lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+		_lveDevice.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(),
+			static_cast<VkDeviceSize>(elementSize) * elementCount);
+		return buffer;
+	}
+
+	void LveModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
+		_vertexCount = static_cast<uint32_t>(vertices.size());
+		assert(_vertexCount >= 3 && "Veretx count must be at least 3");
+
+		std::vector<glm::vec3> positions;
+		std::vector<VertexAttributes> attributes;
+		positions.reserve(_vertexCount);
+		attributes.reserve(_vertexCount);
+		for (const auto& vertex : vertices) {
+			positions.push_back(vertex.position);
+			attributes.push_back({ vertex.color, vertex.normal, vertex.uv });
+		}
+
+		positionBuffer = createDeviceLocalBuffer(
+			positions.data(), sizeof(glm::vec3), _vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		attributeBuffer = createDeviceLocalBuffer(
+			attributes.data(), sizeof(VertexAttributes), _vertexCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 	}
 
 	void LveModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
@@ -70,60 +95,80 @@ namespace lve {
 			return;
 		}
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * _indexCount;
-		uint32_t indexSize = sizeof(indices[0]);
+		indexBuffer = createDeviceLocalBuffer(
+			indices.data(), sizeof(indices[0]), _indexCount, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	}
 
-		LveBuffer stagingBuffer{
-			_lveDevice, indexSize, _indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
 
-		indexBuffer = std::make_unique<LveBuffer>(
-			_lveDevice, indexSize, _indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	void LveModel::computeBounds(const std::vector<Vertex>& vertices) {
+		// sphere around the box center, looser than a minimal sphere but one pass and stable
+		glm::vec3 minPosition{ std::numeric_limits<float>::max() };
+		glm::vec3 maxPosition{ std::numeric_limits<float>::lowest() };
+		for (const auto& vertex : vertices) {
+			minPosition = glm::min(minPosition, vertex.position);
+			maxPosition = glm::max(maxPosition, vertex.position);
+		}
 
-		_lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		glm::vec3 center = (minPosition + maxPosition) * .5f;
+		float radiusSquared = 0.f;
+		for (const auto& vertex : vertices) {
+			glm::vec3 offset = vertex.position - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+		_boundingSphere = glm::vec4(center, std::sqrt(radiusSquared));
+		_boundsMin = minPosition;
+		_boundsMax = maxPosition;
 	}
 
-
 	void LveModel::bind(VkCommandBuffer commandBuffer) {
-		VkBuffer buffers[] = { vertexBuffer->getBuffer()};
-		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		VkBuffer buffers[] = { positionBuffer->getBuffer(), attributeBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers, offsets);
 		if (hasIndexBuffer) {
 			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 		}
 	}
 
-	void LveModel::draw(VkCommandBuffer commandBuffer) {
+	void LveModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
 		if (hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, _indexCount, 1, 0, 0, 0);
+			vkCmdDrawIndexed(commandBuffer, _indexCount, instanceCount, 0, 0, firstInstance);
 		}
 		else {
-			vkCmdDraw(commandBuffer, _vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, _vertexCount, instanceCount, 0, firstInstance);
 		}
 	}
 
 	std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getBindingDescriptions() {
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(2);
 		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].stride = sizeof(glm::vec3);
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		bindingDescriptions[1].binding = 1;
+		bindingDescriptions[1].stride = sizeof(VertexAttributes);
+		bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 		return bindingDescriptions;
 	}
 
 	std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDescriptions() {
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position) });
-		attributeDescriptions.push_back({ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) });
-		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) });
-		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, uv) });
+		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+		attributeDescriptions.push_back({ 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, color) });
+		attributeDescriptions.push_back({ 2, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttributes, normal) });
+		attributeDescriptions.push_back({ 3, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttributes, uv) });
+
+		return attributeDescriptions;
+	}
+
+	std::vector<VkVertexInputBindingDescription> LveModel::Vertex::getPositionBindingDescriptions() {
+		auto bindingDescriptions = getBindingDescriptions();
+		bindingDescriptions.resize(1);
+		return bindingDescriptions;
+	}
 
+	std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getPositionAttributeDescriptions() {
+		auto attributeDescriptions = getAttributeDescriptions();
+		attributeDescriptions.resize(1);
 		return attributeDescriptions;
 	}
 
@@ -12,7 +12,10 @@
 namespace lve {
 	class LveModel {
 	public:
+		using id_t = uint64_t;
 
+		// Loader-side vertex. On the GPU it is split into two streams, positions at binding 0 and
+		// VertexAttributes at binding 1, so depth-only passes fetch 12 bytes per vertex.
 		struct Vertex {
 			glm::vec3 position{};
 			glm::vec3 color{};
@@ -21,6 +24,9 @@ namespace lve {
 
 			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
 			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			// binding 0 only, for pipelines that read nothing but the position
+			static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
 
 			bool operator==(const Vertex& other) const {
 				return position == other.position && color == other.color
@@ -30,6 +36,12 @@ namespace lve {
 
 		};
 
+		struct VertexAttributes {
+			glm::vec3 color{};
+			glm::vec3 normal{};
+			glm::vec2 uv{};
+		};
+
 		struct Builder {
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
@@ -45,20 +57,44 @@ namespace lve {
 
 		static std::unique_ptr<LveModel> createModelFromFile(LveDevice& device, const std::string& filepath);
 
+		// Unique for the lifetime of the process, unlike the address a later model may reuse
+		id_t getId() const { return _id; }
+
+		VkBuffer getPositionBuffer() const { return positionBuffer->getBuffer(); }
+		VkBuffer getAttributeBuffer() const { return attributeBuffer->getBuffer(); }
+		uint32_t getVertexCount() const { return _vertexCount; }
+		bool hasIndices() const { return hasIndexBuffer; }
+		VkBuffer getIndexBuffer() const { return indexBuffer->getBuffer(); }
+		uint32_t getIndexCount() const { return _indexCount; }
+
+		// Model space bounds, xyz is the center and w the radius
+		const glm::vec4& getBoundingSphere() const { return _boundingSphere; }
+		const glm::vec3& getBoundsMin() const { return _boundsMin; }
+		const glm::vec3& getBoundsMax() const { return _boundsMax; }
+
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
 
 	private:
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
+		std::unique_ptr<LveBuffer> createDeviceLocalBuffer(
+			const void* data, uint32_t elementSize, uint32_t elementCount, VkBufferUsageFlags usage);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void computeBounds(const std::vector<Vertex>& vertices);
 
 		LveDevice& _lveDevice;
+		id_t _id;
 		
-		std::unique_ptr<LveBuffer> vertexBuffer;
+		std::unique_ptr<LveBuffer> positionBuffer;
+		std::unique_ptr<LveBuffer> attributeBuffer;
 		uint32_t _vertexCount;
 
 		bool hasIndexBuffer{ false };
 		std::unique_ptr<LveBuffer> indexBuffer;
 		uint32_t _indexCount;
+
+		glm::vec4 _boundingSphere{ 0.f };
+		glm::vec3 _boundsMin{ 0.f };
+		glm::vec3 _boundsMax{ 0.f };
 	};
 }
\ No newline at end of file
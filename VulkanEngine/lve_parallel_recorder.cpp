@@ -0,0 +1,150 @@
+#include "lve_parallel_recorder.h"
+
+#include "lve_cpu_profiler.h"
+#include "lve_swap_chain.h"
+
+#include <cassert>
+#include <future>
+#include <stdexcept>
+
+namespace lve {
+
+	LveParallelRecorder::LveParallelRecorder(LveDevice& device, uint32_t workerCount)
+		: _lveDevice{ device },
+		_threadPool{ std::make_unique<LveThreadPool>(workerCount) },
+		_frames(LveSwapChain::MAX_FRAMES_IN_FLIGHT) {}
+
+	LveParallelRecorder::~LveParallelRecorder() {
+		// destroying a pool frees its command buffers
+		for (auto& frame : _frames) {
+			for (auto& slot : frame.slots) {
+				vkDestroyCommandPool(_lveDevice.device(), slot.commandPool, nullptr);
+			}
+		}
+	}
+
+	void LveParallelRecorder::createSlot(Slot& slot) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = _lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+		// reset as a whole every frame, individual buffers are never reset
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		if (vkCreateCommandPool(_lveDevice.device(), &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create secondary command pool.");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandPool = slot.commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(_lveDevice.device(), &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate secondary command buffer.");
+		}
+	}
+
+	void LveParallelRecorder::begin(int frameIndex, const LvePipelineTarget& target, VkFramebuffer framebuffer, VkExtent2D extent) {
+		_frameIndex = frameIndex;
+		_target = target;
+		_framebuffer = framebuffer;
+		_extent = extent;
+
+		auto& frame = _frames[frameIndex];
+		for (uint32_t i = 0; i < frame.used; ++i) {
+			vkResetCommandPool(_lveDevice.device(), frame.slots[i].commandPool, 0);
+		}
+		frame.used = 0;
+	}
+
+	void LveParallelRecorder::recordSlot(Slot& slot, uint32_t slice, const RecordFn& recordSlice) {
+		LVE_PROFILE_ZONE("record slice");
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = _target.renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = _target.usesDynamicRendering() ? VK_NULL_HANDLE : _framebuffer;
+
+		// with dynamic rendering the secondaries only inherit the attachment formats
+		VkCommandBufferInheritanceRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachmentFormats = &_target.colorFormat;
+		renderingInfo.depthAttachmentFormat = _target.depthFormat;
+		renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		renderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		if (_target.usesDynamicRendering()) {
+			inheritanceInfo.pNext = &renderingInfo;
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording secondary command buffer!");
+		}
+
+		// dynamic state is not inherited from the primary
+		VkViewport viewport;
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(_extent.width);
+		viewport.height = static_cast<float>(_extent.height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{ {0, 0}, _extent };
+		vkCmdSetViewport(slot.commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(slot.commandBuffer, 0, 1, &scissor);
+
+		recordSlice(slice, slot.commandBuffer);
+
+		if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record secondary command buffer!");
+		}
+	}
+
+	void LveParallelRecorder::record(uint32_t sliceCount, const RecordFn& recordSlice) {
+		assert(_frameIndex >= 0 && "Cannot record before begin.");
+
+		// slots are created up front so the workers never touch the vector
+		auto& frame = _frames[_frameIndex];
+		uint32_t firstSlot = frame.used;
+		while (frame.slots.size() < firstSlot + sliceCount) {
+			frame.slots.emplace_back();
+			createSlot(frame.slots.back());
+		}
+		frame.used += sliceCount;
+
+		std::vector<std::future<void>> pending;
+		pending.reserve(sliceCount);
+		for (uint32_t slice = 0; slice < sliceCount; ++slice) {
+			Slot* slot = &frame.slots[firstSlot + slice];
+			pending.push_back(_threadPool->submit([this, slot, slice, &recordSlice]() {
+				recordSlot(*slot, slice, recordSlice);
+			}));
+		}
+
+		// wait for every slice before rethrowing, the others still reference recordSlice
+		for (auto& future : pending) {
+			future.wait();
+		}
+		for (auto& future : pending) {
+			future.get();
+		}
+	}
+
+	void LveParallelRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+		auto& frame = _frames[_frameIndex];
+		if (frame.used == 0) return;
+
+		std::vector<VkCommandBuffer> commandBuffers;
+		commandBuffers.reserve(frame.used);
+		for (uint32_t i = 0; i < frame.used; ++i) {
+			commandBuffers.push_back(frame.slots[i].commandBuffer);
+		}
+		vkCmdExecuteCommands(primaryCommandBuffer, frame.used, commandBuffers.data());
+	}
+}
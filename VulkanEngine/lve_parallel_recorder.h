@@ -0,0 +1,67 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_pipeline.h"
+#include "lve_thread_pool.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+	// Records the contents of a render pass into secondary command buffers on worker threads.
+	// Every frame in flight has its own set of command pools, one per slice, so a slice is only
+	// ever recorded by the task that owns its pool and pools are reset once the frame's fence has
+	// signalled. The secondaries are executed into the primary in the order they were recorded,
+	// which keeps the frame identical whatever order the workers finish in.
+	class LveParallelRecorder {
+	public:
+		using RecordFn = std::function<void(uint32_t slice, VkCommandBuffer commandBuffer)>;
+
+		// workerCount == 0 picks hardware_concurrency - 1, like LveThreadPool
+		LveParallelRecorder(LveDevice& device, uint32_t workerCount = 0);
+		~LveParallelRecorder();
+
+		LveParallelRecorder(const LveParallelRecorder&) = delete;
+		LveParallelRecorder& operator=(const LveParallelRecorder&) = delete;
+
+		uint32_t getWorkerCount() const { return _threadPool->workerCount(); }
+
+		// Call after the render pass was begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, or
+		// rendering with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT when the target uses dynamic
+		// rendering, the framebuffer is ignored then. Resets the pools of the frame index, whose fence
+		// was waited on in beginFrame.
+		void begin(int frameIndex, const LvePipelineTarget& target, VkFramebuffer framebuffer, VkExtent2D extent);
+
+		// Records sliceCount secondaries concurrently and blocks until all are done. Each one
+		// starts with the full viewport and scissor set and nothing else bound.
+		void record(uint32_t sliceCount, const RecordFn& recordSlice);
+
+		// Executes every secondary recorded since begin, in recording order.
+		void execute(VkCommandBuffer primaryCommandBuffer);
+
+	private:
+		struct Slot {
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		};
+
+		struct FrameSlots {
+			std::vector<Slot> slots;
+			uint32_t used = 0;
+		};
+
+		void createSlot(Slot& slot);
+		void recordSlot(Slot& slot, uint32_t slice, const RecordFn& recordSlice);
+
+		LveDevice& _lveDevice;
+		std::unique_ptr<LveThreadPool> _threadPool;
+		std::vector<FrameSlots> _frames;
+
+		int _frameIndex = -1;
+		LvePipelineTarget _target{};
+		VkFramebuffer _framebuffer = VK_NULL_HANDLE;
+		VkExtent2D _extent{};
+	};
+}
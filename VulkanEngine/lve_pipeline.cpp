@@ -1,29 +1,98 @@
 #include "lve_pipeline.h"
 
 #include "lve_model.h"
+#include "lve_utils.h"
 
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <cstring>
 #include <stdexcept>
-#include <iostream>
-
-#include <filesystem>
 
 namespace lve {
 
+	namespace {
+		// raw bytes of each value, only called with Vulkan enums, flags, handles, integers and floats
+		template <typename... T>
+		void appendKey(std::vector<uint8_t>& key, const T&... values) {
+			auto append = [&key](const void* value, size_t size) {
+				auto bytes = static_cast<const uint8_t*>(value);
+				key.insert(key.end(), bytes, bytes + size);
+			};
+			(append(&values, sizeof(T)), ...);
+		}
+	}
+
+	// *************** Specialization Constants *********************
+
+	void LveSpecializationConstants::setRaw(uint32_t constantId, const void* value, size_t size) {
+		for (auto& entry : _entries) {
+			if (entry.constantID == constantId) {
+				assert(entry.size == size && "Specialization constant redefined with a different type size.");
+				std::memcpy(_data.data() + entry.offset, value, size);
+				return;
+			}
+		}
+
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantId;
+		entry.offset = static_cast<uint32_t>(_data.size());
+		entry.size = size;
+		_data.resize(_data.size() + size);
+		std::memcpy(_data.data() + entry.offset, value, size);
+
+		// keep entries ordered by id so the permutation key does not depend on insertion order
+		auto it = _entries.begin();
+		while (it != _entries.end() && it->constantID < constantId) ++it;
+		_entries.insert(it, entry);
+	}
+
+	VkSpecializationInfo LveSpecializationConstants::getSpecializationInfo() const {
+		VkSpecializationInfo info{};
+		info.mapEntryCount = static_cast<uint32_t>(_entries.size());
+		info.pMapEntries = _entries.data();
+		info.dataSize = _data.size();
+		info.pData = _data.data();
+		return info;
+	}
+
+	LvePermutationKey LveSpecializationConstants::permutationKey() const {
+		size_t seed = 0;
+		for (const auto& entry : _entries) {
+			uint32_t value = 0;
+			std::memcpy(&value, _data.data() + entry.offset, entry.size);
+			hashCombine(seed, entry.constantID, value);
+		}
+		return static_cast<LvePermutationKey>(seed);
+	}
+
+	bool LveSpecializationConstants::operator==(const LveSpecializationConstants& other) const {
+		// entries are ordered by id, but offsets into _data follow set() order
+		if (_entries.size() != other._entries.size()) return false;
+		for (size_t i = 0; i < _entries.size(); ++i) {
+			const auto& entry = _entries[i];
+			const auto& otherEntry = other._entries[i];
+			if (entry.constantID != otherEntry.constantID || entry.size != otherEntry.size ||
+				std::memcmp(_data.data() + entry.offset, other._data.data() + otherEntry.offset, entry.size) != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// *************** Pipeline *********************
+
 	LvePipeline::LvePipeline(LveDevice& device,
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
-		const PipelineConfigInfo& config)
+		const PipelineConfigInfo& config,
+		VkPipelineCache pipelineCache)
 		: _device(device)
 	{
-		createGraphicsPipeline(vertFilepath, fragFilepath, config);
+		createGraphicsPipeline(vertFilepath, fragFilepath, config, pipelineCache);
 	}
 
 	LvePipeline::~LvePipeline() {
-		vkDestroyShaderModule(_device.device(), _vertShaderModule, nullptr);
-		vkDestroyShaderModule(_device.device(), _fragShaderModule, nullptr);
-
+		// shader modules are refcounted by the device cache and released with the shared_ptrs
 		vkDestroyPipeline(_device.device(), _graphicsPipeline, nullptr);
 	}
 
@@ -32,28 +101,6 @@ namespace lve {
 	}
 
 
-	std::vector<char> LvePipeline::readFile(const std::string& filepath) {
-		std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-
-		if (!std::filesystem::exists(filepath)) {
-			std::cout << "Current Path : " << std::filesystem::current_path() << std::endl;
-			throw std::runtime_error("File not found: " + filepath);
-		}
-
-		if (!file.is_open()) {
-			throw std::runtime_error("failed to open file: " + filepath);
-		}
-
-		size_t fileSize = static_cast<size_t>(file.tellg());
-		std::vector<char> buffer(fileSize);
-
-		file.seekg(0);
-		file.read(buffer.data(), fileSize);
-
-		file.close();
-		return buffer;
-	}
-
 	void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) 
 	{
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -127,40 +174,186 @@ namespace lve {
 		configInfo.attributeDescription = LveModel::Vertex::getAttributeDescriptions();
 	}
 
+	bool LvePipeline::enableExtendedDynamicState(PipelineConfigInfo& configInfo, const LveDeviceFeatures& features)
+	{
+		if (!features.extendedDynamicState) {
+			return false;
+		}
+
+		// topology stays within the baked topology class unless dynamicPrimitiveTopologyUnrestricted
+		auto& dynamicStates = configInfo.dynamicStateEnables;
+		dynamicStates.insert(dynamicStates.end(), {
+			VK_DYNAMIC_STATE_CULL_MODE_EXT,
+			VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+			VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+			VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT });
+		if (features.extendedDynamicState2) {
+			dynamicStates.insert(dynamicStates.end(), {
+				VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT,
+				VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT });
+		}
+		if (features.extendedDynamicState3PolygonMode) {
+			dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+		}
+
+		configInfo.dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+		configInfo.dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		return true;
+	}
+
+	std::unique_ptr<PipelineConfigInfo> LvePipeline::copyConfigInfo(const PipelineConfigInfo& configInfo)
+	{
+		auto copy = std::make_unique<PipelineConfigInfo>();
+		copy->bindingDescription = configInfo.bindingDescription;
+		copy->attributeDescription = configInfo.attributeDescription;
+		copy->viewportInfo = configInfo.viewportInfo;
+		copy->inputAssemblyInfo = configInfo.inputAssemblyInfo;
+		copy->rasterizationInfo = configInfo.rasterizationInfo;
+		copy->multisampleInfo = configInfo.multisampleInfo;
+		copy->colorBlendAttachment = configInfo.colorBlendAttachment;
+		copy->colorBlendInfo = configInfo.colorBlendInfo;
+		copy->depthStencilInfo = configInfo.depthStencilInfo;
+		copy->dynamicStateEnables = configInfo.dynamicStateEnables;
+		copy->dynamicStateCreateInfo = configInfo.dynamicStateCreateInfo;
+		copy->pipelineLayout = configInfo.pipelineLayout;
+		copy->renderPass = configInfo.renderPass;
+		copy->subpass = configInfo.subpass;
+		copy->colorAttachmentFormat = configInfo.colorAttachmentFormat;
+		copy->depthAttachmentFormat = configInfo.depthAttachmentFormat;
+		copy->specializationConstants = configInfo.specializationConstants;
+
+		copy->colorBlendInfo.pAttachments = &copy->colorBlendAttachment;
+		copy->dynamicStateCreateInfo.pDynamicStates = copy->dynamicStateEnables.data();
+		return copy;
+	}
+
+	bool LvePipeline::hasDynamicState(const PipelineConfigInfo& configInfo, VkDynamicState state)
+	{
+		const auto& dynamicStates = configInfo.dynamicStateEnables;
+		return std::find(dynamicStates.begin(), dynamicStates.end(), state) != dynamicStates.end();
+	}
+
+	void LvePipeline::setTarget(PipelineConfigInfo& configInfo, const LvePipelineTarget& target)
+	{
+		configInfo.renderPass = target.renderPass;
+		configInfo.subpass = 0;
+		configInfo.colorAttachmentFormat = target.colorFormat;
+		configInfo.depthAttachmentFormat = target.depthFormat;
+	}
+
+	void LvePipeline::appendStateKey(const PipelineConfigInfo& configInfo, std::vector<uint8_t>& key)
+	{
+		auto dynamic = [&configInfo](VkDynamicState state) { return hasDynamicState(configInfo, state); };
+
+		// lists are prefixed with their length so neighbouring fields cannot shift into them
+		appendKey(key, configInfo.bindingDescription.size(), configInfo.attributeDescription.size(),
+			configInfo.dynamicStateEnables.size());
+		for (const auto& binding : configInfo.bindingDescription) {
+			appendKey(key, binding.binding, binding.stride, binding.inputRate);
+		}
+		for (const auto& attribute : configInfo.attributeDescription) {
+			appendKey(key, attribute.location, attribute.binding, attribute.format, attribute.offset);
+		}
+
+		appendKey(key, configInfo.viewportInfo.viewportCount, configInfo.viewportInfo.scissorCount);
+
+		// the dynamic state list itself is keyed below, so only the baked values need to be here
+		const auto& inputAssembly = configInfo.inputAssemblyInfo;
+		if (!dynamic(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT)) appendKey(key, inputAssembly.topology);
+		if (!dynamic(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT)) appendKey(key, inputAssembly.primitiveRestartEnable);
+
+		const auto& raster = configInfo.rasterizationInfo;
+		appendKey(key, raster.depthClampEnable, raster.rasterizerDiscardEnable,
+			raster.depthBiasConstantFactor, raster.depthBiasClamp, raster.depthBiasSlopeFactor, raster.lineWidth);
+		if (!dynamic(VK_DYNAMIC_STATE_POLYGON_MODE_EXT)) appendKey(key, raster.polygonMode);
+		if (!dynamic(VK_DYNAMIC_STATE_CULL_MODE_EXT)) appendKey(key, raster.cullMode);
+		if (!dynamic(VK_DYNAMIC_STATE_FRONT_FACE_EXT)) appendKey(key, raster.frontFace);
+		if (!dynamic(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT)) appendKey(key, raster.depthBiasEnable);
+
+		const auto& multisample = configInfo.multisampleInfo;
+		appendKey(key, multisample.rasterizationSamples, multisample.sampleShadingEnable,
+			multisample.minSampleShading, multisample.alphaToCoverageEnable, multisample.alphaToOneEnable);
+
+		const auto& blend = configInfo.colorBlendAttachment;
+		appendKey(key, blend.blendEnable, blend.srcColorBlendFactor, blend.dstColorBlendFactor,
+			blend.colorBlendOp, blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp,
+			blend.colorWriteMask);
+
+		const auto& blendInfo = configInfo.colorBlendInfo;
+		appendKey(key, blendInfo.logicOpEnable, blendInfo.logicOp, blendInfo.attachmentCount,
+			blendInfo.blendConstants[0], blendInfo.blendConstants[1],
+			blendInfo.blendConstants[2], blendInfo.blendConstants[3]);
+
+		const auto& depth = configInfo.depthStencilInfo;
+		if (!dynamic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT)) appendKey(key, depth.depthTestEnable);
+		if (!dynamic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT)) appendKey(key, depth.depthWriteEnable);
+		if (!dynamic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT)) appendKey(key, depth.depthCompareOp);
+		appendKey(key, depth.depthBoundsTestEnable, depth.minDepthBounds, depth.maxDepthBounds, depth.stencilTestEnable);
+		if (depth.stencilTestEnable) {
+			for (const auto& op : { depth.front, depth.back }) {
+				appendKey(key, op.failOp, op.passOp, op.depthFailOp, op.compareOp,
+					op.compareMask, op.writeMask, op.reference);
+			}
+		}
+
+		for (auto dynamicState : configInfo.dynamicStateEnables) {
+			appendKey(key, dynamicState);
+		}
+
+		appendKey(key, configInfo.pipelineLayout, configInfo.renderPass, configInfo.subpass);
+		if (configInfo.renderPass == VK_NULL_HANDLE) {
+			appendKey(key, configInfo.colorAttachmentFormat, configInfo.depthAttachmentFormat);
+		}
+
+		// the constant values themselves, entries are ordered by id
+		VkSpecializationInfo specialization = configInfo.specializationConstants.getSpecializationInfo();
+		appendKey(key, specialization.mapEntryCount);
+		for (uint32_t i = 0; i < specialization.mapEntryCount; ++i) {
+			const auto& entry = specialization.pMapEntries[i];
+			appendKey(key, entry.constantID, entry.size);
+			auto value = static_cast<const uint8_t*>(specialization.pData) + entry.offset;
+			key.insert(key.end(), value, value + entry.size);
+		}
+	}
+
 	void LvePipeline::createGraphicsPipeline(
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
-		const PipelineConfigInfo& configInfo)
+		const PipelineConfigInfo& configInfo,
+		VkPipelineCache pipelineCache)
 	{
 		assert(
 			configInfo.pipelineLayout != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
 		assert(
-			configInfo.renderPass != VK_NULL_HANDLE &&
-			"Cannot create graphics pipeline: no renderPass provided in configInfo");
+			(configInfo.renderPass != VK_NULL_HANDLE || configInfo.colorAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+			"Cannot create graphics pipeline: no renderPass or attachment formats provided in configInfo");
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
+		_vertShaderModule = _device.shaderModuleCache().acquire(vertFilepath);
+		_fragShaderModule = _device.shaderModuleCache().acquire(fragFilepath);
 
-		createShaderModule(vertCode, &_vertShaderModule);
-		createShaderModule(fragCode, &_fragShaderModule);
+		VkSpecializationInfo specializationInfo = configInfo.specializationConstants.getSpecializationInfo();
+		const VkSpecializationInfo* pSpecializationInfo =
+			configInfo.specializationConstants.empty() ? nullptr : &specializationInfo;
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = _vertShaderModule;
+		shaderStages[0].module = _vertShaderModule->getShaderModule();
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = _fragShaderModule;
+		shaderStages[1].module = _fragShaderModule->getShaderModule();
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 		auto& bindingDescriptions = configInfo.bindingDescription;
 		auto& attributeDescriptions = configInfo.attributeDescription;
@@ -182,31 +375,36 @@ namespace lve {
 		pipelineCreateInfo.pMultisampleState = &configInfo.multisampleInfo;
 		pipelineCreateInfo.pDepthStencilState = &configInfo.depthStencilInfo;
 		pipelineCreateInfo.pColorBlendState = &configInfo.colorBlendInfo;
-		pipelineCreateInfo.pDynamicState = &configInfo.dynamicStateCreateInfo;
+		// rebuilt from the vector, a copied config still points at the original's dynamic states
+		VkPipelineDynamicStateCreateInfo dynamicStateInfo = configInfo.dynamicStateCreateInfo;
+		dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
+		dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
+
+		pipelineCreateInfo.pDynamicState = &dynamicStateInfo;
 		//pipelineCreateInfo.pu
 
 		pipelineCreateInfo.layout = configInfo.pipelineLayout;
 		pipelineCreateInfo.renderPass = configInfo.renderPass;
 		pipelineCreateInfo.subpass = configInfo.subpass;
 
+		// without a render pass the attachment formats are all the pipeline needs to know
+		VkPipelineRenderingCreateInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingInfo.colorAttachmentCount = configInfo.colorBlendInfo.attachmentCount;
+		renderingInfo.pColorAttachmentFormats = &configInfo.colorAttachmentFormat;
+		renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+		renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+		if (configInfo.renderPass == VK_NULL_HANDLE) {
+			assert(configInfo.colorBlendInfo.attachmentCount == 1 && "Dynamic rendering pipelines have one color attachment.");
+			pipelineCreateInfo.pNext = &renderingInfo;
+		}
+
 		pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineCreateInfo.basePipelineIndex = -1;
 
-		if (vkCreateGraphicsPipelines(_device.device(), VK_NULL_HANDLE, 1,
+		if (vkCreateGraphicsPipelines(_device.device(), pipelineCache, 1,
 			&pipelineCreateInfo, nullptr, &_graphicsPipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create graphics pipeline.");
 		}
 	}
-
-	void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-	{
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-		
-		if (vkCreateShaderModule(_device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shader module.");
-		}
-	}
 }
\ No newline at end of file
@@ -1,12 +1,66 @@
 #pragma once
 
 #include "lve_device.h"
+#include "lve_shader_cache.h"
 
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace lve {
+	using LvePermutationKey = uint64_t;
+
+	// Typed specialization constants applied to every stage of a pipeline.
+	// Ids a stage does not declare are ignored by the driver, so one set serves vert and frag.
+	class LveSpecializationConstants {
+	public:
+		template <typename T>
+		LveSpecializationConstants& set(uint32_t constantId, T value) {
+			static_assert(
+				std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> || std::is_same_v<T, float>,
+				"Specialization constants must be int32_t, uint32_t or float, use setBool for bools");
+			setRaw(constantId, &value, sizeof(T));
+			return *this;
+		}
+
+		LveSpecializationConstants& setBool(uint32_t constantId, bool value) {
+			VkBool32 boolValue = value ? VK_TRUE : VK_FALSE;
+			setRaw(constantId, &boolValue, sizeof(VkBool32));
+			return *this;
+		}
+
+		bool empty() const { return _entries.empty(); }
+
+		// Points into this object, keep it alive until the pipeline is created.
+		VkSpecializationInfo getSpecializationInfo() const;
+
+		// Identifies the variant, equal constant sets produce equal keys regardless of set() order.
+		LvePermutationKey permutationKey() const;
+
+		// Same ids with the same values, regardless of set() order.
+		bool operator==(const LveSpecializationConstants& other) const;
+		bool operator!=(const LveSpecializationConstants& other) const { return !(*this == other); }
+
+	private:
+		void setRaw(uint32_t constantId, const void* value, size_t size);
+
+		std::vector<VkSpecializationMapEntry> _entries{};
+		std::vector<uint8_t> _data{};
+	};
+
+	// What a graphics pipeline renders into. A null render pass means dynamic rendering, the
+	// pipeline is then only tied to the attachment formats.
+	struct LvePipelineTarget {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+		bool usesDynamicRendering() const { return renderPass == VK_NULL_HANDLE; }
+	};
+
 	struct PipelineConfigInfo {
+		PipelineConfigInfo() = default;
 		PipelineConfigInfo(const PipelineConfigInfo&) = delete;
 		PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
@@ -25,6 +79,10 @@ namespace lve {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// used instead of the render pass when it is null
+		VkFormat colorAttachmentFormat = VK_FORMAT_UNDEFINED;
+		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+		LveSpecializationConstants specializationConstants{};
 	};
 
 	class LvePipeline {
@@ -33,7 +91,8 @@ namespace lve {
 			LveDevice& device,
 			const std::string& vertFilepath, 
 			const std::string& fragFilepath,
-			const PipelineConfigInfo& config
+			const PipelineConfigInfo& config,
+			VkPipelineCache pipelineCache = VK_NULL_HANDLE
 		);
 
  		~LvePipeline();
@@ -44,19 +103,34 @@ namespace lve {
 		void bind(VkCommandBuffer commandBuffer);
 
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
-	private:
-		static std::vector<char> readFile(const std::string& filepath);
 
+		// Moves the fixed-function state the device can set at record time out of the pipeline.
+		// Returns false and leaves the config baked when VK_EXT_extended_dynamic_state is missing.
+		static bool enableExtendedDynamicState(PipelineConfigInfo& configInfo, const LveDeviceFeatures& features);
+		static bool hasDynamicState(const PipelineConfigInfo& configInfo, VkDynamicState state);
+
+		static void setTarget(PipelineConfigInfo& configInfo, const LvePipelineTarget& target);
+
+		// Configs cannot be copied by value, their create infos point into themselves. The copy's
+		// pointers are set up to point into the copy.
+		static std::unique_ptr<PipelineConfigInfo> copyConfigInfo(const PipelineConfigInfo& configInfo);
+
+		// Appends the bytes of every config field that ends up in the VkPipeline, configs with equal
+		// keys create the same pipeline. The render pass is keyed by handle, so two compatible but
+		// distinct render passes produce different keys. With dynamic rendering the attachment
+		// formats are keyed instead.
+		// Fields covered by a dynamic state are skipped, they do not distinguish pipelines.
+		static void appendStateKey(const PipelineConfigInfo& configInfo, std::vector<uint8_t>& key);
+	private:
 		void createGraphicsPipeline(
 			const std::string& vertFilepath, 
 			const std::string& fragFilepath,
-			const PipelineConfigInfo& configInfo);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+			const PipelineConfigInfo& configInfo,
+			VkPipelineCache pipelineCache);
 
 		LveDevice& _device;
 		VkPipeline _graphicsPipeline;
-		VkShaderModule _vertShaderModule;
-		VkShaderModule _fragShaderModule;
+		std::shared_ptr<LveShaderModule> _vertShaderModule;
+		std::shared_ptr<LveShaderModule> _fragShaderModule;
 	};
 }
\ No newline at end of file
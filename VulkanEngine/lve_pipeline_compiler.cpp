@@ -0,0 +1,97 @@
+#include "lve_pipeline_compiler.h"
+
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace lve {
+
+	// *************** Pipeline Handle *********************
+
+	LvePipelineHandle::LvePipelineHandle(std::future<std::unique_ptr<LvePipeline>> future)
+		: _future{ std::move(future) } {}
+
+	LvePipelineHandle::LvePipelineHandle(std::unique_ptr<LvePipeline> pipeline)
+		: _pipeline{ std::move(pipeline) } {}
+
+	bool LvePipelineHandle::isReady() {
+		return tryGet() != nullptr;
+	}
+
+	LvePipeline* LvePipelineHandle::tryGet() {
+		if (_pipeline == nullptr && _future.valid() &&
+			_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			// rethrows any compile error from the worker on the calling thread
+			_pipeline = _future.get();
+		}
+		return _pipeline.get();
+	}
+
+	LvePipeline& LvePipelineHandle::wait() {
+		if (_pipeline == nullptr) {
+			assert(_future.valid() && "Cannot wait on an empty pipeline handle.");
+			_pipeline = _future.get();
+		}
+		return *_pipeline;
+	}
+
+	std::unique_ptr<LvePipeline> LvePipelineHandle::replace(std::unique_ptr<LvePipeline> pipeline) {
+		if (_future.valid()) {
+			// an initial compile still in flight is superseded, let it finish so it can be released
+			_future.wait();
+			_pipeline = _future.get();
+		}
+		std::swap(_pipeline, pipeline);
+		return pipeline;
+	}
+
+	void LvePipelineHandle::reset() {
+		if (_future.valid()) {
+			_future.wait();
+			_future = {};
+		}
+		_pipeline = nullptr;
+	}
+
+	// *************** Pipeline Compiler *********************
+
+	LvePipelineCompiler::LvePipelineCompiler(LveDevice& device, uint32_t workerCount)
+		: _lveDevice{ device }
+	{
+		createPipelineCache();
+		_threadPool = std::make_unique<LveThreadPool>(workerCount);
+	}
+
+	LvePipelineCompiler::~LvePipelineCompiler() {
+		// join the workers first, in-flight compiles still reference the pipeline cache
+		_threadPool.reset();
+		vkDestroyPipelineCache(_lveDevice.device(), _pipelineCache, nullptr);
+	}
+
+	void LvePipelineCompiler::createPipelineCache() {
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = nullptr;
+
+		// no VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT, the driver locks it for concurrent workers
+		if (vkCreatePipelineCache(_lveDevice.device(), &cacheInfo, nullptr, &_pipelineCache) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline cache.");
+		}
+	}
+
+	LvePipelineHandle LvePipelineCompiler::submit(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		std::unique_ptr<PipelineConfigInfo> config)
+	{
+		assert(config != nullptr && "Cannot submit a pipeline without a config.");
+
+		auto future = _threadPool->submit(
+			[this, vertFilepath, fragFilepath, config = std::move(config)]() {
+				return std::make_unique<LvePipeline>(
+					_lveDevice, vertFilepath, fragFilepath, *config, _pipelineCache);
+			});
+		return LvePipelineHandle{ std::move(future) };
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_pipeline.h"
+#include "lve_thread_pool.h"
+
+#include <future>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+	// Owns a pipeline that may still be compiling on a worker thread.
+	// Render systems either wait() for it or poll tryGet() and substitute a fallback.
+	class LvePipelineHandle {
+	public:
+		LvePipelineHandle() = default;
+		explicit LvePipelineHandle(std::future<std::unique_ptr<LvePipeline>> future);
+		explicit LvePipelineHandle(std::unique_ptr<LvePipeline> pipeline);
+
+		LvePipelineHandle(const LvePipelineHandle&) = delete;
+		LvePipelineHandle& operator=(const LvePipelineHandle&) = delete;
+		LvePipelineHandle(LvePipelineHandle&&) = default;
+		LvePipelineHandle& operator=(LvePipelineHandle&&) = default;
+
+		bool isReady();
+		LvePipeline* tryGet();
+		LvePipeline& wait();
+
+		// Swaps in a rebuilt pipeline and hands back the previous one, which the caller must keep
+		// alive until every frame that recorded it has completed.
+		std::unique_ptr<LvePipeline> replace(std::unique_ptr<LvePipeline> pipeline);
+
+		// Blocks until a pending compile finishes and releases the pipeline.
+		// Owners call this before destroying the layout the compile references.
+		void reset();
+
+	private:
+		std::future<std::unique_ptr<LvePipeline>> _future;
+		std::unique_ptr<LvePipeline> _pipeline;
+	};
+
+	class LvePipelineCompiler {
+	public:
+		LvePipelineCompiler(LveDevice& device, uint32_t workerCount = 0);
+		~LvePipelineCompiler();
+
+		LvePipelineCompiler(const LvePipelineCompiler&) = delete;
+		LvePipelineCompiler& operator=(const LvePipelineCompiler&) = delete;
+
+		// The config is moved onto the worker, its internal pointers stay valid because it is heap allocated.
+		LvePipelineHandle submit(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			std::unique_ptr<PipelineConfigInfo> config);
+
+		VkPipelineCache getPipelineCache() const { return _pipelineCache; }
+		LveThreadPool& getThreadPool() { return *_threadPool; }
+
+	private:
+		void createPipelineCache();
+
+		LveDevice& _lveDevice;
+		VkPipelineCache _pipelineCache = VK_NULL_HANDLE;
+		std::unique_ptr<LveThreadPool> _threadPool;
+	};
+}
@@ -0,0 +1,111 @@
+#include "lve_pipeline_state_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <string_view>
+
+namespace lve {
+
+	LvePipelineStateCache::LvePipelineStateCache(LveDevice& device, VkPipelineCache pipelineCache)
+		: _lveDevice{ device }, _pipelineCache{ pipelineCache } {}
+
+	LvePipelineStateCache::~LvePipelineStateCache() {
+		// the reloader is gone by now and no longer holds the handles
+		_hotReloader = nullptr;
+		clear();
+	}
+
+	std::vector<uint8_t> LvePipelineStateCache::computeKey(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo)
+	{
+		// paths rather than shader content, a watched entry is rebuilt in place when its shaders
+		// change and keeps its key
+		std::vector<uint8_t> key;
+		for (const std::string* path : { &vertFilepath, &fragFilepath }) {
+			uint32_t length = static_cast<uint32_t>(path->size());
+			auto lengthBytes = reinterpret_cast<const uint8_t*>(&length);
+			key.insert(key.end(), lengthBytes, lengthBytes + sizeof(length));
+			key.insert(key.end(), path->begin(), path->end());
+		}
+		LvePipeline::appendStateKey(configInfo, key);
+		return key;
+	}
+
+	LvePipelineHandle& LvePipelineStateCache::getPipeline(
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		const PipelineConfigInfo& configInfo)
+	{
+		std::vector<uint8_t> key = computeKey(vertFilepath, fragFilepath, configInfo);
+		size_t hash = std::hash<std::string_view>{}(
+			std::string_view(reinterpret_cast<const char*>(key.data()), key.size()));
+
+		auto range = _pipelines.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second.key == key) {
+				_stats.hits++;
+				return it->second.pipeline;
+			}
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		auto pipeline = std::make_unique<LvePipeline>(
+			_lveDevice, vertFilepath, fragFilepath, configInfo, _pipelineCache);
+		auto elapsed = std::chrono::duration<double, std::chrono::milliseconds::period>(
+			std::chrono::high_resolution_clock::now() - start).count();
+
+		_stats.misses++;
+		_stats.compileMilliseconds += elapsed;
+		_stats.slowestCompileMilliseconds = std::max(_stats.slowestCompileMilliseconds, elapsed);
+
+		auto it = _pipelines.emplace(hash, Entry{ std::move(key), vertFilepath, fragFilepath,
+			LvePipeline::copyConfigInfo(configInfo), LvePipelineHandle{ std::move(pipeline) } });
+		if (_hotReloader != nullptr) {
+			watchEntry(it->second);
+		}
+		return it->second.pipeline;
+	}
+
+	void LvePipelineStateCache::watchShaders(LveShaderHotReloader& hotReloader)
+	{
+		assert(_hotReloader == nullptr && "Pipeline state cache is already watched.");
+		_hotReloader = &hotReloader;
+		for (auto& kv : _pipelines) {
+			watchEntry(kv.second);
+		}
+	}
+
+	void LvePipelineStateCache::watchEntry(Entry& entry)
+	{
+		const PipelineConfigInfo* config = entry.config.get();
+		_hotReloader->watchPipeline(entry.pipeline, entry.vertFilepath, entry.fragFilepath,
+			[config]() { return LvePipeline::copyConfigInfo(*config); });
+	}
+
+	void LvePipelineStateCache::evict(VkPipelineLayout pipelineLayout)
+	{
+		for (auto it = _pipelines.begin(); it != _pipelines.end();) {
+			if (it->second.config->pipelineLayout != pipelineLayout) {
+				++it;
+				continue;
+			}
+			if (_hotReloader != nullptr) {
+				_hotReloader->unwatchPipeline(it->second.pipeline);
+			}
+			it = _pipelines.erase(it);
+		}
+	}
+
+	void LvePipelineStateCache::clear()
+	{
+		if (_hotReloader != nullptr) {
+			for (auto& kv : _pipelines) {
+				_hotReloader->unwatchPipeline(kv.second.pipeline);
+			}
+		}
+		_pipelines.clear();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_shader_hot_reload.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+	// Lazily created pipelines keyed by the shader paths plus the PipelineConfigInfo state key.
+	// The first request for a state combination compiles it, later requests return the cached
+	// pipeline. Lookups hash the key and compare it in full, so a collision compiles a pipeline
+	// instead of returning another state's.
+	class LvePipelineStateCache {
+	public:
+		struct Stats {
+			uint32_t hits = 0;
+			uint32_t misses = 0;
+			double compileMilliseconds = 0.0;
+			double slowestCompileMilliseconds = 0.0;
+		};
+
+		LvePipelineStateCache(LveDevice& device, VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+		~LvePipelineStateCache();
+
+		LvePipelineStateCache(const LvePipelineStateCache&) = delete;
+		LvePipelineStateCache& operator=(const LvePipelineStateCache&) = delete;
+
+		// The handle is ready and stays valid until its entry is evicted. Once the cache watches
+		// shaders the pipeline in it is replaced when they change, so hold on to the handle rather
+		// than the pipeline.
+		LvePipelineHandle& getPipeline(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo);
+
+		size_t size() const { return _pipelines.size(); }
+		const Stats& getStats() const { return _stats; }
+		void resetStats() { _stats = {}; }
+
+		// Rebuilds every current and future pipeline on the reloader's workers when its shaders
+		// change. The reloader must stay alive while the cache is used, and be destroyed before it.
+		void watchShaders(LveShaderHotReloader& hotReloader);
+
+		// Destroys the pipelines created with the layout. Its owner calls this before destroying
+		// the layout, once the GPU is done with them.
+		void evict(VkPipelineLayout pipelineLayout);
+		void clear();
+
+	private:
+		struct Entry {
+			std::vector<uint8_t> key;
+			std::string vertFilepath;
+			std::string fragFilepath;
+			// rebuilds start from this copy, the caller's config is gone by then
+			std::unique_ptr<PipelineConfigInfo> config;
+			LvePipelineHandle pipeline;
+		};
+
+		static std::vector<uint8_t> computeKey(
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			const PipelineConfigInfo& configInfo);
+		void watchEntry(Entry& entry);
+
+		LveDevice& _lveDevice;
+		VkPipelineCache _pipelineCache;
+		LveShaderHotReloader* _hotReloader = nullptr;
+
+		// bucketed by the hash of the key, nodes keep their address so the reloader can hold the handles
+		std::unordered_multimap<size_t, Entry> _pipelines;
+		Stats _stats{};
+	};
+}
@@ -0,0 +1,83 @@
+#include "lve_pipeline_variants.h"
+
+#include <cassert>
+
+namespace lve {
+
+	LvePipelineVariantCache::LvePipelineVariantCache(
+		LvePipelineCompiler& pipelineCompiler,
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		ConfigureFn configure)
+		: _pipelineCompiler{ pipelineCompiler },
+		_vertFilepath{ vertFilepath },
+		_fragFilepath{ fragFilepath },
+		_configure{ std::move(configure) } {}
+
+	LvePermutationKey LvePipelineVariantCache::request(const LveSpecializationConstants& constants) {
+		// a different constant set with the same hash moves on to the next free key, so the keys
+		// handed out stay unique within the cache
+		LvePermutationKey key = constants.permutationKey();
+		for (auto it = _variantConstants.find(key); it != _variantConstants.end(); it = _variantConstants.find(key)) {
+			if (it->second == constants) {
+				return key;
+			}
+			key++;
+		}
+
+		auto it = _variants.emplace(key,
+			_pipelineCompiler.submit(_vertFilepath, _fragFilepath, makeConfig(constants))).first;
+		_variantConstants.emplace(key, constants);
+		if (_hotReloader != nullptr) {
+			watchVariant(it->second, constants);
+		}
+		return key;
+	}
+
+	std::unique_ptr<PipelineConfigInfo> LvePipelineVariantCache::makeConfig(
+		const LveSpecializationConstants& constants) const
+	{
+		auto config = std::make_unique<PipelineConfigInfo>();
+		LvePipeline::defaultPipelineConfigInfo(*config);
+		_configure(*config);
+		config->specializationConstants = constants;
+		return config;
+	}
+
+	void LvePipelineVariantCache::watchShaders(LveShaderHotReloader& hotReloader) {
+		assert(_hotReloader == nullptr && "Variant cache is already watched.");
+		_hotReloader = &hotReloader;
+		for (auto& kv : _variants) {
+			watchVariant(kv.second, _variantConstants.at(kv.first));
+		}
+	}
+
+	void LvePipelineVariantCache::watchVariant(
+		LvePipelineHandle& variant, const LveSpecializationConstants& constants)
+	{
+		_hotReloader->watchPipeline(variant, _vertFilepath, _fragFilepath,
+			[this, constants]() { return makeConfig(constants); });
+	}
+
+	LvePipelineHandle* LvePipelineVariantCache::find(LvePermutationKey key) {
+		auto it = _variants.find(key);
+		return it == _variants.end() ? nullptr : &it->second;
+	}
+
+	LvePipelineHandle& LvePipelineVariantCache::get(LvePermutationKey key) {
+		auto it = _variants.find(key);
+		assert(it != _variants.end() && "Pipeline variant was never requested.");
+		return it->second;
+	}
+
+	void LvePipelineVariantCache::clear() {
+		for (auto& kv : _variants) {
+			if (_hotReloader != nullptr) {
+				_hotReloader->unwatchPipeline(kv.second);
+			}
+			kv.second.reset();
+		}
+		_variants.clear();
+		_variantConstants.clear();
+	}
+}
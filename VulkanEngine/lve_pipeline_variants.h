@@ -0,0 +1,55 @@
+#pragma once
+
+#include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_shader_hot_reload.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace lve {
+
+	// Compile-time shader variants of one vert/frag pair, keyed by their specialization constants.
+	// Variants are compiled on the pipeline compiler the first time they are requested.
+	class LvePipelineVariantCache {
+	public:
+		using ConfigureFn = std::function<void(PipelineConfigInfo&)>;
+
+		LvePipelineVariantCache(
+			LvePipelineCompiler& pipelineCompiler,
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			ConfigureFn configure);
+
+		LvePipelineVariantCache(const LvePipelineVariantCache&) = delete;
+		LvePipelineVariantCache& operator=(const LvePipelineVariantCache&) = delete;
+
+		// The key is the constants' permutationKey unless another requested set collides with it.
+		LvePermutationKey request(const LveSpecializationConstants& constants);
+		LvePipelineHandle* find(LvePermutationKey key);
+		LvePipelineHandle& get(LvePermutationKey key);
+
+		size_t size() const { return _variants.size(); }
+
+		// Registers every current and future variant for rebuild when its shaders change. The
+		// reloader must stay alive until clear().
+		void watchShaders(LveShaderHotReloader& hotReloader);
+
+		// Waits for pending compiles and rebuilds, call before destroying the layout the variants use.
+		void clear();
+
+	private:
+		std::unique_ptr<PipelineConfigInfo> makeConfig(const LveSpecializationConstants& constants) const;
+		void watchVariant(LvePipelineHandle& variant, const LveSpecializationConstants& constants);
+
+		LvePipelineCompiler& _pipelineCompiler;
+		LveShaderHotReloader* _hotReloader = nullptr;
+		std::string _vertFilepath;
+		std::string _fragFilepath;
+		ConfigureFn _configure;
+
+		std::unordered_map<LvePermutationKey, LvePipelineHandle> _variants;
+		std::unordered_map<LvePermutationKey, LveSpecializationConstants> _variantConstants;
+	};
+}
@@ -0,0 +1,1023 @@
+#include "lve_render_graph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+	namespace {
+		struct UsageInfo {
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			// for images, buffers ignore it
+			VkImageLayout layout;
+			bool write;
+			VkImageUsageFlags imageUsage;
+			VkBufferUsageFlags bufferUsage;
+		};
+
+		constexpr VkPipelineStageFlags2 FRAGMENT_TESTS =
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+		constexpr VkAccessFlags2 WRITE_ACCESS =
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+		// indexed by LveGraphUsage
+		const UsageInfo USAGE_INFOS[] = {
+			{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 },
+			{ FRAGMENT_TESTS,
+				VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+			{ FRAGMENT_TESTS, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 },
+			{ VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },
+			{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, VK_IMAGE_USAGE_SAMPLED_BIT, 0 },
+			{ VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+			{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, false, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+			{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_GENERAL, true, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT },
+			{ VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, false, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT },
+			{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT },
+			{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT },
+			// presentation waits on a semaphore, not on a stage
+			{ VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false, 0, 0 },
+		};
+		static_assert(sizeof(USAGE_INFOS) / sizeof(USAGE_INFOS[0]) == static_cast<size_t>(LveGraphUsage::COUNT),
+			"Every LveGraphUsage needs an entry.");
+
+		const UsageInfo& usageInfo(LveGraphUsage usage) {
+			return USAGE_INFOS[static_cast<uint32_t>(usage)];
+		}
+
+		// all uses of one resource in one pass
+		struct MergedUse {
+			uint32_t pass;
+			VkPipelineStageFlags2 stages;
+			VkAccessFlags2 access;
+			VkImageLayout layout;
+			bool write;
+		};
+
+		// how the last passes left a resource
+		struct ResourceState {
+			VkImageLayout layout;
+			// the last write, or the layout transition standing in for one
+			VkPipelineStageFlags2 writeStages;
+			VkAccessFlags2 writeAccess;
+			// reads since then
+			VkPipelineStageFlags2 readStages;
+			// stages and accesses a barrier already made the last write visible to
+			VkPipelineStageFlags2 visibleStages;
+			VkAccessFlags2 visibleAccess;
+		};
+	}
+
+	LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::use(LveGraphResource resource, LveGraphUsage usage)
+	{
+		assert(resource.isValid() && resource.index < _graph._resources.size() && "Unknown render graph resource.");
+		assert(usage != LveGraphUsage::COUNT && "Invalid render graph usage.");
+		assert((!_graph._resources[resource.index].isImage || usageInfo(usage).layout != VK_IMAGE_LAYOUT_UNDEFINED)
+			&& "Usage does not apply to images.");
+		_graph._passes[_pass].uses.push_back({ resource.index, usage });
+		return *this;
+	}
+
+	LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::sideEffects()
+	{
+		_graph._passes[_pass].sideEffects = true;
+		return *this;
+	}
+
+	LveRenderGraph::PassBuilder& LveRenderGraph::PassBuilder::record(RecordFn recordFn)
+	{
+		_graph._passes[_pass].recordFn = std::move(recordFn);
+		return *this;
+	}
+
+	LveRenderGraph::~LveRenderGraph()
+	{
+		destroyTransients();
+	}
+
+	void LveRenderGraph::reset()
+	{
+		destroyTransients();
+		_passes.clear();
+		_resources.clear();
+		_slots.clear();
+		_batches.clear();
+		_compiled = false;
+		_stats = Stats{};
+	}
+
+	LveGraphResource LveRenderGraph::addResource(Resource resource)
+	{
+		assert(!_compiled && "Cannot add resources to a compiled render graph, reset it first.");
+		resource.firstPass = NO_PASS;
+		resource.lastPass = NO_PASS;
+		_resources.push_back(std::move(resource));
+		return LveGraphResource{ static_cast<uint32_t>(_resources.size() - 1) };
+	}
+
+	LveGraphResource LveRenderGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+		VkExtent2D extent, VkImageAspectFlags aspect, VkImageLayout currentLayout, VkImageLayout finalLayout,
+		LveGraphUsage lastUsage)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.isImage = true;
+		resource.imported = true;
+		resource.imageDesc = { extent, VK_FORMAT_UNDEFINED, aspect };
+		resource.initialLayout = currentLayout;
+		resource.finalLayout = finalLayout;
+		resource.lastUsage = lastUsage;
+		resource.image = image;
+		resource.view = view;
+		return addResource(std::move(resource));
+	}
+
+	LveGraphResource LveRenderGraph::importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size,
+		LveGraphUsage lastUsage)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.isImage = false;
+		resource.imported = true;
+		resource.size = size;
+		resource.lastUsage = lastUsage;
+		resource.buffer = buffer;
+		return addResource(std::move(resource));
+	}
+
+	LveGraphResource LveRenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.isImage = true;
+		resource.imported = false;
+		resource.imageDesc = desc;
+		return addResource(std::move(resource));
+	}
+
+	LveGraphResource LveRenderGraph::createBuffer(const std::string& name, VkDeviceSize size)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.isImage = false;
+		resource.imported = false;
+		resource.size = size;
+		return addResource(std::move(resource));
+	}
+
+	void LveRenderGraph::setImportedImage(LveGraphResource resource, VkImage image, VkImageView view)
+	{
+		Resource& imported = _resources[resource.index];
+		assert(imported.imported && imported.isImage && "Not an imported image.");
+		imported.image = image;
+		imported.view = view;
+	}
+
+	void LveRenderGraph::setImportedBuffer(LveGraphResource resource, VkBuffer buffer)
+	{
+		Resource& imported = _resources[resource.index];
+		assert(imported.imported && !imported.isImage && "Not an imported buffer.");
+		imported.buffer = buffer;
+	}
+
+	LveRenderGraph::PassBuilder LveRenderGraph::addPass(const std::string& name)
+	{
+		assert(!_compiled && "Cannot add passes to a compiled render graph, reset it first.");
+		_passes.emplace_back();
+		_passes.back().name = name;
+		return PassBuilder{ *this, static_cast<uint32_t>(_passes.size() - 1) };
+	}
+
+	VkImage LveRenderGraph::getImage(LveGraphResource resource) const { return _resources[resource.index].image; }
+	VkImageView LveRenderGraph::getImageView(LveGraphResource resource) const { return _resources[resource.index].view; }
+	VkBuffer LveRenderGraph::getBuffer(LveGraphResource resource) const { return _resources[resource.index].buffer; }
+	VkExtent2D LveRenderGraph::getExtent(LveGraphResource resource) const { return _resources[resource.index].imageDesc.extent; }
+
+	void LveRenderGraph::compile(LveDevice& device)
+	{
+		assert(!_compiled && "Render graph is already compiled.");
+		_lveDevice = &device;
+
+		cullPasses();
+		computeLifetimes();
+		createTransients();
+		std::vector<VkMemoryRequirements> requirements(_resources.size());
+		for (uint32_t i = 0; i < _resources.size(); ++i) {
+			const Resource& resource = _resources[i];
+			if (resource.image != VK_NULL_HANDLE && !resource.imported) {
+				vkGetImageMemoryRequirements(device.device(), resource.image, &requirements[i]);
+			}
+			else if (resource.buffer != VK_NULL_HANDLE && !resource.imported) {
+				vkGetBufferMemoryRequirements(device.device(), resource.buffer, &requirements[i]);
+			}
+		}
+		assignMemory([&requirements](LveGraphResource resource) { return requirements[resource.index]; });
+		allocateMemory();
+		buildBarriers();
+		_compiled = true;
+	}
+
+	void LveRenderGraph::compileWithoutDevice(const MemoryRequirementsFn& requirementsOf)
+	{
+		assert(!_compiled && "Render graph is already compiled.");
+		cullPasses();
+		computeLifetimes();
+		assignMemory(requirementsOf);
+		buildBarriers();
+		_compiled = true;
+	}
+
+	void LveRenderGraph::cullPasses()
+	{
+		// walking backwards, a pass is kept when it writes something a kept pass or the world outside
+		// the graph uses, everything a kept pass uses is then needed in turn
+		std::vector<bool> needed(_resources.size());
+		for (uint32_t i = 0; i < _resources.size(); ++i) {
+			needed[i] = _resources[i].imported;
+		}
+
+		_stats.passes = static_cast<uint32_t>(_passes.size());
+		_stats.culledPasses = 0;
+		for (uint32_t i = static_cast<uint32_t>(_passes.size()); i-- > 0;) {
+			Pass& pass = _passes[i];
+			pass.kept = pass.sideEffects;
+			for (const Use& use : pass.uses) {
+				if (usageInfo(use.usage).write && needed[use.resource]) {
+					pass.kept = true;
+				}
+			}
+
+			if (!pass.kept) {
+				_stats.culledPasses++;
+				continue;
+			}
+			for (const Use& use : pass.uses) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	void LveRenderGraph::computeLifetimes()
+	{
+		for (uint32_t i = 0; i < _passes.size(); ++i) {
+			if (!_passes[i].kept) continue;
+
+			for (const Use& use : _passes[i].uses) {
+				Resource& resource = _resources[use.resource];
+				if (resource.firstPass == NO_PASS) {
+					resource.firstPass = i;
+				}
+				resource.lastPass = i;
+				resource.imageUsage |= usageInfo(use.usage).imageUsage;
+				resource.bufferUsage |= usageInfo(use.usage).bufferUsage;
+			}
+		}
+	}
+
+	void LveRenderGraph::assignMemory(const MemoryRequirementsFn& requirementsOf)
+	{
+		std::vector<uint32_t> transients;
+		for (uint32_t i = 0; i < _resources.size(); ++i) {
+			if (!_resources[i].imported && _resources[i].firstPass != NO_PASS) {
+				transients.push_back(i);
+			}
+		}
+		std::stable_sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+			return _resources[a].firstPass < _resources[b].firstPass;
+		});
+
+		_slots.clear();
+		_stats.transientResources = static_cast<uint32_t>(transients.size());
+		_stats.unaliasedBytes = 0;
+		for (uint32_t index : transients) {
+			Resource& resource = _resources[index];
+			VkMemoryRequirements requirements = requirementsOf(LveGraphResource{ index });
+			_stats.unaliasedBytes += requirements.size;
+
+			// the free slot closest in size, so large and small resources do not pair up and
+			// grow every slot to the largest size
+			uint32_t best = NO_SLOT;
+			VkDeviceSize bestDifference = 0;
+			for (uint32_t s = 0; s < _slots.size(); ++s) {
+				const MemorySlot& slot = _slots[s];
+				if (slot.lastPass >= resource.firstPass || (slot.memoryTypeBits & requirements.memoryTypeBits) == 0) {
+					continue;
+				}
+				VkDeviceSize difference = slot.size > requirements.size
+					? slot.size - requirements.size : requirements.size - slot.size;
+				if (best == NO_SLOT || difference < bestDifference) {
+					best = s;
+					bestDifference = difference;
+				}
+			}
+
+			if (best == NO_SLOT) {
+				best = static_cast<uint32_t>(_slots.size());
+				_slots.push_back({ requirements.size, requirements.alignment, requirements.memoryTypeBits, 0, index });
+			}
+			else {
+				MemorySlot& slot = _slots[best];
+				resource.aliasOf = slot.lastResource;
+				slot.size = std::max(slot.size, requirements.size);
+				slot.alignment = std::max(slot.alignment, requirements.alignment);
+				slot.memoryTypeBits &= requirements.memoryTypeBits;
+				slot.lastResource = index;
+			}
+			_slots[best].lastPass = resource.lastPass;
+			resource.memorySlot = best;
+		}
+
+		_stats.memorySlots = static_cast<uint32_t>(_slots.size());
+		_stats.transientBytes = 0;
+		for (const MemorySlot& slot : _slots) {
+			_stats.transientBytes += slot.size;
+		}
+	}
+
+	void LveRenderGraph::buildBarriers()
+	{
+		// each resource's uses in pass order, merged per pass, so a barrier can look ahead
+		std::vector<std::vector<MergedUse>> timelines(_resources.size());
+		for (uint32_t i = 0; i < _passes.size(); ++i) {
+			if (!_passes[i].kept) continue;
+
+			for (const Use& use : _passes[i].uses) {
+				const UsageInfo& info = usageInfo(use.usage);
+				auto& timeline = timelines[use.resource];
+				if (timeline.empty() || timeline.back().pass != i) {
+					timeline.push_back({ i, info.stages, info.access, info.layout, info.write });
+					continue;
+				}
+
+				MergedUse& merged = timeline.back();
+				if (_resources[use.resource].isImage && merged.layout != info.layout) {
+					throw std::runtime_error("Render graph pass '" + _passes[i].name + "' uses '"
+						+ _resources[use.resource].name + "' in two layouts.");
+				}
+				merged.stages |= info.stages;
+				merged.access |= info.access;
+				merged.write = merged.write || info.write;
+			}
+		}
+
+		std::vector<ResourceState> initialStates(_resources.size());
+		for (uint32_t i = 0; i < _resources.size(); ++i) {
+			const Resource& resource = _resources[i];
+			ResourceState& state = initialStates[i];
+			state = {};
+			state.layout = resource.imported ? resource.initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+			if (resource.imported && resource.lastUsage != LveGraphUsage::COUNT) {
+				const UsageInfo& info = usageInfo(resource.lastUsage);
+				if (info.write) {
+					state.writeStages = info.stages;
+					state.writeAccess = info.access & WRITE_ACCESS;
+				}
+				else {
+					state.readStages = info.stages;
+				}
+			}
+		}
+
+		// Walks the kept passes from the initial states. The transients are shared by every frame in
+		// flight, so the first use of a slot's memory must also wait for how the previous execution
+		// left it; given that execution's final states, the first occupant of each slot syncs with
+		// the slot's last occupant there.
+		auto walkPasses = [&](const std::vector<ResourceState>* previousExecution) {
+			std::vector<ResourceState> states = initialStates;
+			std::vector<uint32_t> cursors(_resources.size(), 0);
+			_batches.clear();
+			for (uint32_t p = 0; p < _passes.size(); ++p) {
+				if (!_passes[p].kept) continue;
+
+				BarrierBatch batch{ p, {} };
+				for (uint32_t r = 0; r < _resources.size(); ++r) {
+					const auto& timeline = timelines[r];
+					if (cursors[r] >= timeline.size() || timeline[cursors[r]].pass != p) continue;
+
+					const Resource& resource = _resources[r];
+					const MergedUse& use = timeline[cursors[r]];
+					ResourceState& state = states[r];
+
+					// the previous occupant of the memory must be done before this resource starts using it
+					bool aliasing = false;
+					if (cursors[r] == 0 && resource.aliasOf != LveGraphResource::INVALID) {
+						const ResourceState& previous = states[resource.aliasOf];
+						state.writeStages = previous.writeStages | previous.readStages;
+						state.writeAccess = previous.writeAccess;
+						aliasing = true;
+					}
+					else if (cursors[r] == 0 && !resource.imported && previousExecution != nullptr) {
+						uint32_t lastOccupant = _slots[resource.memorySlot].lastResource;
+						const ResourceState& previous = (*previousExecution)[lastOccupant];
+						state.writeStages = previous.writeStages | previous.readStages;
+						state.writeAccess = previous.writeAccess;
+						aliasing = lastOccupant != r;
+					}
+
+					Barrier barrier{};
+					barrier.resource = LveGraphResource{ r };
+					barrier.oldLayout = resource.isImage ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+					barrier.newLayout = resource.isImage ? use.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+					barrier.aliasing = aliasing;
+
+					// reads in the same layout up to the next write share the barrier of the first one
+					auto widenToLaterReads = [&]() {
+						for (size_t next = cursors[r] + 1; next < timeline.size(); ++next) {
+							if (timeline[next].write || (resource.isImage && timeline[next].layout != use.layout)) break;
+							barrier.dstStageMask |= timeline[next].stages;
+							barrier.dstAccessMask |= timeline[next].access;
+						}
+					};
+
+					bool needsBarrier = false;
+					bool transition = resource.isImage && state.layout != use.layout;
+					if (transition) {
+						needsBarrier = true;
+						barrier.srcStageMask = state.writeStages | state.readStages;
+						barrier.srcAccessMask = state.writeAccess;
+						barrier.dstStageMask = use.stages;
+						barrier.dstAccessMask = use.access;
+					}
+					else if (use.write) {
+						// write after write needs the old write made available, write after read only
+						// needs the reads to finish
+						needsBarrier = (state.writeStages | state.readStages) != 0;
+						barrier.srcStageMask = state.writeStages | state.readStages;
+						barrier.srcAccessMask = state.readStages != 0 ? VK_ACCESS_2_NONE : state.writeAccess;
+						barrier.dstStageMask = use.stages;
+						barrier.dstAccessMask = use.access;
+					}
+					else if (state.writeStages != 0 &&
+						((use.stages & ~state.visibleStages) != 0 || (use.access & ~state.visibleAccess) != 0)) {
+						needsBarrier = true;
+						barrier.srcStageMask = state.writeStages;
+						barrier.srcAccessMask = state.writeAccess;
+						barrier.dstStageMask = use.stages;
+						barrier.dstAccessMask = use.access;
+					}
+
+					if (needsBarrier && !use.write) {
+						widenToLaterReads();
+					}
+
+					if (use.write) {
+						state.writeStages = use.stages;
+						state.writeAccess = use.access & WRITE_ACCESS;
+						state.readStages = 0;
+						state.visibleStages = 0;
+						state.visibleAccess = 0;
+					}
+					else {
+						if (transition) {
+							// the transition happens before the barrier's destination stages, later reads
+							// chain on those
+							state.writeStages = barrier.dstStageMask;
+							state.writeAccess = VK_ACCESS_2_NONE;
+							state.visibleStages = 0;
+							state.visibleAccess = 0;
+						}
+						if (needsBarrier) {
+							state.visibleStages |= barrier.dstStageMask;
+							state.visibleAccess |= barrier.dstAccessMask;
+						}
+						state.readStages |= use.stages;
+					}
+					if (resource.isImage) {
+						state.layout = use.layout;
+					}
+
+					if (needsBarrier) {
+						batch.barriers.push_back(barrier);
+					}
+					cursors[r]++;
+				}
+
+				if (!batch.barriers.empty()) {
+					_batches.push_back(std::move(batch));
+				}
+			}
+			return states;
+		};
+
+		std::vector<ResourceState> lastExecution = walkPasses(nullptr);
+		std::vector<ResourceState> states = walkPasses(&lastExecution);
+
+		// hand imported images over in the layout their owner expects
+		BarrierBatch finalBatch{ BarrierBatch::FINAL_BATCH, {} };
+		for (uint32_t r = 0; r < _resources.size(); ++r) {
+			const Resource& resource = _resources[r];
+			const ResourceState& state = states[r];
+			if (!resource.imported || !resource.isImage || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED
+				|| resource.finalLayout == state.layout) {
+				continue;
+			}
+
+			Barrier barrier{};
+			barrier.resource = LveGraphResource{ r };
+			barrier.srcStageMask = state.writeStages | state.readStages;
+			barrier.srcAccessMask = state.writeAccess;
+			// presentation synchronizes through the semaphore, anything else may be used right after
+			if (resource.finalLayout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
+				barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+				barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+			}
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.finalLayout;
+			barrier.aliasing = false;
+			finalBatch.barriers.push_back(barrier);
+		}
+		if (!finalBatch.barriers.empty()) {
+			_batches.push_back(std::move(finalBatch));
+		}
+
+		_stats.batches = static_cast<uint32_t>(_batches.size());
+		_stats.barriers = 0;
+		for (const auto& batch : _batches) {
+			_stats.barriers += static_cast<uint32_t>(batch.barriers.size());
+		}
+	}
+
+	void LveRenderGraph::createTransients()
+	{
+		VkDevice device = _lveDevice->device();
+		for (Resource& resource : _resources) {
+			if (resource.imported || resource.firstPass == NO_PASS) continue;
+
+			if (resource.isImage) {
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.extent = { resource.imageDesc.extent.width, resource.imageDesc.extent.height, 1 };
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = resource.imageDesc.format;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageInfo.usage = resource.imageUsage;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create render graph image '" + resource.name + "'.");
+				}
+			}
+			else {
+				VkBufferCreateInfo bufferInfo{};
+				bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferInfo.size = resource.size;
+				bufferInfo.usage = resource.bufferUsage;
+				bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				if (vkCreateBuffer(device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS) {
+					throw std::runtime_error("Failed to create render graph buffer '" + resource.name + "'.");
+				}
+			}
+		}
+	}
+
+	void LveRenderGraph::allocateMemory()
+	{
+		VkDevice device = _lveDevice->device();
+		for (MemorySlot& slot : _slots) {
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = slot.size;
+			allocInfo.memoryTypeIndex = _lveDevice->findMemoryType(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			if (vkAllocateMemory(device, &allocInfo, nullptr, &slot.memory) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate render graph memory.");
+			}
+		}
+
+		// every resource in a slot starts at offset 0, their pass ranges never overlap
+		for (Resource& resource : _resources) {
+			if (resource.memorySlot == NO_SLOT) continue;
+
+			VkDeviceMemory memory = _slots[resource.memorySlot].memory;
+			if (!resource.isImage) {
+				vkBindBufferMemory(device, resource.buffer, memory, 0);
+				continue;
+			}
+
+			vkBindImageMemory(device, resource.image, memory, 0);
+
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = resource.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = resource.imageDesc.format;
+			viewInfo.subresourceRange.aspectMask = resource.imageDesc.aspect;
+			viewInfo.subresourceRange.baseMipLevel = 0;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph image view '" + resource.name + "'.");
+			}
+		}
+	}
+
+	void LveRenderGraph::destroyTransients()
+	{
+		if (_lveDevice == nullptr) return;
+
+		VkDevice device = _lveDevice->device();
+		for (Resource& resource : _resources) {
+			if (resource.imported) continue;
+
+			vkDestroyImageView(device, resource.view, nullptr);
+			vkDestroyImage(device, resource.image, nullptr);
+			vkDestroyBuffer(device, resource.buffer, nullptr);
+			resource.view = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+			resource.buffer = VK_NULL_HANDLE;
+		}
+		for (MemorySlot& slot : _slots) {
+			vkFreeMemory(device, slot.memory, nullptr);
+			slot.memory = VK_NULL_HANDLE;
+		}
+	}
+
+	void LveRenderGraph::execute(VkCommandBuffer commandBuffer)
+	{
+		assert(_compiled && _lveDevice != nullptr && "Render graph must be compiled with a device before executing.");
+
+		auto batch = _batches.begin();
+		for (uint32_t p = 0; p < _passes.size(); ++p) {
+			if (!_passes[p].kept) continue;
+
+			if (batch != _batches.end() && batch->beforePass == p) {
+				recordBatch(commandBuffer, *batch);
+				++batch;
+			}
+			if (_passes[p].recordFn) {
+				_passes[p].recordFn(commandBuffer);
+			}
+		}
+		if (batch != _batches.end()) {
+			recordBatch(commandBuffer, *batch);
+		}
+	}
+
+	void LveRenderGraph::recordBatch(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const
+	{
+		auto subresourceRange = [](const Resource& resource) {
+			VkImageSubresourceRange range{};
+			range.aspectMask = resource.imageDesc.aspect;
+			range.levelCount = VK_REMAINING_MIP_LEVELS;
+			range.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			return range;
+		};
+
+		const auto& vk = _lveDevice->functions();
+		if (vk.cmdPipelineBarrier2 != nullptr) {
+			std::vector<VkImageMemoryBarrier2> imageBarriers;
+			std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+			for (const Barrier& barrier : batch.barriers) {
+				const Resource& resource = _resources[barrier.resource.index];
+				if (resource.isImage) {
+					VkImageMemoryBarrier2 imageBarrier{};
+					imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+					imageBarrier.srcStageMask = barrier.srcStageMask;
+					imageBarrier.srcAccessMask = barrier.srcAccessMask;
+					imageBarrier.dstStageMask = barrier.dstStageMask;
+					imageBarrier.dstAccessMask = barrier.dstAccessMask;
+					imageBarrier.oldLayout = barrier.oldLayout;
+					imageBarrier.newLayout = barrier.newLayout;
+					imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					imageBarrier.image = resource.image;
+					imageBarrier.subresourceRange = subresourceRange(resource);
+					imageBarriers.push_back(imageBarrier);
+				}
+				else {
+					VkBufferMemoryBarrier2 bufferBarrier{};
+					bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+					bufferBarrier.srcStageMask = barrier.srcStageMask;
+					bufferBarrier.srcAccessMask = barrier.srcAccessMask;
+					bufferBarrier.dstStageMask = barrier.dstStageMask;
+					bufferBarrier.dstAccessMask = barrier.dstAccessMask;
+					bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					bufferBarrier.buffer = resource.buffer;
+					bufferBarrier.offset = 0;
+					bufferBarrier.size = VK_WHOLE_SIZE;
+					bufferBarriers.push_back(bufferBarrier);
+				}
+			}
+
+			VkDependencyInfo dependencyInfo{};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+			dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+			dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+			dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+			vk.cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+			return;
+		}
+
+		// without synchronization2 the batch becomes one call with the union of its stages, the
+		// usage table only holds flags that exist in both APIs
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		for (const Barrier& barrier : batch.barriers) {
+			srcStages |= static_cast<VkPipelineStageFlags>(barrier.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(barrier.dstStageMask);
+
+			const Resource& resource = _resources[barrier.resource.index];
+			if (resource.isImage) {
+				VkImageMemoryBarrier imageBarrier{};
+				imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				imageBarrier.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+				imageBarrier.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+				imageBarrier.oldLayout = barrier.oldLayout;
+				imageBarrier.newLayout = barrier.newLayout;
+				imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				imageBarrier.image = resource.image;
+				imageBarrier.subresourceRange = subresourceRange(resource);
+				imageBarriers.push_back(imageBarrier);
+			}
+			else {
+				VkBufferMemoryBarrier bufferBarrier{};
+				bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				bufferBarrier.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+				bufferBarrier.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+				bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				bufferBarrier.buffer = resource.buffer;
+				bufferBarrier.offset = 0;
+				bufferBarrier.size = VK_WHOLE_SIZE;
+				bufferBarriers.push_back(bufferBarrier);
+			}
+		}
+
+		// an empty mask means nothing to wait for or nothing waiting
+		vkCmdPipelineBarrier(commandBuffer,
+			srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	// *************** Self test *********************
+
+	bool runRenderGraphSelfTest(std::ostream& out)
+	{
+		uint32_t failures = 0;
+		auto check = [&](bool condition, const std::string& what) {
+			if (!condition) {
+				out << "  FAILED: " << what << "\n";
+				failures++;
+			}
+		};
+
+		// a stand in for vkGet*MemoryRequirements: tightly packed texels, one memory type
+		auto fakeRequirements = [](const LveRenderGraph& graph, const std::vector<VkDeviceSize>& texelSizes) {
+			return [&graph, texelSizes](LveGraphResource resource) {
+				VkMemoryRequirements requirements{};
+				VkExtent2D extent = graph.getExtent(resource);
+				requirements.size = texelSizes[resource.index] * extent.width * extent.height;
+				requirements.alignment = 256;
+				requirements.memoryTypeBits = 1;
+				return requirements;
+			};
+		};
+
+		auto findBarrier = [](const LveRenderGraph& graph, uint32_t beforePass, LveGraphResource resource)
+			-> const LveRenderGraph::Barrier* {
+			for (const auto& batch : graph.getBarrierBatches()) {
+				if (batch.beforePass != beforePass) continue;
+				for (const auto& barrier : batch.barriers) {
+					if (barrier.resource.index == resource.index) return &barrier;
+				}
+			}
+			return nullptr;
+		};
+
+		auto hasBatch = [](const LveRenderGraph& graph, uint32_t beforePass) {
+			for (const auto& batch : graph.getBarrierBatches()) {
+				if (batch.beforePass == beforePass) return true;
+			}
+			return false;
+		};
+
+		// Deferred frame: G-buffer, lighting, compute bloom, tonemap into a transient, compose into
+		// the swap chain image. The debug view writes nothing the frame uses and is culled.
+		{
+			out << "Render graph self test, deferred frame\n";
+			LveRenderGraph graph;
+			VkExtent2D extent{ 1920, 1080 };
+			auto gColor = graph.createImage("gColor", { extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT });
+			auto gDepth = graph.createImage("gDepth", { extent, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT });
+			auto debug = graph.createImage("debug", { extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT });
+			auto hdr = graph.createImage("hdr", { extent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT });
+			auto bloom = graph.createImage("bloom", { extent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT });
+			auto ldr = graph.createImage("ldr", { extent, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT });
+			auto swapChain = graph.importImage("swapChain", VK_NULL_HANDLE, VK_NULL_HANDLE, extent, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, LveGraphUsage::COLOR_ATTACHMENT);
+
+			graph.addPass("gbuffer")
+				.use(gColor, LveGraphUsage::COLOR_ATTACHMENT)
+				.use(gDepth, LveGraphUsage::DEPTH_ATTACHMENT);
+			graph.addPass("debug")
+				.use(gColor, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(debug, LveGraphUsage::COLOR_ATTACHMENT);
+			graph.addPass("lighting")
+				.use(gColor, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(gDepth, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(hdr, LveGraphUsage::COLOR_ATTACHMENT);
+			graph.addPass("bloom")
+				.use(hdr, LveGraphUsage::SAMPLED_COMPUTE)
+				.use(bloom, LveGraphUsage::STORAGE_WRITE_COMPUTE);
+			graph.addPass("tonemap")
+				.use(hdr, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(bloom, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(ldr, LveGraphUsage::COLOR_ATTACHMENT);
+			graph.addPass("compose")
+				.use(ldr, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(swapChain, LveGraphUsage::COLOR_ATTACHMENT);
+
+			graph.compileWithoutDevice(fakeRequirements(graph, { 4, 4, 4, 8, 8, 4, 4 }));
+			const auto& stats = graph.getStats();
+
+			check(graph.isPassCulled(1), "debug pass is culled");
+			for (uint32_t pass : { 0u, 2u, 3u, 4u, 5u }) {
+				check(!graph.isPassCulled(pass), "pass '" + graph.getPassName(pass) + "' is kept");
+			}
+			check(graph.getMemorySlot(debug) == LveRenderGraph::NO_SLOT, "culled pass's image gets no memory");
+
+			const auto* gColorRead = findBarrier(graph, 2, gColor);
+			check(gColorRead != nullptr && gColorRead->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+				&& gColorRead->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+				&& gColorRead->srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+				&& gColorRead->srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+				"gColor moves to shader read after the G-buffer writes");
+
+			const auto* hdrRead = findBarrier(graph, 3, hdr);
+			check(hdrRead != nullptr && hdrRead->dstStageMask ==
+				(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT),
+				"one hdr barrier covers the bloom and tonemap reads");
+			check(findBarrier(graph, 4, hdr) == nullptr, "no second hdr barrier before tonemap");
+
+			const auto* bloomRead = findBarrier(graph, 4, bloom);
+			check(bloomRead != nullptr && bloomRead->oldLayout == VK_IMAGE_LAYOUT_GENERAL
+				&& bloomRead->srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+				&& bloomRead->srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT,
+				"bloom moves from storage to sampled after the compute writes");
+
+			check(graph.getMemorySlot(bloom) == graph.getMemorySlot(gColor)
+				|| graph.getMemorySlot(bloom) == graph.getMemorySlot(gDepth),
+				"bloom reuses a G-buffer image's memory");
+			check(graph.getMemorySlot(ldr) == graph.getMemorySlot(gColor)
+				|| graph.getMemorySlot(ldr) == graph.getMemorySlot(gDepth),
+				"ldr reuses a G-buffer image's memory");
+			check(graph.getMemorySlot(bloom) != graph.getMemorySlot(ldr), "bloom and ldr are alive together");
+			check(graph.getMemorySlot(hdr) != graph.getMemorySlot(gColor)
+				&& graph.getMemorySlot(hdr) != graph.getMemorySlot(gDepth), "hdr is written while the G-buffer is read");
+			check(stats.memorySlots == 3, "5 transients fit in 3 allocations");
+
+			const auto* bloomAlias = findBarrier(graph, 3, bloom);
+			check(bloomAlias != nullptr && bloomAlias->aliasing && bloomAlias->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
+				&& bloomAlias->srcStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+				"bloom waits for the lighting pass's reads of the memory it takes over");
+
+			const auto* acquire = findBarrier(graph, 5, swapChain);
+			check(acquire != nullptr && acquire->srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+				&& acquire->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				"swap chain image transition chains on the acquire semaphore's stage");
+			const auto* present = findBarrier(graph, LveRenderGraph::BarrierBatch::FINAL_BATCH, swapChain);
+			check(present != nullptr && present->newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+				&& present->dstStageMask == VK_PIPELINE_STAGE_2_NONE, "swap chain image ends in present layout");
+
+			check(!hasBatch(graph, 1), "culled pass gets no barriers");
+			check(stats.batches == 6 && stats.barriers == 12, "6 batches with 12 barriers");
+
+			out << "  " << stats.passes - stats.culledPasses << "/" << stats.passes << " passes, " << stats.barriers
+				<< " barriers in " << stats.batches << " batches, " << stats.transientResources << " transients in "
+				<< stats.memorySlots << " allocations, " << stats.transientBytes / (1024 * 1024) << " MiB instead of "
+				<< stats.unaliasedBytes / (1024 * 1024) << " MiB\n";
+		}
+
+		// GPU-driven frame: clear a counter, cull into an indirect buffer, draw, then update the
+		// object buffer for the next frame. Both transients are alive during the draw.
+		{
+			out << "Render graph self test, GPU-driven frame\n";
+			LveRenderGraph graph;
+			auto counter = graph.createBuffer("counter", 16);
+			auto drawBuffer = graph.createBuffer("drawBuffer", 65536);
+			auto objectBuffer = graph.importBuffer("objectBuffer", VK_NULL_HANDLE, 65536);
+			auto color = graph.importImage("color", VK_NULL_HANDLE, VK_NULL_HANDLE, { 1280, 720 }, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_UNDEFINED, LveGraphUsage::COLOR_ATTACHMENT);
+
+			graph.addPass("clear")
+				.use(counter, LveGraphUsage::TRANSFER_DST);
+			graph.addPass("cull")
+				.use(objectBuffer, LveGraphUsage::STORAGE_READ_COMPUTE)
+				.use(drawBuffer, LveGraphUsage::STORAGE_WRITE_COMPUTE)
+				.use(counter, LveGraphUsage::STORAGE_WRITE_COMPUTE);
+			graph.addPass("draw")
+				.use(drawBuffer, LveGraphUsage::INDIRECT_READ)
+				.use(counter, LveGraphUsage::INDIRECT_READ)
+				.use(objectBuffer, LveGraphUsage::STORAGE_READ_GRAPHICS)
+				.use(color, LveGraphUsage::COLOR_ATTACHMENT);
+			graph.addPass("update")
+				.use(objectBuffer, LveGraphUsage::TRANSFER_DST);
+
+			graph.compileWithoutDevice([](LveGraphResource resource) {
+				VkMemoryRequirements requirements{};
+				requirements.size = resource.index == 0 ? 256 : 65536;
+				requirements.alignment = 256;
+				requirements.memoryTypeBits = 1;
+				return requirements;
+			});
+			const auto& stats = graph.getStats();
+
+			check(stats.culledPasses == 0, "no pass is culled");
+			// the previous execution's indirect draw still reads the counter the clear overwrites
+			const auto* counterClear = findBarrier(graph, 0, counter);
+			check(counterClear != nullptr
+				&& (counterClear->srcStageMask & VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT) != 0
+				&& counterClear->srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT
+				&& counterClear->dstStageMask == VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+				"the counter clear waits for the previous execution's uses");
+
+			const auto* counterWrite = findBarrier(graph, 1, counter);
+			check(counterWrite != nullptr && counterWrite->srcStageMask == VK_PIPELINE_STAGE_2_TRANSFER_BIT
+				&& counterWrite->srcAccessMask == VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				"cull waits for the counter clear");
+			check(findBarrier(graph, 1, objectBuffer) == nullptr, "reading an untouched import needs no barrier");
+
+			const auto* indirect = findBarrier(graph, 2, drawBuffer);
+			check(indirect != nullptr && indirect->srcAccessMask == VK_ACCESS_2_SHADER_WRITE_BIT
+				&& indirect->dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
+				&& indirect->dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+				"draw waits for the culled draw commands");
+			check(findBarrier(graph, 2, objectBuffer) == nullptr, "read after read needs no barrier");
+
+			const auto* colorWrite = findBarrier(graph, 2, color);
+			check(colorWrite != nullptr && colorWrite->oldLayout == colorWrite->newLayout
+				&& colorWrite->srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+				"drawing over the imported image waits for its last write without a transition");
+
+			const auto* update = findBarrier(graph, 3, objectBuffer);
+			check(update != nullptr && update->srcAccessMask == VK_ACCESS_2_NONE
+				&& update->srcStageMask == (VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+					| VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT),
+				"update only waits for the object buffer reads to finish");
+
+			check(graph.getMemorySlot(counter) != graph.getMemorySlot(drawBuffer) && stats.memorySlots == 2,
+				"overlapping transients do not alias");
+			const auto* drawBufferWrite = findBarrier(graph, 1, drawBuffer);
+			check(drawBufferWrite != nullptr && (drawBufferWrite->srcStageMask & VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT) != 0
+				&& drawBufferWrite->dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				"culling waits for the previous execution's indirect draw");
+			check(stats.batches == 4 && stats.barriers == 7, "4 batches with 7 barriers");
+
+			out << "  " << stats.barriers << " barriers in " << stats.batches << " batches, "
+				<< stats.memorySlots << " allocations\n";
+		}
+
+		// An image cannot be in two layouts within one pass.
+		{
+			out << "Render graph self test, conflicting layouts\n";
+			LveRenderGraph graph;
+			auto image = graph.importImage("image", VK_NULL_HANDLE, VK_NULL_HANDLE, { 64, 64 }, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED);
+			graph.addPass("feedback")
+				.use(image, LveGraphUsage::SAMPLED_FRAGMENT)
+				.use(image, LveGraphUsage::COLOR_ATTACHMENT);
+
+			bool threw = false;
+			try {
+				graph.compileWithoutDevice([](LveGraphResource) { return VkMemoryRequirements{}; });
+			}
+			catch (const std::runtime_error&) {
+				threw = true;
+			}
+			check(threw, "compile rejects a pass using an image in two layouts");
+		}
+
+		out << (failures == 0 ? "Render graph self test passed\n" : "Render graph self test failed\n");
+		return failures == 0;
+	}
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "lve_device.h"
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+	// How a pass touches a resource. Each usage maps to fixed stage, access and layout masks,
+	// all from the subset synchronization2 shares with vkCmdPipelineBarrier so batches can be
+	// recorded either way.
+	enum class LveGraphUsage : uint32_t {
+		COLOR_ATTACHMENT,
+		DEPTH_ATTACHMENT,
+		// depth tested but not written
+		DEPTH_READ_ONLY,
+		SAMPLED_FRAGMENT,
+		SAMPLED_COMPUTE,
+		STORAGE_READ_GRAPHICS,
+		STORAGE_READ_COMPUTE,
+		STORAGE_WRITE_COMPUTE,
+		INDIRECT_READ,
+		TRANSFER_SRC,
+		TRANSFER_DST,
+		PRESENT,
+		COUNT
+	};
+
+	struct LveGraphResource {
+		static constexpr uint32_t INVALID = UINT32_MAX;
+		uint32_t index = INVALID;
+		bool isValid() const { return index != INVALID; }
+	};
+
+	// Frame graph. Passes declare every image and buffer they use, compile() then
+	//   - culls passes whose results nothing imported or side-effecting depends on,
+	//   - places transient resources whose pass ranges do not overlap in the same memory,
+	//   - derives one batch of barriers per pass from the declared usages, leaving out
+	//     read-after-read dependencies that an earlier barrier already covers.
+	// The graph is declared once and executed every frame, imported resources may be rebound
+	// between executions. Declare it again with reset() when its shape or extents change.
+	// Every execution shares the transients, the first use of each memory slot waits for the
+	// slot's last use in the execution before, which may still be in flight.
+	class LveRenderGraph {
+	public:
+		using RecordFn = std::function<void(VkCommandBuffer commandBuffer)>;
+		// Memory requirements of a transient resource, replaces the device in compileWithoutDevice.
+		using MemoryRequirementsFn = std::function<VkMemoryRequirements(LveGraphResource resource)>;
+
+		struct ImageDesc {
+			VkExtent2D extent{};
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		};
+
+		struct Barrier {
+			LveGraphResource resource;
+			VkPipelineStageFlags2 srcStageMask;
+			VkAccessFlags2 srcAccessMask;
+			VkPipelineStageFlags2 dstStageMask;
+			VkAccessFlags2 dstAccessMask;
+			// both UNDEFINED for buffers
+			VkImageLayout oldLayout;
+			VkImageLayout newLayout;
+			// first use of memory another transient used before
+			bool aliasing;
+		};
+
+		// Recorded before the pass, FINAL_BATCH after the last one
+		struct BarrierBatch {
+			static constexpr uint32_t FINAL_BATCH = UINT32_MAX;
+			uint32_t beforePass;
+			std::vector<Barrier> barriers;
+		};
+
+		struct Stats {
+			uint32_t passes = 0;
+			uint32_t culledPasses = 0;
+			uint32_t barriers = 0;
+			uint32_t batches = 0;
+			uint32_t transientResources = 0;
+			uint32_t memorySlots = 0;
+			// transient memory with and without aliasing
+			VkDeviceSize transientBytes = 0;
+			VkDeviceSize unaliasedBytes = 0;
+		};
+
+		class PassBuilder {
+		public:
+			PassBuilder& use(LveGraphResource resource, LveGraphUsage usage);
+			// keeps the pass even when no kept pass or import depends on it
+			PassBuilder& sideEffects();
+			PassBuilder& record(RecordFn recordFn);
+
+		private:
+			friend class LveRenderGraph;
+			PassBuilder(LveRenderGraph& graph, uint32_t pass) : _graph{ graph }, _pass{ pass } {}
+
+			LveRenderGraph& _graph;
+			uint32_t _pass;
+		};
+
+		LveRenderGraph() = default;
+		~LveRenderGraph();
+
+		LveRenderGraph(const LveRenderGraph&) = delete;
+		LveRenderGraph& operator=(const LveRenderGraph&) = delete;
+
+		// Destroys the transient resources and forgets every pass and resource. The GPU must be
+		// done with the last execution.
+		void reset();
+
+		// An image owned elsewhere, in currentLayout when the graph executes and left in finalLayout,
+		// or in whatever its last use needs when finalLayout is UNDEFINED. lastUsage is how the
+		// work before the graph last touched it, so the first barrier waits for it.
+		LveGraphResource importImage(const std::string& name, VkImage image, VkImageView view, VkExtent2D extent,
+			VkImageAspectFlags aspect, VkImageLayout currentLayout, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			LveGraphUsage lastUsage = LveGraphUsage::COUNT);
+		LveGraphResource importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size,
+			LveGraphUsage lastUsage = LveGraphUsage::COUNT);
+		// Contents are undefined at the first use.
+		LveGraphResource createImage(const std::string& name, const ImageDesc& desc);
+		LveGraphResource createBuffer(const std::string& name, VkDeviceSize size);
+
+		// Swaps the handles of an import, e.g. to the swap chain image of the next frame.
+		void setImportedImage(LveGraphResource resource, VkImage image, VkImageView view);
+		void setImportedBuffer(LveGraphResource resource, VkBuffer buffer);
+
+		// Passes execute in the order they are added.
+		PassBuilder addPass(const std::string& name);
+
+		// Plans the graph and creates the transient resources in device local memory.
+		void compile(LveDevice& device);
+		// Only plans, for tests and tools without a device. execute() is not available afterwards.
+		void compileWithoutDevice(const MemoryRequirementsFn& requirementsOf);
+
+		// Records every kept pass with its barriers in front of it.
+		void execute(VkCommandBuffer commandBuffer);
+
+		VkImage getImage(LveGraphResource resource) const;
+		VkImageView getImageView(LveGraphResource resource) const;
+		VkBuffer getBuffer(LveGraphResource resource) const;
+		VkExtent2D getExtent(LveGraphResource resource) const;
+
+		// Planning results, valid after compile
+		bool isPassCulled(uint32_t pass) const { return !_passes[pass].kept; }
+		const std::vector<BarrierBatch>& getBarrierBatches() const { return _batches; }
+		// transients with the same slot share memory
+		uint32_t getMemorySlot(LveGraphResource resource) const { return _resources[resource.index].memorySlot; }
+		const std::string& getName(LveGraphResource resource) const { return _resources[resource.index].name; }
+		const std::string& getPassName(uint32_t pass) const { return _passes[pass].name; }
+		const Stats& getStats() const { return _stats; }
+
+		static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+	private:
+		struct Use {
+			uint32_t resource;
+			LveGraphUsage usage;
+		};
+
+		struct Pass {
+			std::string name;
+			std::vector<Use> uses;
+			RecordFn recordFn;
+			bool sideEffects = false;
+			bool kept = false;
+		};
+
+		struct Resource {
+			std::string name;
+			bool isImage;
+			bool imported;
+			ImageDesc imageDesc;
+			VkDeviceSize size = 0;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			LveGraphUsage lastUsage = LveGraphUsage::COUNT;
+
+			// kept passes using it, NO_PASS when none does
+			uint32_t firstPass;
+			uint32_t lastPass;
+			VkImageUsageFlags imageUsage = 0;
+			VkBufferUsageFlags bufferUsage = 0;
+			uint32_t memorySlot = NO_SLOT;
+			// transient that used the slot before this one
+			uint32_t aliasOf = LveGraphResource::INVALID;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+		};
+
+		struct MemorySlot {
+			VkDeviceSize size;
+			VkDeviceSize alignment;
+			uint32_t memoryTypeBits;
+			uint32_t lastPass;
+			uint32_t lastResource;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+		};
+
+		static constexpr uint32_t NO_PASS = UINT32_MAX;
+
+		LveGraphResource addResource(Resource resource);
+		void cullPasses();
+		void computeLifetimes();
+		void assignMemory(const MemoryRequirementsFn& requirementsOf);
+		void buildBarriers();
+		void createTransients();
+		void allocateMemory();
+		void recordBatch(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+		void destroyTransients();
+
+		LveDevice* _lveDevice = nullptr;
+		std::vector<Pass> _passes;
+		std::vector<Resource> _resources;
+		std::vector<MemorySlot> _slots;
+		std::vector<BarrierBatch> _batches;
+		bool _compiled = false;
+		Stats _stats;
+	};
+
+	// Compiles sample graphs without a device and checks culling, barrier placement and aliasing.
+	// Returns false and reports the failed checks when one does not hold.
+	bool runRenderGraphSelfTest(std::ostream& out);
+}
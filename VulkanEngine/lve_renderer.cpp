@@ -1,20 +1,59 @@
 #include "lve_renderer.h"
+#include "lve_cpu_profiler.h"
 
 #include <array>
 #include <cassert>
+#include <iostream>
 #include <stdexcept>
 
 namespace lve {
 
-	LveRenderer::LveRenderer(LveWindow& window, LveDevice& device) 
-		: _lveWindow{ window }, _lveDevice { device } 
+	namespace {
+		VkImageMemoryBarrier imageBarrier(VkImage image, VkImageAspectFlags aspect,
+			VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+		{
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+			return barrier;
+		}
+
+		// layout transitions of combined formats must name both aspects
+		VkImageAspectFlags depthAspect(VkFormat format) {
+			bool hasStencil = format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+			return hasStencil ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+		}
+	}
+
+	LveRenderer::LveRenderer(LveWindow& window, LveDevice& device, bool allowDynamicRendering,
+		const LveFramePacing& pacing)
+		: _lveWindow{ window }, _lveDevice { device },
+		_useDynamicRendering{ allowDynamicRendering && device.features().dynamicRendering },
+		_framePacing{ pacing }
 	{
+		assert(pacing.framesInFlight >= 1 && pacing.framesInFlight <= LveSwapChain::MAX_FRAMES_IN_FLIGHT
+			&& "Frames in flight out of range.");
 		recreateSwapChain();
+		if (!_useDynamicRendering) {
+			_pipelineRenderPass = _lveSwapChain->createCompatibleRenderPass();
+		}
 		createCommandBuffers();
+		std::cout << "Rendering: " << (_useDynamicRendering ? "dynamic rendering" : "render passes") << std::endl;
+		std::cout << "Frame pacing: " << _framePacing.framesInFlight << " frames in flight, low latency "
+			<< (_framePacing.lowLatency ? "on" : "off") << std::endl;
 	}
 
 	LveRenderer::~LveRenderer() {
 		freeCommandBuffers();
+		vkDestroyQueryPool(_lveDevice.device(), _timestampPool, nullptr);
+		vkDestroyRenderPass(_lveDevice.device(), _pipelineRenderPass, nullptr);
 	}
 
 	void LveRenderer::createCommandBuffers() {
@@ -40,6 +79,7 @@ namespace lve {
 	}
 
 	void LveRenderer::recreateSwapChain() {
+		LVE_PROFILE_ZONE("recreate swap chain");
 		auto extent = _lveWindow.getExtent();
 		while (extent.width == 0 || extent.height == 0) {
 			extent = _lveWindow.getExtent();
@@ -49,22 +89,215 @@ namespace lve {
 		vkDeviceWaitIdle(_lveDevice.device());
 
 		if (_lveSwapChain == nullptr) {
-			_lveSwapChain = std::make_unique<LveSwapChain>(_lveDevice, extent);
+			_lveSwapChain = std::make_unique<LveSwapChain>(_lveDevice, extent, _useDynamicRendering,
+				_framePacing.framesInFlight, _framePacing.presentMode);
 		}
 		else {
 			std::shared_ptr<LveSwapChain> oldSwapChain = std::move(_lveSwapChain);
-			_lveSwapChain = std::make_unique<LveSwapChain>(_lveDevice, extent, oldSwapChain);
+			_lveSwapChain = std::make_unique<LveSwapChain>(_lveDevice, extent, oldSwapChain,
+				_framePacing.framesInFlight, _framePacing.presentMode);
 
 			if (!oldSwapChain->compareSwapFormats(*_lveSwapChain.get())) {
 				throw std::runtime_error("Swap chain image format has chainged");
 			}
 		}
+		if (_scaledTarget) {
+			// the device is idle, nothing uses the old images
+			_scaledTarget = std::make_unique<LveScaledRenderTarget>(_lveDevice, _lveSwapChain->getSwapChainExtent(),
+				_resolutionController->getSettings().maxScale, _lveSwapChain->getSwapChainImageFormat(),
+				_lveSwapChain->getSwapChainDepthFormat(), _lveSwapChain->getPresentLayout());
+			_renderExtent = _scaledTarget->scaledExtent(_resolutionController->getScale());
+		}
+		_swapchainGeneration++;
+	}
+
+	void LveRenderer::setFramePacing(const LveFramePacing& pacing)
+	{
+		assert(!isFrameStarted && !_imageAcquired && "Can't change frame pacing while a frame is in progress.");
+		assert(pacing.framesInFlight >= 1 && pacing.framesInFlight <= LveSwapChain::MAX_FRAMES_IN_FLIGHT
+			&& "Frames in flight out of range.");
+
+		_framePacing = pacing;
+		// the new swap chain's fences start over at frame 0, the device is idle once it exists
+		recreateSwapChain();
+		currentFrameIndex = 0;
+		_inputSampled = false;
+		std::cout << "Frame pacing: " << _framePacing.framesInFlight << " frames in flight, low latency "
+			<< (_framePacing.lowLatency ? "on" : "off") << std::endl;
+	}
+
+	void LveRenderer::waitToSampleInput()
+	{
+		assert(!isFrameStarted && "Can't wait to sample input while a frame is in progress.");
+		LVE_PROFILE_ZONE("LveRenderer::waitToSampleInput");
+		if (_framePacing.lowLatency && !_imageAcquired) {
+			_lveSwapChain->waitForSubmittedFrames();
+			VkResult result = _lveSwapChain->acquireNextImage(&currentImageIndex);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				// beginFrame acquires from the new swap chain
+				recreateSwapChain();
+			}
+			else {
+				_acquireResult = result;
+				_imageAcquired = true;
+			}
+		}
+		_inputSampleTime = std::chrono::steady_clock::now();
+		_inputSampled = true;
+	}
+
+	void LveRenderer::finishAcquiredFrame()
+	{
+		assert(!isFrameStarted && "Can't finish the acquired frame while a frame is in progress.");
+		if (!_imageAcquired) return;
+
+		// the render pass clears the image and leaves it ready to present
+		if (auto commandBuffer = beginFrame()) {
+			beginSwapchainRenderpass(commandBuffer);
+			endSwapchainRenderpass(commandBuffer);
+			endFrame();
+		}
+	}
+
+	bool LveRenderer::enableDynamicResolution(const LveResolutionController::Settings& settings)
+	{
+		assert(!isFrameStarted && "Can't enable dynamic resolution while a frame is in progress.");
+
+		const char* missing = nullptr;
+		if (!_useDynamicRendering) {
+			missing = "it needs dynamic rendering";
+		}
+		else if (!_lveDevice.properties.limits.timestampComputeAndGraphics) {
+			missing = "the graphics queue cannot write timestamps";
+		}
+		else if (!_lveSwapChain->supportsTransferDst()
+			|| !LveScaledRenderTarget::isSupported(_lveDevice, _lveSwapChain->getSwapChainImageFormat()))
+		{
+			missing = "the swap chain images cannot be blitted to";
+		}
+		if (missing != nullptr) {
+			std::cerr << "Dynamic resolution disabled: " << missing << std::endl;
+			return false;
+		}
+
+		_resolutionController = std::make_unique<LveResolutionController>(settings);
+		createTimestampPool();
+		_scaledTarget = std::make_unique<LveScaledRenderTarget>(_lveDevice, _lveSwapChain->getSwapChainExtent(),
+			settings.maxScale, _lveSwapChain->getSwapChainImageFormat(), _lveSwapChain->getSwapChainDepthFormat(),
+			_lveSwapChain->getPresentLayout());
+		_renderExtent = _scaledTarget->scaledExtent(_resolutionController->getScale());
+
+		std::cout << "Dynamic resolution: scale " << settings.minScale << " to " << settings.maxScale
+			<< ", " << settings.budgetMilliseconds << " ms GPU budget" << std::endl;
+		return true;
+	}
+
+	bool LveRenderer::enableGpuTiming()
+	{
+		assert(!isFrameStarted && "Can't enable GPU timing while a frame is in progress.");
+
+		if (!_lveDevice.properties.limits.timestampComputeAndGraphics) {
+			std::cerr << "GPU timing disabled: the graphics queue cannot write timestamps" << std::endl;
+			return false;
+		}
+		createTimestampPool();
+		return true;
+	}
+
+	bool LveRenderer::enableGpuProfiler(bool pipelineStatistics)
+	{
+		assert(!isFrameStarted && "Can't enable the GPU profiler while a frame is in progress.");
+
+		if (!LveGpuProfiler::isSupported(_lveDevice)) {
+			std::cerr << "GPU profiler disabled: the graphics queue cannot write timestamps" << std::endl;
+			return false;
+		}
+		if (pipelineStatistics && !_lveDevice.features().pipelineStatisticsQuery) {
+			std::cerr << "GPU profiler: pipeline statistics queries are not supported" << std::endl;
+		}
+		_gpuProfiler = std::make_unique<LveGpuProfiler>(_lveDevice, pipelineStatistics);
+		return true;
+	}
+
+	float LveRenderer::getResolutionScale() const
+	{
+		return _resolutionController ? _resolutionController->getScale() : 1.0f;
+	}
+
+	VkExtent2D LveRenderer::getRenderExtent() const
+	{
+		return _scaledTarget ? _renderExtent : _lveSwapChain->getSwapChainExtent();
+	}
+
+	std::vector<LveResolutionController::Decision> LveRenderer::takeResolutionDecisions()
+	{
+		if (!_resolutionController) {
+			return {};
+		}
+		return _resolutionController->takeDecisions();
+	}
+
+	void LveRenderer::createTimestampPool()
+	{
+		if (_timestampPool != VK_NULL_HANDLE) {
+			return;
+		}
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = 2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateQueryPool(_lveDevice.device(), &poolInfo, nullptr, &_timestampPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool.");
+		}
+		_timestampsWritten.assign(LveSwapChain::MAX_FRAMES_IN_FLIGHT, false);
+	}
+
+	void LveRenderer::readFrameTimestamps()
+	{
+		if (!_timestampsWritten[currentFrameIndex]) {
+			return;
+		}
+
+		// the frame's fence has signalled, so the results are normally available and waiting is not needed
+		std::array<uint64_t, 2> timestamps{};
+		VkResult result = vkGetQueryPoolResults(_lveDevice.device(), _timestampPool, 2 * currentFrameIndex, 2,
+			sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		_timestampsWritten[currentFrameIndex] = false;
+		if (result != VK_SUCCESS || timestamps[1] <= timestamps[0]) {
+			return;
+		}
+
+		double nanoseconds = static_cast<double>(timestamps[1] - timestamps[0])
+			* static_cast<double>(_lveDevice.properties.limits.timestampPeriod);
+		_gpuFrameMilliseconds = static_cast<float>(nanoseconds / 1000000.0);
+		_gpuFrameSamples++;
+		if (_resolutionController && _resolutionController->update(_gpuFrameMilliseconds)) {
+			_renderExtent = _scaledTarget->scaledExtent(_resolutionController->getScale());
+		}
+	}
+
+	LvePipelineTarget LveRenderer::getPipelineTarget() const
+	{
+		LvePipelineTarget target{};
+		target.renderPass = _pipelineRenderPass;
+		target.colorFormat = _lveSwapChain->getSwapChainImageFormat();
+		target.depthFormat = _lveSwapChain->getSwapChainDepthFormat();
+		return target;
 	}
 
 	VkCommandBuffer LveRenderer::beginFrame() 
 	{
 		assert(!isFrameStarted && "Can't call begin frame while already in progress.");
-		auto result = _lveSwapChain->acquireNextImage(&currentImageIndex);
+		LVE_PROFILE_ZONE("LveRenderer::beginFrame");
+		VkResult result = _acquireResult;
+		if (_imageAcquired) {
+			_imageAcquired = false;
+		}
+		else {
+			result = _lveSwapChain->acquireNextImage(&currentImageIndex);
+		}
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
 			recreateSwapChain();
 			return nullptr;
@@ -75,6 +308,10 @@ namespace lve {
 		}
 
 		isFrameStarted = true;
+		if (_timestampPool != VK_NULL_HANDLE) {
+			// the scale settles here, before anything is recorded at the frame's render extent
+			readFrameTimestamps();
+		}
 
 		auto commandBuffer = getCurrentCommandBuffer();
 
@@ -85,19 +322,45 @@ namespace lve {
 			throw std::runtime_error("Failed to begin recording command buffer!");
 		}
 
+		if (_timestampPool != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(commandBuffer, _timestampPool, 2 * currentFrameIndex, 2);
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _timestampPool, 2 * currentFrameIndex);
+		}
+		if (_gpuProfiler) {
+			_gpuProfiler->beginFrame(commandBuffer, currentFrameIndex);
+		}
+
 		return commandBuffer;
 	}
 	void LveRenderer::endFrame()
 	{
 		assert(isFrameStarted && "Can't call end frame while frame not in progress.");
+		LVE_PROFILE_ZONE("LveRenderer::endFrame");
 
 		auto commandBuffer = getCurrentCommandBuffer();
 
+		if (_scaledTarget) {
+			LveGpuScope upscaleScope{ _gpuProfiler.get(), commandBuffer, "upscale" };
+			_scaledTarget->upscale(commandBuffer, currentFrameIndex, _renderExtent,
+				_lveSwapChain->getImage(currentImageIndex), _lveSwapChain->getImageView(currentImageIndex));
+		}
+		if (_timestampPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _timestampPool,
+				2 * currentFrameIndex + 1);
+			_timestampsWritten[currentFrameIndex] = true;
+		}
+
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffers.");
 		}
 
 		auto result = _lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+		if (_inputSampled) {
+			_inputToPresentMilliseconds = std::chrono::duration<double, std::chrono::milliseconds::period>(
+				std::chrono::steady_clock::now() - _inputSampleTime).count();
+			_inputLatencySamples++;
+			_inputSampled = false;
+		}
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
 			_lveWindow.wasWindowResized())
 		{
@@ -109,39 +372,47 @@ namespace lve {
 		}
 
 		isFrameStarted = false;	
-		currentFrameIndex = (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+		currentFrameIndex = (currentFrameIndex + 1) % _framePacing.framesInFlight;
 	}
 
-	void LveRenderer::beginSwapchainRenderpass(VkCommandBuffer commandBuffer)
+	void LveRenderer::beginSwapchainRenderpass(VkCommandBuffer commandBuffer, VkSubpassContents contents,
+		LveSwapChain::RenderPassType type)
 	{
 		assert(isFrameStarted && "Can't call beginSwapchainRenderpass while frame not in progress.");
 		assert(commandBuffer == getCurrentCommandBuffer()
 			&& "Can't begin render pass on command buffer from a different frame.");
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = _lveSwapChain->getRenderPass();
-		renderPassInfo.framebuffer = _lveSwapChain->getFrameBuffer(currentImageIndex);
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = _lveSwapChain->getSwapChainExtent();
-
+		_activePassType = type;
+		if (_lveSwapChain->usesDynamicRendering()) {
+			beginDynamicRendering(commandBuffer, contents, type);
+		}
+		else {
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = _lveSwapChain->getRenderPass(type);
+			renderPassInfo.framebuffer = _lveSwapChain->getFrameBuffer(currentImageIndex);
+			renderPassInfo.renderArea.offset = { 0, 0 };
+			renderPassInfo.renderArea.extent = _lveSwapChain->getSwapChainExtent();
 
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
+			std::array<VkClearValue, 2> clearValues{};
+			clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+		}
+		if (contents != VK_SUBPASS_CONTENTS_INLINE) return;
 
+		VkExtent2D extent = getRenderExtent();
 		VkViewport viewport;
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(_lveSwapChain->getSwapChainExtent().width);
-		viewport.height = static_cast<float>(_lveSwapChain->getSwapChainExtent().height);
+		viewport.width = static_cast<float>(extent.width);
+		viewport.height = static_cast<float>(extent.height);
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{ {0, 0}, _lveSwapChain->getSwapChainExtent() };
+		VkRect2D scissor{ {0, 0}, extent };
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 	}
@@ -152,6 +423,119 @@ namespace lve {
 		assert(commandBuffer == getCurrentCommandBuffer()
 			&& "Can't end render pass on command buffer from a different frame.");
 
-		vkCmdEndRenderPass(commandBuffer);
+		if (_lveSwapChain->usesDynamicRendering()) {
+			endDynamicRendering(commandBuffer);
+		}
+		else {
+			vkCmdEndRenderPass(commandBuffer);
+		}
+	}
+
+	void LveRenderer::beginDynamicRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents,
+		LveSwapChain::RenderPassType type)
+	{
+		assert((!_scaledTarget || type == LveSwapChain::RENDER_PASS_MAIN)
+			&& "Only the main pass renders into the scaled render target.");
+		VkImage colorImage = _scaledTarget ? _scaledTarget->getColorImage(currentFrameIndex)
+			: _lveSwapChain->getImage(currentImageIndex);
+		VkImage depthImage = _scaledTarget ? _scaledTarget->getDepthImage(currentFrameIndex)
+			: _lveSwapChain->getDepthImage(currentImageIndex);
+		VkImageAspectFlags aspect = depthAspect(_lveSwapChain->getSwapChainDepthFormat());
+		bool late = type == LveSwapChain::RENDER_PASS_LATE;
+
+		// the transitions and external dependencies of the matching render pass, see createRenderPass
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		VkPipelineStageFlags srcStages =
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		VkPipelineStageFlags dstStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		if (late) {
+			// loads what the early pass wrote, once the pyramid build is done reading depth
+			srcStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			barriers[0] = imageBarrier(colorImage, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+			barriers[1] = imageBarrier(depthImage, aspect,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+		}
+		else {
+			// the previous contents are discarded, only the last frame's use of the images must be done
+			if (type == LveSwapChain::RENDER_PASS_EARLY) {
+				srcStages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			}
+			barriers[0] = imageBarrier(colorImage, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+				0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+			barriers[1] = imageBarrier(depthImage, aspect,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+				0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+		}
+		vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr,
+			static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = _scaledTarget ? _scaledTarget->getColorImageView(currentFrameIndex)
+			: _lveSwapChain->getImageView(currentImageIndex);
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue.color = { 0.01f, 0.01f, 0.01f, 1.0f };
+
+		VkRenderingAttachmentInfoKHR depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		depthAttachment.imageView = _scaledTarget ? _scaledTarget->getDepthImageView(currentFrameIndex)
+			: _lveSwapChain->getDepthImageView(currentImageIndex);
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = type == LveSwapChain::RENDER_PASS_EARLY
+			? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.flags = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+			? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0;
+		renderingInfo.renderArea = { { 0, 0 }, getRenderExtent() };
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		_lveDevice.functions().cmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	void LveRenderer::endDynamicRendering(VkCommandBuffer commandBuffer)
+	{
+		_lveDevice.functions().cmdEndRendering(commandBuffer);
+
+		if (_activePassType == LveSwapChain::RENDER_PASS_EARLY) {
+			// depth goes to the compute shader that builds the depth pyramid, color stays for the late pass
+			VkImageMemoryBarrier depthBarrier = imageBarrier(_lveSwapChain->getDepthImage(currentImageIndex),
+				depthAspect(_lveSwapChain->getSwapChainDepthFormat()),
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			vkCmdPipelineBarrier(commandBuffer,
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+			return;
+		}
+		if (_scaledTarget) {
+			// the upscale in endFrame transitions both images
+			return;
+		}
+
+		// presentation waits on the render finished semaphore, nothing later in the queue reads it
+		VkImageMemoryBarrier presentBarrier = imageBarrier(_lveSwapChain->getImage(currentImageIndex),
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, _lveSwapChain->getPresentLayout(),
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0);
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &presentBarrier);
 	}
 }
\ No newline at end of file
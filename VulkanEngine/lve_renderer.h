@@ -1,53 +1,178 @@
 #pragma once
 
 #include "lve_device.h"
+#include "lve_dynamic_resolution.h"
+#include "lve_gpu_profiler.h"
+#include "lve_pipeline.h"
 #include "lve_swap_chain.h"
 #include "lve_window.h"
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <cassert>
 
 namespace lve {
+	// How far the CPU may run ahead of the display. More frames in flight and mailbox or immediate
+	// presents keep the GPU busy, fewer frames, FIFO and lowLatency keep the input fresh.
+	struct LveFramePacing {
+		// 1 to LveSwapChain::MAX_FRAMES_IN_FLIGHT
+		int framesInFlight = LveSwapChain::DEFAULT_FRAMES_IN_FLIGHT;
+		// taken when the surface supports it, FIFO otherwise
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+		// waitToSampleInput waits for the GPU to drain and acquires the next image before returning
+		bool lowLatency = false;
+	};
+
 	class LveRenderer {
 	public:
-		LveRenderer(LveWindow& window, LveDevice& device);
+		// Renders with VK_KHR_dynamic_rendering when allowed and supported, with the swap chain's
+		// render passes and framebuffers otherwise.
+		LveRenderer(LveWindow& window, LveDevice& device, bool allowDynamicRendering = true,
+			const LveFramePacing& pacing = {});
 		~LveRenderer();
 
 		LveRenderer(const LveRenderer&) = delete;
 		LveRenderer& operator=(const LveRenderer&) = delete;
 
 
-		VkRenderPass getSwapchainRenderpass() const { return _lveSwapChain->getRenderPass(); }
+		// The render pass is the renderer's own copy of the main pass, compatible with every pass
+		// type and alive until the renderer goes, so pipelines can be created against it after the
+		// swap chain was recreated.
+		LvePipelineTarget getPipelineTarget() const;
+		bool usesDynamicRendering() const { return _lveSwapChain->usesDynamicRendering(); }
 		float getAspectRatio() const { return _lveSwapChain->extentAspectRatio(); }
+		VkExtent2D getSwapchainExtent() const { return _lveSwapChain->getSwapChainExtent(); }
+		size_t getSwapchainImageCount() const { return _lveSwapChain->imageCount(); }
+		VkImageView getDepthImageView(int imageIndex) const { return _lveSwapChain->getDepthImageView(imageIndex); }
+		bool isDepthSampleable() const { return _lveSwapChain->isDepthSampleable(); }
+		// Changes whenever the swap chain is recreated, images and views from before are gone.
+		uint32_t getSwapchainGeneration() const { return _swapchainGeneration; }
 		bool isFrameInProgress() const { return isFrameStarted; }
 
+		// Recreates the swap chain with the new frame count and present mode once the device is
+		// idle. Frame indices restart at 0 and stay below pacing.framesInFlight. Call outside a frame.
+		void setFramePacing(const LveFramePacing& pacing);
+		const LveFramePacing& getFramePacing() const { return _framePacing; }
+		// the mode the swap chain got, FIFO when the requested one is unsupported
+		VkPresentModeKHR getPresentMode() const { return _lveSwapChain->getPresentMode(); }
+
+		// Call right before sampling input for the next frame. With lowLatency it first waits until
+		// the GPU has finished every submitted frame and the next image is acquired, so nothing
+		// queued ahead delays the frame that shows the input; otherwise it only notes the time.
+		void waitToSampleInput();
+		// Presents an empty frame on the image waitToSampleInput acquired when the loop ends before
+		// beginFrame takes it, so its semaphore is waited on and the image goes back to the swap
+		// chain. Call after the last frame, before waiting for the device to go idle.
+		void finishAcquiredFrame();
+		// From waitToSampleInput to vkQueuePresentKHR returning for the last frame, 0 before the
+		// first. Time the presentation engine holds the image before scan out is not included.
+		double getInputToPresentMilliseconds() const { return _inputToPresentMilliseconds; }
+		// Frames measured so far, a change means getInputToPresentMilliseconds has a new value
+		uint64_t getInputLatencySampleCount() const { return _inputLatencySamples; }
+
+		// Renders the scene into a scaled target whose scale follows the measured GPU frame time and
+		// blits it onto the swap chain image in endFrame. Needs dynamic rendering, timestamps on the
+		// graphics queue and swap chain images that can be blitted to, returns false and keeps
+		// rendering at full resolution without them. Only RENDER_PASS_MAIN renders into the target,
+		// the occlusion culling passes read the swap chain depth images. Call outside a frame.
+		bool enableDynamicResolution(const LveResolutionController::Settings& settings);
+		bool usesDynamicResolution() const { return _scaledTarget != nullptr; }
+		// 1 without dynamic resolution
+		float getResolutionScale() const;
+		// What the scene renders at this frame, the swap chain extent without dynamic resolution.
+		// Anything working in framebuffer coordinates must use it instead of the swap chain extent.
+		VkExtent2D getRenderExtent() const;
+		// Brackets every frame's command buffer with timestamps, which dynamic resolution turns on as
+		// well. Returns false when the graphics queue cannot write timestamps. Call outside a frame.
+		bool enableGpuTiming();
+		// GPU time of the last measured frame, 0 before the first measurement. A frame is measured
+		// when its slot comes around again, framesInFlight frames later.
+		float getGpuFrameMilliseconds() const { return _gpuFrameMilliseconds; }
+		// Frames measured so far, a change means getGpuFrameMilliseconds has a new value
+		uint64_t getGpuFrameSampleCount() const { return _gpuFrameSamples; }
+
+		// Creates a profiler whose frames begin with the renderer's, scopes recorded into the frame's
+		// command buffer are timed from then on. Returns false when the graphics queue cannot write
+		// timestamps. Call outside a frame.
+		bool enableGpuProfiler(bool pipelineStatistics);
+		// null unless enabled
+		LveGpuProfiler* getGpuProfiler() const { return _gpuProfiler.get(); }
+		const LveResolutionController* getResolutionController() const { return _resolutionController.get(); }
+		// Scale changes since the last call, oldest first, for logging.
+		std::vector<LveResolutionController::Decision> takeResolutionDecisions();
+
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame not in progress.");
 			return _commandBuffers[currentFrameIndex];
 		}
 
+		// VK_NULL_HANDLE with dynamic rendering
+		VkFramebuffer getCurrentFramebuffer() const {
+			assert(isFrameStarted && "Cannot get framebuffer when frame not in progress.");
+			return usesDynamicRendering() ? VK_NULL_HANDLE : _lveSwapChain->getFrameBuffer(currentImageIndex);
+		}
+
 		int getFrameIndex() const {
 			assert(isFrameStarted && "Cannot get frame index when frame not in progress.");
 			return currentFrameIndex;
 		}
 
+		uint32_t getImageIndex() const {
+			assert(isFrameStarted && "Cannot get image index when frame not in progress.");
+			return currentImageIndex;
+		}
+
 		VkCommandBuffer beginFrame();
 		void endFrame();
 
-		void beginSwapchainRenderpass(VkCommandBuffer commandBuffer);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass may only execute secondaries,
+		// which set their own viewport and scissor. The late occlusion pass must follow the early one
+		// within the same frame. With dynamic rendering the type selects the same load and store ops
+		// and image transitions the render passes declare.
+		void beginSwapchainRenderpass(VkCommandBuffer commandBuffer,
+			VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE,
+			LveSwapChain::RenderPassType type = LveSwapChain::RENDER_PASS_MAIN);
 		void endSwapchainRenderpass(VkCommandBuffer commandBuffer);
 		
 	private:
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
+		void beginDynamicRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents,
+			LveSwapChain::RenderPassType type);
+		void endDynamicRendering(VkCommandBuffer commandBuffer);
+		void createTimestampPool();
+		void readFrameTimestamps();
 
 		LveWindow& _lveWindow;
 		LveDevice& _lveDevice;
 		std::unique_ptr <LveSwapChain> _lveSwapChain;
+		// null with dynamic rendering
+		VkRenderPass _pipelineRenderPass = VK_NULL_HANDLE;
 		std::vector<VkCommandBuffer> _commandBuffers;
+		bool _useDynamicRendering;
+		LveFramePacing _framePacing;
+		// waitToSampleInput acquired the frame's image ahead of beginFrame, which takes this result
+		bool _imageAcquired = false;
+		VkResult _acquireResult = VK_SUCCESS;
+		bool _inputSampled = false;
+		std::chrono::steady_clock::time_point _inputSampleTime{};
+		double _inputToPresentMilliseconds = 0.0;
+		uint64_t _inputLatencySamples = 0;
+		LveSwapChain::RenderPassType _activePassType{ LveSwapChain::RENDER_PASS_MAIN };
+
+		std::unique_ptr<LveResolutionController> _resolutionController;
+		std::unique_ptr<LveScaledRenderTarget> _scaledTarget;
+		VkExtent2D _renderExtent{};
+		// queries 2 * frame index and the one after bracket the frame's command buffer
+		VkQueryPool _timestampPool = VK_NULL_HANDLE;
+		std::vector<bool> _timestampsWritten;
+		float _gpuFrameMilliseconds = 0.0f;
+		uint64_t _gpuFrameSamples = 0;
+		std::unique_ptr<LveGpuProfiler> _gpuProfiler;
 
+		uint32_t _swapchainGeneration{ 0 };
 		uint32_t currentImageIndex{ 0 };
 		uint32_t currentFrameIndex{ 0 };
 		bool isFrameStarted{ false };
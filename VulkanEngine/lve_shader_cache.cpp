@@ -0,0 +1,119 @@
+#include "lve_shader_cache.h"
+
+#include "lve_mapped_file.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace lve {
+
+	// *************** Shader Module *********************
+
+	LveShaderModule::LveShaderModule(
+		LveDevice& device, const uint32_t* code, size_t codeSize, uint64_t contentHash)
+		: _lveDevice{ device }, _contentHash{ contentHash }, _code(code, code + codeSize / sizeof(uint32_t))
+	{
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = codeSize;
+		createInfo.pCode = code;
+
+		if (vkCreateShaderModule(_lveDevice.device(), &createInfo, nullptr, &_shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module.");
+		}
+	}
+
+	LveShaderModule::~LveShaderModule() {
+		vkDestroyShaderModule(_lveDevice.device(), _shaderModule, nullptr);
+	}
+
+	bool LveShaderModule::hasCode(const char* code, size_t codeSize) const {
+		return codeSize == getCodeSize() && std::memcmp(code, _code.data(), codeSize) == 0;
+	}
+
+	// *************** Shader Module Cache *********************
+
+	// 64 bit FNV-1a, SPIR-V blobs are small enough that this never shows up next to module creation
+	uint64_t LveShaderModuleCache::hashContent(const char* data, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::shared_ptr<LveShaderModule> LveShaderModuleCache::acquire(const std::string& filepath) {
+		std::error_code error;
+		auto writeTime = std::filesystem::last_write_time(filepath, error);
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			auto pathIt = _modulesByPath.find(filepath);
+			if (!error && pathIt != _modulesByPath.end() && pathIt->second.writeTime == writeTime) {
+				if (auto module = pathIt->second.module.lock()) {
+					_stats.pathHits++;
+					return module;
+				}
+			}
+		}
+
+		// map and hash outside the lock so workers compiling different pipelines do not serialize on I/O
+		LveMappedFile file{ filepath };
+		if (file.size() % sizeof(uint32_t) != 0) {
+			throw std::runtime_error("SPIR-V size is not a multiple of 4: " + filepath);
+		}
+		uint64_t contentHash = hashContent(file.data(), file.size());
+
+		// a live module with the same hash counts only if its code matches byte for byte
+		auto findByContent = [&]() -> std::shared_ptr<LveShaderModule> {
+			auto hashIt = _modulesByHash.find(contentHash);
+			if (hashIt == _modulesByHash.end()) return nullptr;
+			auto existing = hashIt->second.lock();
+			return existing != nullptr && existing->hasCode(file.data(), file.size()) ? existing : nullptr;
+		};
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stats.fileReads++;
+			if (auto module = findByContent()) {
+				_stats.contentHits++;
+				_modulesByPath[filepath] = PathEntry{ writeTime, module };
+				return module;
+			}
+		}
+
+		// created without the lock, the driver's module creation is the slow part
+		auto created = std::make_shared<LveShaderModule>(_lveDevice,
+			reinterpret_cast<const uint32_t*>(file.data()), file.size(), contentHash);
+
+		std::shared_ptr<LveShaderModule> module;
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			module = findByContent();
+			if (module != nullptr) {
+				// another worker created the same code meanwhile, share its module
+				_stats.contentHits++;
+			}
+			else {
+				module = created;
+				_stats.modulesCreated++;
+				// on a hash collision the existing entry keeps the slot, this file only gets its path entry
+				auto hashIt = _modulesByHash.find(contentHash);
+				if (hashIt == _modulesByHash.end() || hashIt->second.expired()) {
+					_modulesByHash[contentHash] = module;
+				}
+			}
+			_modulesByPath[filepath] = PathEntry{ writeTime, module };
+		}
+		// a duplicate from a lost race is destroyed here, outside the lock
+		created.reset();
+		return module;
+	}
+
+	LveShaderModuleCache::Stats LveShaderModuleCache::getStats() const {
+		std::lock_guard<std::mutex> lock{ _mutex };
+		return _stats;
+	}
+}
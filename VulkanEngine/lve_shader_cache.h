@@ -0,0 +1,72 @@
+#pragma once
+
+#include "lve_device.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+	// Refcounted VkShaderModule, destroyed when the last pipeline holding it lets go. Keeps a copy
+	// of its SPIR-V so a content hash match can be confirmed byte for byte.
+	class LveShaderModule {
+	public:
+		LveShaderModule(LveDevice& device, const uint32_t* code, size_t codeSize, uint64_t contentHash);
+		~LveShaderModule();
+
+		LveShaderModule(const LveShaderModule&) = delete;
+		LveShaderModule& operator=(const LveShaderModule&) = delete;
+
+		VkShaderModule getShaderModule() const { return _shaderModule; }
+		uint64_t getContentHash() const { return _contentHash; }
+		size_t getCodeSize() const { return _code.size() * sizeof(uint32_t); }
+		bool hasCode(const char* code, size_t codeSize) const;
+
+	private:
+		LveDevice& _lveDevice;
+		VkShaderModule _shaderModule = VK_NULL_HANDLE;
+		uint64_t _contentHash;
+		std::vector<uint32_t> _code;
+	};
+
+	// Device level cache of shader modules keyed by SPIR-V content hash. Pipelines that
+	// reference the same code (through any path) share one module. Safe to use from the
+	// pipeline compiler's worker threads.
+	class LveShaderModuleCache {
+	public:
+		struct Stats {
+			uint32_t fileReads = 0;
+			uint32_t modulesCreated = 0;
+			uint32_t contentHits = 0;
+			uint32_t pathHits = 0;
+		};
+
+		explicit LveShaderModuleCache(LveDevice& device) : _lveDevice{ device } {}
+
+		LveShaderModuleCache(const LveShaderModuleCache&) = delete;
+		LveShaderModuleCache& operator=(const LveShaderModuleCache&) = delete;
+
+		std::shared_ptr<LveShaderModule> acquire(const std::string& filepath);
+
+		Stats getStats() const;
+
+		static uint64_t hashContent(const char* data, size_t size);
+
+	private:
+		struct PathEntry {
+			std::filesystem::file_time_type writeTime;
+			std::weak_ptr<LveShaderModule> module;
+		};
+
+		LveDevice& _lveDevice;
+
+		mutable std::mutex _mutex;
+		std::unordered_map<uint64_t, std::weak_ptr<LveShaderModule>> _modulesByHash;
+		std::unordered_map<std::string, PathEntry> _modulesByPath;
+		Stats _stats{};
+	};
+}
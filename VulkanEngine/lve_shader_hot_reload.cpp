@@ -0,0 +1,233 @@
+#include "lve_shader_hot_reload.h"
+
+#include "lve_swap_chain.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <system_error>
+
+namespace lve {
+
+	namespace {
+		std::string normalizePath(const std::filesystem::path& path) {
+			return path.lexically_normal().generic_string();
+		}
+
+		bool isShaderSource(const std::filesystem::path& path) {
+			static const char* extensions[] = { ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese" };
+			auto extension = path.extension().string();
+			return std::any_of(std::begin(extensions), std::end(extensions),
+				[&extension](const char* candidate) { return extension == candidate; });
+		}
+	}
+
+	LveShaderHotReloader::LveShaderHotReloader(
+		LvePipelineCompiler& pipelineCompiler,
+		const std::string& shaderDirectory,
+		std::chrono::milliseconds pollInterval)
+		: _pipelineCompiler{ pipelineCompiler },
+		_shaderDirectory{ shaderDirectory },
+		_pollInterval{ pollInterval },
+		_compilerPath{ findCompiler() }
+	{
+		// baseline the write times so sources are only recompiled after they are edited
+		scanSources(false);
+		_watcherThread = std::thread([this]() { watchLoop(); });
+	}
+
+	LveShaderHotReloader::~LveShaderHotReloader() {
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stopping = true;
+		}
+		_stopCondition.notify_all();
+		_watcherThread.join();
+
+		// rebuilds in flight still reference the owning systems' pipeline layouts
+		for (auto& watched : _watched) {
+			watched->pending.reset();
+		}
+	}
+
+	std::string LveShaderHotReloader::findCompiler() {
+		if (const char* sdk = std::getenv("VULKAN_SDK")) {
+#ifdef _WIN32
+			auto candidate = std::filesystem::path(sdk) / "Bin" / "glslc.exe";
+#else
+			auto candidate = std::filesystem::path(sdk) / "bin" / "glslc";
+#endif
+			if (std::filesystem::exists(candidate)) {
+				return candidate.string();
+			}
+		}
+		return "glslc";
+	}
+
+	void LveShaderHotReloader::watchPipeline(
+		LvePipelineHandle& slot,
+		const std::string& vertFilepath,
+		const std::string& fragFilepath,
+		ConfigFactory makeConfig)
+	{
+		auto watched = std::make_unique<WatchedPipeline>();
+		watched->slot = &slot;
+		watched->vertFilepath = vertFilepath;
+		watched->fragFilepath = fragFilepath;
+		watched->makeConfig = std::move(makeConfig);
+		_watched.push_back(std::move(watched));
+	}
+
+	void LveShaderHotReloader::unwatchPipeline(LvePipelineHandle& slot) {
+		auto it = std::find_if(_watched.begin(), _watched.end(),
+			[&slot](const std::unique_ptr<WatchedPipeline>& watched) { return watched->slot == &slot; });
+		if (it == _watched.end()) return;
+
+		(*it)->pending.reset();
+		_watched.erase(it);
+	}
+
+	void LveShaderHotReloader::watchComputePipeline(
+		std::unique_ptr<LveComputePipeline>& slot,
+		const std::string& compFilepath,
+		ComputeFactory makePipeline)
+	{
+		_watchedCompute.push_back({ &slot, compFilepath, std::move(makePipeline) });
+	}
+
+	void LveShaderHotReloader::unwatchComputePipeline(std::unique_ptr<LveComputePipeline>& slot) {
+		_watchedCompute.erase(
+			std::remove_if(_watchedCompute.begin(), _watchedCompute.end(),
+				[&slot](const WatchedComputePipeline& watched) { return watched.slot == &slot; }),
+			_watchedCompute.end());
+	}
+
+	void LveShaderHotReloader::watchLoop() {
+		std::unique_lock<std::mutex> lock{ _mutex };
+		while (!_stopCondition.wait_for(lock, _pollInterval, [this]() { return _stopping; })) {
+			lock.unlock();
+			scanSources(true);
+			lock.lock();
+		}
+	}
+
+	void LveShaderHotReloader::scanSources(bool compileChanges) {
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(_shaderDirectory, error)) {
+			if (!entry.is_regular_file() || !isShaderSource(entry.path())) continue;
+
+			auto writeTime = entry.last_write_time(error);
+			if (error) continue;
+
+			auto key = normalizePath(entry.path());
+			auto it = _sourceWriteTimes.find(key);
+			bool changed = it == _sourceWriteTimes.end() || it->second != writeTime;
+			_sourceWriteTimes[key] = writeTime;
+
+			if (changed && compileChanges && compileShader(entry.path())) {
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_changedSpirv.push_back(key + ".spv");
+			}
+		}
+	}
+
+	bool LveShaderHotReloader::compileShader(const std::filesystem::path& sourcePath) {
+		auto spirvPath = sourcePath.string() + ".spv";
+		std::string command = "\"" + _compilerPath + "\" \"" + sourcePath.string() + "\" -o \"" + spirvPath + "\"";
+#ifdef _WIN32
+		// cmd.exe strips the outer quote pair when the command itself starts with a quote
+		command = "\"" + command + "\"";
+#endif
+		std::cout << "Recompiling shader: " << sourcePath.generic_string() << std::endl;
+		if (std::system(command.c_str()) != 0) {
+			std::cerr << "Shader compile failed, keeping the previous pipeline: "
+				<< sourcePath.generic_string() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	void LveShaderHotReloader::submitRebuild(WatchedPipeline& watched) {
+		watched.pending = _pipelineCompiler.submit(
+			watched.vertFilepath, watched.fragFilepath, watched.makeConfig());
+		watched.rebuilding = true;
+		watched.changedWhileRebuilding = false;
+	}
+
+	void LveShaderHotReloader::update() {
+		_frameNumber++;
+
+		// a pipeline retired at frame N was last recorded in frame N - 1, whose fence has been
+		// waited on by the time beginFrame comes round to its slot again
+		_retired.erase(
+			std::remove_if(_retired.begin(), _retired.end(),
+				[this](const RetiredPipeline& retired) { return retired.destroyAfterFrame <= _frameNumber; }),
+			_retired.end());
+
+		std::vector<std::string> changedSpirv;
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			changedSpirv.swap(_changedSpirv);
+		}
+
+		if (!changedSpirv.empty()) {
+			_reloadCount++;
+		}
+
+		for (auto& watched : _watched) {
+			bool affected = std::any_of(changedSpirv.begin(), changedSpirv.end(),
+				[&watched](const std::string& path) {
+					return path == normalizePath(watched->vertFilepath) || path == normalizePath(watched->fragFilepath);
+				});
+
+			if (affected) {
+				if (watched->rebuilding) {
+					watched->changedWhileRebuilding = true;
+				}
+				else {
+					submitRebuild(*watched);
+				}
+			}
+
+			if (!watched->rebuilding) continue;
+
+			LvePipeline* rebuilt = nullptr;
+			try {
+				rebuilt = watched->pending.tryGet();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Pipeline rebuild failed, keeping the previous pipeline: " << e.what() << std::endl;
+				watched->pending = LvePipelineHandle{};
+				watched->rebuilding = false;
+				continue;
+			}
+			if (rebuilt == nullptr) continue;
+
+			auto retired = watched->slot->replace(watched->pending.replace(nullptr));
+			_retired.push_back({ std::move(retired), nullptr, _frameNumber + LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+			watched->rebuilding = false;
+
+			if (watched->changedWhileRebuilding) {
+				submitRebuild(*watched);
+			}
+		}
+
+		for (auto& watched : _watchedCompute) {
+			bool affected = std::any_of(changedSpirv.begin(), changedSpirv.end(),
+				[&watched](const std::string& path) { return path == normalizePath(watched.compFilepath); });
+			if (!affected) continue;
+
+			std::unique_ptr<LveComputePipeline> rebuilt;
+			try {
+				rebuilt = watched.makePipeline();
+			}
+			catch (const std::exception& e) {
+				std::cerr << "Pipeline rebuild failed, keeping the previous pipeline: " << e.what() << std::endl;
+				continue;
+			}
+
+			std::swap(*watched.slot, rebuilt);
+			_retired.push_back({ nullptr, std::move(rebuilt), _frameNumber + LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+		}
+	}
+}
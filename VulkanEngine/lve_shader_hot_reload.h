@@ -0,0 +1,115 @@
+#pragma once
+
+#include "lve_compute_pipeline.h"
+#include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+	// Watches the GLSL sources in a shader directory on a background thread, recompiles changed
+	// files with glslc and rebuilds the pipelines that use them on the pipeline compiler's workers.
+	// Rebuilt pipelines are swapped in by update() at a frame boundary and the replaced ones are
+	// destroyed once the frames that may still reference them have completed.
+	class LveShaderHotReloader {
+	public:
+		using ConfigFactory = std::function<std::unique_ptr<PipelineConfigInfo>()>;
+		using ComputeFactory = std::function<std::unique_ptr<LveComputePipeline>()>;
+
+		LveShaderHotReloader(
+			LvePipelineCompiler& pipelineCompiler,
+			const std::string& shaderDirectory = "shaders",
+			std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+		~LveShaderHotReloader();
+
+		LveShaderHotReloader(const LveShaderHotReloader&) = delete;
+		LveShaderHotReloader& operator=(const LveShaderHotReloader&) = delete;
+
+		// The slot must stay alive until it is unwatched or the reloader is destroyed. makeConfig is
+		// called on the main thread for each rebuild.
+		void watchPipeline(
+			LvePipelineHandle& slot,
+			const std::string& vertFilepath,
+			const std::string& fragFilepath,
+			ConfigFactory makeConfig);
+		// Waits for a rebuild of the slot in flight and forgets it, call before destroying the slot
+		// or the layout its rebuilds use. Pipelines it replaced are still retired as usual.
+		void unwatchPipeline(LvePipelineHandle& slot);
+
+		// Same for a compute pipeline, which is single stage and rebuilt by makePipeline on the main
+		// thread in update().
+		void watchComputePipeline(
+			std::unique_ptr<LveComputePipeline>& slot,
+			const std::string& compFilepath,
+			ComputeFactory makePipeline);
+		void unwatchComputePipeline(std::unique_ptr<LveComputePipeline>& slot);
+
+		// Call once per frame after LveRenderer::beginFrame and before recording.
+		void update();
+
+		uint32_t getReloadCount() const { return _reloadCount; }
+
+	private:
+		struct WatchedPipeline {
+			LvePipelineHandle* slot;
+			std::string vertFilepath;
+			std::string fragFilepath;
+			ConfigFactory makeConfig;
+			LvePipelineHandle pending;
+			bool rebuilding = false;
+			bool changedWhileRebuilding = false;
+		};
+
+		struct WatchedComputePipeline {
+			std::unique_ptr<LveComputePipeline>* slot;
+			std::string compFilepath;
+			ComputeFactory makePipeline;
+		};
+
+		// one of the two pipelines is set
+		struct RetiredPipeline {
+			std::unique_ptr<LvePipeline> pipeline;
+			std::unique_ptr<LveComputePipeline> computePipeline;
+			uint64_t destroyAfterFrame;
+		};
+
+		void watchLoop();
+		void submitRebuild(WatchedPipeline& watched);
+		void scanSources(bool compileChanges);
+		bool compileShader(const std::filesystem::path& sourcePath);
+		static std::string findCompiler();
+
+		LvePipelineCompiler& _pipelineCompiler;
+		std::filesystem::path _shaderDirectory;
+		std::chrono::milliseconds _pollInterval;
+		std::string _compilerPath;
+
+		// main thread only
+		std::vector<std::unique_ptr<WatchedPipeline>> _watched;
+		std::vector<WatchedComputePipeline> _watchedCompute;
+		std::vector<RetiredPipeline> _retired;
+		uint64_t _frameNumber{ 0 };
+		uint32_t _reloadCount{ 0 };
+
+		// watcher thread only
+		std::unordered_map<std::string, std::filesystem::file_time_type> _sourceWriteTimes;
+
+		// shared, guarded by _mutex
+		std::mutex _mutex;
+		std::condition_variable _stopCondition;
+		std::vector<std::string> _changedSpirv;
+		bool _stopping{ false };
+
+		std::thread _watcherThread;
+	};
+}
@@ -14,21 +14,58 @@ namespace lve {
 
     class LveSwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent);
-        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> prev);
+        // Per frame resources are allocated for this many frames, a swap chain cycles through
+        // framesInFlight of them.
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+        static constexpr int DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+        // Occlusion culling splits the frame around the depth pyramid build. All passes are
+        // compatible, so pipelines created against the main pass work in any of them.
+        enum RenderPassType {
+            RENDER_PASS_MAIN,   // clears, then presents
+            RENDER_PASS_EARLY,  // clears, leaves depth readable by compute shaders
+            RENDER_PASS_LATE,   // loads what the early pass left, then presents
+            RENDER_PASS_TYPE_COUNT
+        };
+
+        // With dynamicRendering no render passes or framebuffers are created, the renderer begins
+        // rendering on the image views and transitions the images itself. On a headless device the
+        // images are plain offscreen images, acquired in turn and never presented.
+        // framesInFlight is how many frames the CPU may record ahead of the GPU, at most
+        // MAX_FRAMES_IN_FLIGHT. presentMode is used when the surface supports it, FIFO otherwise.
+        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent, bool dynamicRendering = false,
+            int framesInFlight = DEFAULT_FRAMES_IN_FLIGHT, VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR);
+        // keeps the rendering mode of prev
+        LveSwapChain(LveDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> prev,
+            int framesInFlight, VkPresentModeKHR presentMode);
         ~LveSwapChain();
 
         LveSwapChain(const LveSwapChain&) = delete;
         LveSwapChain& operator=(const LveSwapChain&) = delete;
 
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
-        VkRenderPass getRenderPass() { return renderPass; }
+        VkRenderPass getRenderPass(RenderPassType type = RENDER_PASS_MAIN) { return renderPasses[type]; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        VkImage getImage(int index) { return swapChainImages[index]; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+        VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+        VkImage getDepthImage(int index) { return depthImages[index]; }
+        VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
+        bool usesDynamicRendering() { return dynamicRendering; }
+        int getFramesInFlight() { return framesInFlight; }
+        // what the surface was created with, FIFO when headless
+        VkPresentModeKHR getPresentMode() { return activePresentMode; }
+        // true when the depth format can be sampled, which the depth pyramid needs
+        bool isDepthSampleable() { return depthSampleable; }
+        // true when the images can be written by transfers, which upscaling needs
+        bool supportsTransferDst() { return transferDstSupported; }
+        // The layout a finished frame leaves the color image in, TRANSFER_SRC_OPTIMAL when headless
+        // so it can be copied out
+        VkImageLayout getPresentLayout() {
+            return device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        }
         uint32_t width() { return swapChainExtent.width; }
         uint32_t height() { return swapChainExtent.height; }
 
@@ -36,8 +73,17 @@ namespace lve {
             return static_cast<float>(swapChainExtent.width) / static_cast<float>(swapChainExtent.height);
         }
         VkFormat findDepthFormat();
+        // the names the command line takes, "unknown" for other modes
+        static const char* presentModeName(VkPresentModeKHR mode);
+
+        // A copy of the main render pass for creating pipelines and secondary command buffers,
+        // destroyed by the caller. Recreation keeps the formats, so it stays compatible with the
+        // passes of every later swap chain.
+        VkRenderPass createCompatibleRenderPass();
 
         VkResult acquireNextImage(uint32_t* imageIndex);
+        // blocks until the GPU has finished every frame submitted so far
+        void waitForSubmittedFrames();
         VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
 
         bool compareSwapFormats(const LveSwapChain& swapChain) const {
@@ -49,9 +95,19 @@ namespace lve {
         void init();
 
         void createSwapChain();
+        void createOffscreenImages();
         void createImageViews();
         void createDepthResources();
         void createRenderPass();
+        VkRenderPass createMainRenderPass();
+        VkRenderPass createRenderPass(
+            VkAttachmentLoadOp loadOp,
+            VkImageLayout colorInitialLayout,
+            VkImageLayout colorFinalLayout,
+            VkImageLayout depthInitialLayout,
+            VkImageLayout depthFinalLayout,
+            VkAttachmentStoreOp depthStoreOp,
+            const std::vector<VkSubpassDependency>& dependencies);
         void createFramebuffers();
         void createSyncObjects();
 
@@ -65,20 +121,28 @@ namespace lve {
         VkFormat swapChainImageFormat;
         VkFormat swapChainDepthFormat;
         VkExtent2D swapChainExtent;
+        bool depthSampleable = false;
+        bool transferDstSupported = false;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPasses[RENDER_PASS_TYPE_COUNT]{};
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
         std::vector<VkImage> swapChainImages;
+        // headless only, the swap chain owns the images then
+        std::vector<VkDeviceMemory> offscreenImageMemorys;
         std::vector<VkImageView> swapChainImageViews;
 
         LveDevice& device;
         VkExtent2D windowExtent;
+        bool dynamicRendering = false;
+        int framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+        VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        VkPresentModeKHR activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
-        VkSwapchainKHR swapChain;
+        VkSwapchainKHR swapChain = VK_NULL_HANDLE;
         std::shared_ptr<LveSwapChain> oldSwapChain;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -86,6 +150,7 @@ namespace lve {
         std::vector<VkFence> inFlightFences;
         std::vector<VkFence> imagesInFlight;
         size_t currentFrame = 0;
+        uint32_t nextOffscreenImage = 0;
     };
 
 }  // namespace lve
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "lve_thread_pool.h"
+#include "lve_cpu_profiler.h"
+
+#include <algorithm>
+
+namespace lve {
+
+	LveThreadPool::LveThreadPool(uint32_t workerCount) {
+		if (workerCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+		}
+
+		_workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; ++i) {
+			_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	LveThreadPool::~LveThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stopping = true;
+		}
+		_condition.notify_all();
+
+		// queued tasks are drained before the workers exit so no future is left dangling
+		for (auto& worker : _workers) {
+			worker.join();
+		}
+	}
+
+	void LveThreadPool::workerLoop() {
+		LVE_PROFILE_THREAD("worker");
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+				if (_stopping && _tasks.empty()) {
+					return;
+				}
+				task = std::move(_tasks.front());
+				_tasks.pop();
+			}
+			LVE_PROFILE_ZONE("worker task");
+			task();
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve {
+	class LveThreadPool {
+	public:
+		// workerCount == 0 picks hardware_concurrency - 1 (at least one worker)
+		explicit LveThreadPool(uint32_t workerCount = 0);
+		~LveThreadPool();
+
+		LveThreadPool(const LveThreadPool&) = delete;
+		LveThreadPool& operator=(const LveThreadPool&) = delete;
+
+		template <typename F>
+		auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+			using Result = std::invoke_result_t<std::decay_t<F>>;
+			auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+			auto future = packaged->get_future();
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_tasks.emplace([packaged]() { (*packaged)(); });
+			}
+			_condition.notify_one();
+			return future;
+		}
+
+		uint32_t workerCount() const { return static_cast<uint32_t>(_workers.size()); }
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> _workers;
+		std::queue<std::function<void()>> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		bool _stopping{ false };
+	};
+}
@@ -4,15 +4,19 @@
 
 namespace lve {
 
-	LveWindow::LveWindow(int width, int height, const std::string& name) 
+	LveWindow::LveWindow(int width, int height, const std::string& name, bool headless) 
 		: _width(width), _height(height), _windowName(name)
 	{
-		initWindow();
+		if (!headless) {
+			initWindow();
+		}
 	}
 
 	LveWindow::~LveWindow() {
-		glfwDestroyWindow(_window);
-		glfwTerminate();
+		if (_window != nullptr) {
+			glfwDestroyWindow(_window);
+			glfwTerminate();
+		}
 	}
 
 	void LveWindow::framebufferResizedCallback(GLFWwindow* window, int width, int height) {
@@ -34,6 +38,9 @@ namespace lve {
 
 	void LveWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
 	{
+		if (_window == nullptr) {
+			throw std::runtime_error("A headless window has no surface.");
+		}
 		if (glfwCreateWindowSurface(instance, _window, nullptr, surface) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create window surface.");
 		}
@@ -9,13 +9,16 @@
 namespace lve {
 	class LveWindow {
 	public:
-		LveWindow(int width, int height, const std::string& name);
+		// A headless window initializes no GLFW and creates no window, its extent never changes and
+		// the device renders without a surface.
+		LveWindow(int width, int height, const std::string& name, bool headless = false);
 		~LveWindow();
 
 		LveWindow(const LveWindow&) = delete;
 		LveWindow operator=(const LveWindow&) = delete;
 
-		bool shouldClose() { return glfwWindowShouldClose(_window); }
+		bool shouldClose() { return _window != nullptr && glfwWindowShouldClose(_window); }
+		bool isHeadless() const { return _window == nullptr; }
 		VkExtent2D getExtent() { return { static_cast<uint32_t>(_width), static_cast<uint32_t>(_height) }; }
 		bool wasWindowResized() { return _framebufferResized; }
 		void resetWindowResizedFlag() { _framebufferResized = false; }
@@ -33,6 +36,6 @@ namespace lve {
 		bool _framebufferResized = false;
 
 		std::string _windowName;
-		GLFWwindow* _window;
+		GLFWwindow* _window = nullptr;
 	};
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "lve_swap_chain.h"
+#include "lve_cpu_profiler.h"
 
 // std
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,13 +13,19 @@
 
 namespace lve {
 
-    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent)
-        : device{ deviceRef }, windowExtent{ extent } {
+    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, bool dynamicRendering,
+        int framesInFlight, VkPresentModeKHR presentMode)
+        : device{ deviceRef }, windowExtent{ extent }, dynamicRendering{ dynamicRendering },
+        framesInFlight{ framesInFlight }, preferredPresentMode{ presentMode } {
+        assert(framesInFlight >= 1 && framesInFlight <= MAX_FRAMES_IN_FLIGHT && "Frames in flight out of range.");
         init();
     }
 
-    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> prev)
-        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ prev } {
+    LveSwapChain::LveSwapChain(LveDevice& deviceRef, VkExtent2D extent, std::shared_ptr<LveSwapChain> prev,
+        int framesInFlight, VkPresentModeKHR presentMode)
+        : device{ deviceRef }, windowExtent{ extent }, dynamicRendering{ prev->dynamicRendering },
+        framesInFlight{ framesInFlight }, preferredPresentMode{ presentMode }, oldSwapChain{ prev } {
+        assert(framesInFlight >= 1 && framesInFlight <= MAX_FRAMES_IN_FLIGHT && "Frames in flight out of range.");
         init();
 
         // clean up old swap chain since it's no longer needed
@@ -27,9 +35,13 @@ namespace lve {
     void LveSwapChain::init() {
         createSwapChain();
         createImageViews();
-        createRenderPass();
+        if (!dynamicRendering) {
+            createRenderPass();
+        }
         createDepthResources();
-        createFramebuffers();
+        if (!dynamicRendering) {
+            createFramebuffers();
+        }
         createSyncObjects();
     }
 
@@ -44,6 +56,11 @@ namespace lve {
             swapChain = nullptr;
         }
 
+        for (size_t i = 0; i < offscreenImageMemorys.size(); i++) {
+            vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+            vkFreeMemory(device.device(), offscreenImageMemorys[i], nullptr);
+        }
+
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
@@ -54,10 +71,12 @@ namespace lve {
             vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
         }
 
-        vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        for (auto renderPass : renderPasses) {
+            vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        }
 
         // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
             vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(device.device(), inFlightFences[i], nullptr);
@@ -65,13 +84,23 @@ namespace lve {
     }
 
     VkResult LveSwapChain::acquireNextImage(uint32_t* imageIndex) {
-        vkWaitForFences(
-            device.device(),
-            1,
-            &inFlightFences[currentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
+        {
+            LVE_PROFILE_ZONE("wait for frame fence");
+            vkWaitForFences(
+                device.device(),
+                1,
+                &inFlightFences[currentFrame],
+                VK_TRUE,
+                std::numeric_limits<uint64_t>::max());
+        }
 
+        if (device.isHeadless()) {
+            *imageIndex = nextOffscreenImage;
+            nextOffscreenImage = (nextOffscreenImage + 1) % static_cast<uint32_t>(imageCount());
+            return VK_SUCCESS;
+        }
+
+        LVE_PROFILE_ZONE("acquire image");
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
             swapChain,
@@ -83,9 +112,21 @@ namespace lve {
         return result;
     }
 
+    void LveSwapChain::waitForSubmittedFrames() {
+        LVE_PROFILE_ZONE("wait for submitted frames");
+        // unsubmitted fences stay signalled from creation
+        vkWaitForFences(
+            device.device(),
+            static_cast<uint32_t>(inFlightFences.size()),
+            inFlightFences.data(),
+            VK_TRUE,
+            std::numeric_limits<uint64_t>::max());
+    }
+
     VkResult LveSwapChain::submitCommandBuffers(
         const VkCommandBuffer* buffers, uint32_t* imageIndex) {
         if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+            LVE_PROFILE_ZONE("wait for image fence");
             vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
         }
         imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
@@ -93,9 +134,11 @@ namespace lve {
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+        // headless images are not acquired or presented, the fences alone order their reuse
+        bool headless = device.isHeadless();
         VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
         VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.waitSemaphoreCount = headless ? 0 : 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
 
@@ -103,13 +146,21 @@ namespace lve {
         submitInfo.pCommandBuffers = buffers;
 
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = headless ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+        {
+            LVE_PROFILE_ZONE("queue submit");
+            if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+                VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+        }
+
+        if (headless) {
+            currentFrame = (currentFrame + 1) % framesInFlight;
+            return VK_SUCCESS;
         }
 
         VkPresentInfoKHR presentInfo = {};
@@ -124,18 +175,27 @@ namespace lve {
 
         presentInfo.pImageIndices = imageIndex;
 
-        auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+        VkResult result;
+        {
+            LVE_PROFILE_ZONE("present");
+            result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+        }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % framesInFlight;
 
         return result;
     }
 
     void LveSwapChain::createSwapChain() {
+        if (device.isHeadless()) {
+            createOffscreenImages();
+            return;
+        }
+
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        activePresentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -154,6 +214,12 @@ namespace lve {
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // lets the renderer blit a scaled render target onto the images
+        transferDstSupported =
+            (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+        if (transferDstSupported) {
+            createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        }
 
         QueueFamilyIndices indices = device.findPhysicalQueueFamilies();
         uint32_t queueFamilyIndices[] = { indices.graphicsFamily, indices.presentFamily };
@@ -172,7 +238,7 @@ namespace lve {
         createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
         createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 
-        createInfo.presentMode = presentMode;
+        createInfo.presentMode = activePresentMode;
         createInfo.clipped = VK_TRUE;
 
         createInfo.oldSwapchain = oldSwapChain == nullptr ? VK_NULL_HANDLE : oldSwapChain->swapChain;
@@ -193,6 +259,45 @@ namespace lve {
         swapChainExtent = extent;
     }
 
+    void LveSwapChain::createOffscreenImages() {
+        // the formats a surface would most likely offer, blittable for the scaled render target
+        swapChainImageFormat = device.findSupportedFormat(
+            { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB },
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT);
+        swapChainExtent = windowExtent;
+        transferDstSupported = true;
+        activePresentMode = VK_PRESENT_MODE_FIFO_KHR;
+        std::cout << "Present mode: headless" << std::endl;
+
+        swapChainImages.resize(framesInFlight);
+        offscreenImageMemorys.resize(framesInFlight);
+        for (size_t i = 0; i < swapChainImages.size(); i++) {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = swapChainExtent.width;
+            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+                | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.flags = 0;
+
+            device.createImageWithInfo(
+                imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                swapChainImages[i],
+                offscreenImageMemorys[i]);
+        }
+    }
+
     void LveSwapChain::createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
         for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -214,16 +319,108 @@ namespace lve {
         }
     }
 
+    namespace {
+        // the attachment writes of the pass wait for the previous frame's writes to the same images
+        VkSubpassDependency attachmentDependency() {
+            VkSubpassDependency dependency = {};
+            dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+            dependency.srcAccessMask = 0;
+            dependency.srcStageMask =
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dependency.dstSubpass = 0;
+            dependency.dstStageMask =
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+            dependency.dstAccessMask =
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            return dependency;
+        }
+    }
+
+    VkRenderPass LveSwapChain::createMainRenderPass() {
+        return createRenderPass(
+            VK_ATTACHMENT_LOAD_OP_CLEAR,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            getPresentLayout(),
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            { attachmentDependency() });
+    }
+
+    VkRenderPass LveSwapChain::createCompatibleRenderPass() {
+        assert(!dynamicRendering && "Dynamic rendering has no render passes.");
+        return createMainRenderPass();
+    }
+
     void LveSwapChain::createRenderPass() {
+        renderPasses[RENDER_PASS_MAIN] = createMainRenderPass();
+
+        // the layout transition of depth must also wait for last frame's pyramid build
+        VkSubpassDependency earlyDependency = attachmentDependency();
+        earlyDependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+        // depth is stored and handed to the compute shader that builds the depth pyramid
+        VkSubpassDependency earlyToCompute = {};
+        earlyToCompute.srcSubpass = 0;
+        earlyToCompute.srcStageMask =
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        earlyToCompute.srcAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        earlyToCompute.dstSubpass = VK_SUBPASS_EXTERNAL;
+        earlyToCompute.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        earlyToCompute.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        renderPasses[RENDER_PASS_EARLY] = createRenderPass(
+            VK_ATTACHMENT_LOAD_OP_CLEAR,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_ATTACHMENT_STORE_OP_STORE,
+            { earlyDependency, earlyToCompute });
+
+        // the compute reads of depth must finish before the layout goes back to writable, and the
+        // early pass' attachment writes must be visible to the loads
+        VkSubpassDependency computeToLate = {};
+        computeToLate.srcSubpass = VK_SUBPASS_EXTERNAL;
+        computeToLate.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        computeToLate.srcAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        computeToLate.dstSubpass = 0;
+        computeToLate.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        computeToLate.dstAccessMask =
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        renderPasses[RENDER_PASS_LATE] = createRenderPass(
+            VK_ATTACHMENT_LOAD_OP_LOAD,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            getPresentLayout(),
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            { computeToLate });
+    }
+
+    VkRenderPass LveSwapChain::createRenderPass(
+        VkAttachmentLoadOp loadOp,
+        VkImageLayout colorInitialLayout,
+        VkImageLayout colorFinalLayout,
+        VkImageLayout depthInitialLayout,
+        VkImageLayout depthFinalLayout,
+        VkAttachmentStoreOp depthStoreOp,
+        const std::vector<VkSubpassDependency>& dependencies) {
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = depthStoreOp;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.initialLayout = depthInitialLayout;
+        depthAttachment.finalLayout = depthFinalLayout;
 
         VkAttachmentReference depthAttachmentRef{};
         depthAttachmentRef.attachment = 1;
@@ -232,12 +429,12 @@ namespace lve {
         VkAttachmentDescription colorAttachment = {};
         colorAttachment.format = getSwapChainImageFormat();
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.loadOp = loadOp;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.initialLayout = colorInitialLayout;
+        colorAttachment.finalLayout = colorFinalLayout;
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
@@ -249,17 +446,6 @@ namespace lve {
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstSubpass = 0;
-        dependency.dstStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask =
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
         std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -267,12 +453,14 @@ namespace lve {
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
 
+        VkRenderPass renderPass;
         if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
             throw std::runtime_error("failed to create render pass!");
         }
+        return renderPass;
     }
 
     void LveSwapChain::createFramebuffers() {
@@ -283,7 +471,7 @@ namespace lve {
             VkExtent2D swapChainExtent = getSwapChainExtent();
             VkFramebufferCreateInfo framebufferInfo = {};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.renderPass = renderPasses[RENDER_PASS_MAIN];
             framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
             framebufferInfo.pAttachments = attachments.data();
             framebufferInfo.width = swapChainExtent.width;
@@ -322,6 +510,9 @@ namespace lve {
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            if (depthSampleable) {
+                imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+            }
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
@@ -350,9 +541,9 @@ namespace lve {
     }
 
     void LveSwapChain::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        imageAvailableSemaphores.resize(framesInFlight);
+        renderFinishedSemaphores.resize(framesInFlight);
+        inFlightFences.resize(framesInFlight);
         imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -362,7 +553,7 @@ namespace lve {
         fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
         fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                 VK_SUCCESS ||
                 vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
@@ -385,23 +576,28 @@ namespace lve {
         return availableFormats[0];
     }
 
+    const char* LveSwapChain::presentModeName(VkPresentModeKHR mode) {
+        switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+        default: return "unknown";
+        }
+    }
+
     VkPresentModeKHR LveSwapChain::chooseSwapPresentMode(
         const std::vector<VkPresentModeKHR>& availablePresentModes) {
         for (const auto& availablePresentMode : availablePresentModes) {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                std::cout << "Present mode: Mailbox" << std::endl;
+            if (availablePresentMode == preferredPresentMode) {
+                std::cout << "Present mode: " << presentModeName(availablePresentMode) << std::endl;
                 return availablePresentMode;
             }
         }
 
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
-
-        std::cout << "Present mode: V-Sync" << std::endl;
+        // every surface supports FIFO
+        std::cout << "Present mode: " << presentModeName(preferredPresentMode) << " unsupported, using "
+            << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -423,10 +619,23 @@ namespace lve {
     }
 
     VkFormat LveSwapChain::findDepthFormat() {
+        std::vector<VkFormat> candidates = {
+            VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+
+        // prefer a format the depth pyramid can sample, D32_SFLOAT nearly always is
+        for (VkFormat format : candidates) {
+            if (device.isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL,
+                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+                depthSampleable = true;
+                return format;
+            }
+        }
+
+        depthSampleable = false;
         return device.findSupportedFormat(
-            { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+            candidates,
             VK_IMAGE_TILING_OPTIMAL,
             VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
     }
 
-}  // namespace lve
\ No newline at end of file
+}  // namespace lve
@@ -1,11 +1,197 @@
 
 #include "first_app.h"
+#include "lve_cpu_profiler.h"
+#include "lve_culling.h"
+#include "lve_render_graph.h"
 
 // std
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
-int main() {
-	lve::FirstApp app;
+int main(int argc, char* argv[]) {
+	lve::FirstApp::Options options{};
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--mixed-state-scene") == 0) {
+			options.mixedStateScene = true;
+		}
+		else if (std::strcmp(argv[i], "--no-extended-dynamic-state") == 0) {
+			options.extendedDynamicState = false;
+		}
+		else if (std::strcmp(argv[i], "--no-dynamic-rendering") == 0) {
+			options.dynamicRendering = false;
+		}
+		else if (std::strcmp(argv[i], "--headless") == 0) {
+			options.headless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			options.maxFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			options.maxSeconds = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--gpu-profile") == 0) {
+			options.gpuProfiler = true;
+		}
+		else if (std::strcmp(argv[i], "--gpu-profile-stats") == 0) {
+			options.gpuProfiler = true;
+			options.gpuPipelineStatistics = true;
+		}
+		else if (std::strcmp(argv[i], "--gpu-profile-log") == 0 && i + 1 < argc) {
+			options.gpuProfiler = true;
+			options.gpuProfilerLogSeconds = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc) {
+			options.cpuTraceFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--cpu-trace-skip") == 0 && i + 1 < argc) {
+			options.cpuTraceSkipFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--cpu-trace-output") == 0 && i + 1 < argc) {
+			options.cpuTracePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+			options.framePacing.framesInFlight = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+			const char* name = argv[++i];
+			const VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+				VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+			bool known = false;
+			for (VkPresentModeKHR presentMode : presentModes) {
+				if (std::strcmp(name, lve::LveSwapChain::presentModeName(presentMode)) == 0) {
+					options.framePacing.presentMode = presentMode;
+					known = true;
+				}
+			}
+			if (!known) {
+				std::cerr << "Unknown present mode " << name << ", expected fifo, fifo-relaxed, mailbox or immediate" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+		else if (std::strcmp(argv[i], "--low-latency") == 0) {
+			options.framePacing.lowLatency = true;
+		}
+		else if (std::strcmp(argv[i], "--latency-test") == 0) {
+			options.latencyTest = true;
+		}
+		else if (std::strcmp(argv[i], "--latency-frames") == 0 && i + 1 < argc) {
+			options.latencyTestSettings.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--latency-warmup") == 0 && i + 1 < argc) {
+			options.latencyTestSettings.warmupFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--benchmark") == 0) {
+			options.benchmark = true;
+		}
+		else if (std::strcmp(argv[i], "--bench-objects") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.objects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-models") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.models = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-lights") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.lights = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-seed") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.warmupFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--bench-output") == 0 && i + 1 < argc) {
+			options.benchmarkSettings.outputPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--dynamic-resolution") == 0) {
+			options.dynamicResolution = true;
+		}
+		else if (std::strcmp(argv[i], "--gpu-budget-ms") == 0 && i + 1 < argc) {
+			options.resolutionSettings.budgetMilliseconds = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--min-resolution-scale") == 0 && i + 1 < argc) {
+			options.resolutionSettings.minScale = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--max-resolution-scale") == 0 && i + 1 < argc) {
+			options.resolutionSettings.maxScale = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--cull-benchmark") == 0) {
+			// CPU only, runs before the window and device exist
+			lve::runCullingBenchmark(std::cout);
+			return EXIT_SUCCESS;
+		}
+		else if (std::strcmp(argv[i], "--render-graph-test") == 0) {
+			// CPU only like the benchmark, plans sample graphs without a device
+			return lve::runRenderGraphSelfTest(std::cout) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		else if (std::strcmp(argv[i], "--gpu-driven") == 0) {
+			options.gpuDriven = true;
+		}
+		else if (std::strcmp(argv[i], "--readback-draws") == 0) {
+			options.readbackDraws = true;
+		}
+		else if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+			options.depthPrepass = true;
+		}
+		else if (std::strcmp(argv[i], "--occlusion-culling") == 0) {
+			options.occlusionCulling = true;
+		}
+		else if (std::strcmp(argv[i], "--per-object-lights") == 0) {
+			options.perObjectLights = true;
+		}
+		else if (std::strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc) {
+			options.recordThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--stress-objects") == 0 && i + 1 < argc) {
+			options.stressObjects = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--stress-lights") == 0 && i + 1 < argc) {
+			options.stressLights = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else {
+			std::cerr << "Unknown option: " << argv[i] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	const auto& resolution = options.resolutionSettings;
+	if (!(resolution.minScale > 0.0f && resolution.minScale <= resolution.maxScale && resolution.budgetMilliseconds > 0.0f)) {
+		std::cerr << "Resolution scales must satisfy 0 < min <= max and the GPU budget must be positive" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (options.benchmark && (options.benchmarkSettings.frames == 0 || options.benchmarkSettings.models == 0)) {
+		std::cerr << "--bench-frames and --bench-models must be at least 1" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (options.framePacing.framesInFlight < 1
+		|| options.framePacing.framesInFlight > lve::LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+	{
+		std::cerr << "--frames-in-flight must be between 1 and " << lve::LveSwapChain::MAX_FRAMES_IN_FLIGHT << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (options.latencyTest && (options.headless || options.latencyTestSettings.frames == 0)) {
+		// the present modes and the input being measured need a window
+		std::cerr << "--latency-test needs a window and --latency-frames of at least 1" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (options.cpuTraceFrames > 0 && !lve::LveCpuProfiler::ENABLED) {
+		std::cerr << "--cpu-trace ignored: built with LVE_CPU_PROFILER=0" << std::endl;
+		options.cpuTraceFrames = 0;
+	}
+
+	if (options.headless && !options.benchmark && options.maxFrames == 0 && !(options.maxSeconds > 0.0f)) {
+		// nothing could close it, a benchmark stops after its frames
+		std::cerr << "--headless needs --frames, --seconds or --benchmark" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	lve::FirstApp app{ options };
 
 	try
 	{
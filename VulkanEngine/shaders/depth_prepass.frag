@@ -0,0 +1,5 @@
+#version 450
+
+// depth only, color writes are masked off in the pre-pass pipeline
+void main() {
+}
@@ -0,0 +1,36 @@
+#version 450
+
+// position only, the pre-pass pipeline binds just stream 0 of LveModel
+layout (location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec4 ambientLightColor;	// w is intensity
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
+} ubo;
+
+// see PackedTransform in lve_game_object.h
+struct PackedTransform {
+    vec4 modelRows[3];
+    vec4 inverseScaleSquared;
+};
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    PackedTransform objects[];
+};
+
+// the main pass tests with EQUAL, both shaders must produce bit-identical depth
+invariant gl_Position;
+
+void main() {
+    PackedTransform object = objects[gl_InstanceIndex];
+
+    vec4 positionModel = vec4(position, 1.0);
+    vec4 positionWorld = vec4(
+        dot(object.modelRows[0], positionModel),
+        dot(object.modelRows[1], positionModel),
+        dot(object.modelRows[2], positionModel),
+        1.0);
+    gl_Position = ubo.projectionMatrix *  ubo.viewMatrix * positionWorld;
+}
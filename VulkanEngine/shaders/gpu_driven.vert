@@ -0,0 +1,57 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in vec3 normal;
+layout (location = 3) in vec2 uv;
+
+layout (location = 0) out vec3 fragColor;
+layout (location = 1) out vec3 fragPosWorld;
+layout (location = 2) out vec3 fragNormalWorld;
+// shares simple_shader.frag, which only reads this with per-object lights
+layout (location = 3) flat out uvec4 fragObjectLights;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionMatrix;
+    mat4 viewMatrix;
+    vec4 ambientLightColor;	// w is intensity
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
+} ubo;
+
+// see PackedTransform in lve_game_object.h
+struct PackedTransform {
+    vec4 modelRows[3];
+    vec4 inverseScaleSquared;
+};
+
+struct ObjectData {
+    PackedTransform transform;
+    vec4 boundingSphere;
+    uint meshIndex;
+};
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+void main() {
+    // firstInstance of each indirect draw is the object index written by gpu_cull.comp
+    PackedTransform object = objects[gl_InstanceIndex].transform;
+
+    vec4 positionModel = vec4(position, 1.0);
+    vec4 positionWorld = vec4(
+        dot(object.modelRows[0], positionModel),
+        dot(object.modelRows[1], positionModel),
+        dot(object.modelRows[2], positionModel),
+        1.0);
+    gl_Position = ubo.projectionMatrix * ubo.viewMatrix * positionWorld;
+
+    vec3 scaledNormal = normal * object.inverseScaleSquared.xyz;
+    fragNormalWorld = normalize(vec3(
+        dot(object.modelRows[0].xyz, scaledNormal),
+        dot(object.modelRows[1].xyz, scaledNormal),
+        dot(object.modelRows[2].xyz, scaledNormal)));
+    fragPosWorld = positionWorld.xyz;
+    fragColor = color;
+    fragObjectLights = uvec4(0xffffffffu);
+}
@@ -1,30 +1,21 @@
 #version 450
 
 layout(location = 0) in vec2 fragOffset;
+layout(location = 1) flat in vec4 fragColor;
 layout(location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position; 
-    vec4 color;
-};
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projectionMatrix;
     mat4 viewMatrix;
     vec4 ambientLightColor;	// w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-} push;
-
 void main() {
     float dis = sqrt(dot(fragOffset, fragOffset));
     if(dis >= 1.0) {
         discard;
     }
-    outColor = vec4(push.color.xyz, 1.0);
+    outColor = vec4(fragColor.xyz, 1.0);
 }
\ No newline at end of file
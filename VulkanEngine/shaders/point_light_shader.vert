@@ -10,34 +10,37 @@ const vec2 OFFSETS[6] = vec2[](
 );
 
 layout(location = 0) out vec2 fragOffset;
+layout(location = 1) flat out vec4 fragColor;
 
-struct PointLight {
-    vec4 position; 
-    vec4 color;
-};
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projectionMatrix;
     mat4 viewMatrix;
     vec4 ambientLightColor;	// w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
 } ubo;
 
-layout(push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-} push;
+struct Billboard {
+    vec4 position;  // w is radius
+    vec4 color;     // w is intensity
+};
+
+// sorted back to front by PointLightSystem, one instance per billboard
+layout(std430, set = 1, binding = 0) readonly buffer BillboardBuffer {
+    Billboard billboards[];
+};
 
 void main() {
+    Billboard billboard = billboards[gl_InstanceIndex];
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = billboard.color;
 
     vec3 cameraRightWorld = {ubo.viewMatrix[0][0], ubo.viewMatrix[1][0], ubo.viewMatrix[2][0]};
     vec3 cameraUpWorld = {ubo.viewMatrix[0][1], ubo.viewMatrix[1][1], ubo.viewMatrix[2][1]};
 
-    vec3 positionWorld = push.position.xyz 
-    + push.radius * fragOffset.x * cameraRightWorld
-    + push.radius * fragOffset.y * cameraUpWorld;
+    vec3 positionWorld = billboard.position.xyz 
+    + billboard.position.w * fragOffset.x * cameraRightWorld
+    + billboard.position.w * fragOffset.y * cameraUpWorld;
 
     gl_Position = ubo.projectionMatrix * ubo.viewMatrix * vec4(positionWorld, 1.0f);
 }
\ No newline at end of file
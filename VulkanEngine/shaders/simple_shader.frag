@@ -3,38 +3,84 @@
 layout (location = 0) in vec3 fragColor;
 layout (location = 1) in vec3 fragPosWorld;
 layout (location = 2) in vec3 fragNormalWorld;
+// up to 8 light indices of the object, 16 bits each, 0xffff ends the list
+layout (location = 3) flat in uvec4 fragObjectLights;
 
 layout (location = 0) out vec4 outColor;
 
+// compile-time variant knobs, set through LveSpecializationConstants
+// MAX_LIGHTS caps the lights shaded per cluster, see LveLightClusters::MAX_LIGHTS_PER_CLUSTER
+layout (constant_id = 0) const int MAX_LIGHTS = 256;
+layout (constant_id = 1) const bool ENABLE_POINT_LIGHTS = true;
+// shades the lights SimpleRenderSystem picked for the object instead of the cluster's
+layout (constant_id = 2) const bool PER_OBJECT_LIGHTS = false;
+
+const uint MAX_OBJECT_LIGHTS = 8;
+const uint NO_LIGHT = 0xffff;
+
 struct PointLight {
-    vec4 position; 
-    vec4 color;
+    vec4 position;  // w is range
+    vec4 color;     // w is intensity
 };
+
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projectionMatrix;
     mat4 viewMatrix;
     vec4 ambientLightColor;	// w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
 } ubo;
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
+// written by LveLightClusters
+layout(std430, set = 0, binding = 1) readonly buffer PointLightBuffer {
+    PointLight pointLights[];
+};
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer {
+    uvec2 clusters[];   // first light index, light count
+};
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer {
+    uint lightIndices[];
+};
+
+uint clusterIndex() {
+    float viewDepth = (ubo.viewMatrix * vec4(fragPosWorld, 1.0)).z;
+    uvec3 cell;
+    cell.xy = uvec2(gl_FragCoord.xy / ubo.clusterParams.xy);
+    cell.z = uint(max(log(viewDepth) * ubo.clusterParams.z + ubo.clusterParams.w, 0.0));
+    cell = min(cell, ubo.clusterCounts.xyz - 1);
+    return (cell.z * ubo.clusterCounts.y + cell.y) * ubo.clusterCounts.x + cell.x;
+}
+
+vec3 lightContribution(PointLight light, vec3 surfaceNormal) {
+    vec3 directionToLight = light.position.xyz - fragPosWorld.xyz;
+    float distanceSquared = dot(directionToLight, directionToLight);
+    // inverse square, windowed to reach zero at the range the light was selected by
+    float rangeFraction = distanceSquared / (light.position.w * light.position.w);
+    float window = clamp(1.0 - rangeFraction * rangeFraction, 0.0, 1.0);
+    float attenuation = window * window / distanceSquared;
+    float cosAngIncidence = max(dot(surfaceNormal, normalize(directionToLight)), 0);
+    vec3 intensity = light.color.xyz * light.color.w * attenuation;
+    return intensity * cosAngIncidence;
+}
 
 void main() {
     vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
     vec3 surfaceNormal = normalize(fragNormalWorld);
 
-    for(int i = 0; i < ubo.numLights; ++i) {
-        PointLight light = ubo.pointLights[i];
-        vec3 directionToLight = light.position.xyz - fragPosWorld.xyz;
-        float attenuation = 1.0 / dot(directionToLight, directionToLight);
-        float cosAngIncidence = max(dot(surfaceNormal, normalize(directionToLight)), 0);
-        vec3 intensity = light.color.xyz * light.color.w * attenuation;
-
-        diffuseLight += (intensity * cosAngIncidence);
+    if (ENABLE_POINT_LIGHTS && PER_OBJECT_LIGHTS) {
+        // a fixed bound, so every fragment costs at most MAX_OBJECT_LIGHTS lights
+        for(uint i = 0; i < MAX_OBJECT_LIGHTS; ++i) {
+            uint lightIndex = (fragObjectLights[i / 2] >> (16 * (i % 2))) & 0xffff;
+            if (lightIndex == NO_LIGHT) break;
+            diffuseLight += lightContribution(pointLights[lightIndex], surfaceNormal);
+        }
+    }
+    else if (ENABLE_POINT_LIGHTS) {
+        uvec2 cluster = clusters[clusterIndex()];
+        uint lightCount = min(cluster.y, uint(MAX_LIGHTS));
+        for(uint i = 0; i < lightCount; ++i) {
+            diffuseLight += lightContribution(pointLights[lightIndices[cluster.x + i]], surfaceNormal);
+        }
     }
 
     outColor = vec4(diffuseLight * fragColor, 1.0);    
@@ -8,29 +8,50 @@ layout (location = 3) in vec2 uv;
 layout (location = 0) out vec3 fragColor;
 layout (location = 1) out vec3 fragPosWorld;
 layout (location = 2) out vec3 fragNormalWorld;
+layout (location = 3) flat out uvec4 fragObjectLights;
 
-struct PointLight {
-    vec4 position; 
-    vec4 color;
-};
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projectionMatrix;
     mat4 viewMatrix;
     vec4 ambientLightColor;	// w is intensity
-    PointLight pointLights[10];
-    int numLights;
+    uvec4 clusterCounts;    // light cluster grid, w is the light count
+    vec4 clusterParams;     // cluster tile size in pixels, depth slice scale and bias
 } ubo;
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-} push;
+// see PackedTransform in lve_game_object.h
+struct PackedTransform {
+    vec4 modelRows[3];
+    vec4 inverseScaleSquared;
+};
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    PackedTransform objects[];
+};
+// light indices picked per object, see SimpleRenderSystem::MAX_OBJECT_LIGHTS
+layout(std430, set = 1, binding = 1) readonly buffer ObjectLightBuffer {
+    uvec4 objectLights[];
+};
+
+// the depth pre-pass computes the same position, keep it bit-identical for the EQUAL test
+invariant gl_Position;
 
 void main() {
+    // firstInstance of each draw is the offset of its run in the object buffer
+    PackedTransform object = objects[gl_InstanceIndex];
+
+    vec4 positionModel = vec4(position, 1.0);
+    vec4 positionWorld = vec4(
+        dot(object.modelRows[0], positionModel),
+        dot(object.modelRows[1], positionModel),
+        dot(object.modelRows[2], positionModel),
+        1.0);
+    gl_Position = ubo.projectionMatrix *  ubo.viewMatrix * positionWorld;
 
-    vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);    
-    gl_Position = ubo.projectionMatrix *  ubo.viewMatrix * positionWorld;    
-    fragNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+    vec3 scaledNormal = normal * object.inverseScaleSquared.xyz;
+    fragNormalWorld = normalize(vec3(
+        dot(object.modelRows[0].xyz, scaledNormal),
+        dot(object.modelRows[1].xyz, scaledNormal),
+        dot(object.modelRows[2].xyz, scaledNormal)));
     fragPosWorld = positionWorld.xyz;
     fragColor = color;
+    fragObjectLights = objectLights[gl_InstanceIndex];
 }
\ No newline at end of file
@@ -0,0 +1,608 @@
+#include "gpu_driven_render_system.h"
+
+#include "lve_gpu_profiler.h"
+#include "lve_swap_chain.h"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace lve {
+
+	// std140, padded to the block size
+	struct CullUniforms {
+		glm::mat4 view;
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 projection;
+		glm::vec2 depthSize;
+		uint32_t pyramidLevels;
+		uint32_t objectCount;
+		uint32_t compact;
+		uint32_t padding[3];
+	};
+
+	struct CullPushConstants {
+		uint32_t phase;
+	};
+
+	struct CullStatsData {
+		uint32_t frustumCulled;
+		uint32_t occlusionCulled;
+		uint32_t drawn[2];
+	};
+
+	GpuDrivenRenderSystem::GpuDrivenRenderSystem(
+		LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+		const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout)
+		: _lveDevice{ device }, _target{ target }, _pipelineCache{ pipelineCompiler.getPipelineCache() },
+		// a compacted list is drawn in one call, which takes multiDrawIndirect
+		_compactDraws{ device.features().drawIndirectCount && device.features().multiDrawIndirect },
+		_maxDrawsPerCall{ device.features().multiDrawIndirect
+			? std::max(device.properties.limits.maxDrawIndirectCount, 1u) : 1u }
+	{
+		if (!_lveDevice.features().drawIndirectFirstInstance) {
+			throw std::runtime_error("GPU-driven rendering requires drawIndirectFirstInstance.");
+		}
+
+		_frames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		createDescriptorResources();
+		createPipelineLayouts(globalSetLayout);
+		createPipelines(pipelineCompiler);
+		_depthPyramid = std::make_unique<LveDepthPyramid>(_lveDevice, _pipelineCache);
+	}
+
+	GpuDrivenRenderSystem::~GpuDrivenRenderSystem() {
+		if (_hotReloader != nullptr) {
+			_hotReloader->unwatchPipeline(_lvePipeline);
+			_hotReloader->unwatchComputePipeline(_cullPipeline);
+		}
+		_lvePipeline.reset();
+		_cullPipeline.reset();
+		_depthPyramid.reset();
+		vkDestroyPipelineLayout(_lveDevice.device(), _pipelineLayout, nullptr);
+		vkDestroyPipelineLayout(_lveDevice.device(), _cullPipelineLayout, nullptr);
+	}
+
+	void GpuDrivenRenderSystem::createDescriptorResources()
+	{
+		// set 0 of the cull pipeline and set 1 of the graphics pipeline, one set serves both
+		_cullSetLayout = LveDescriptorSetLayout::Builder(_lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		_descriptorPool = LveDescriptorPool::Builder(_lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		for (auto& frame : _frames) {
+			if (!_descriptorPool->allocateDescriptorSet(_cullSetLayout->getDescriptorSetLayout(), frame.descriptorSet)) {
+				throw std::runtime_error("Failed to allocate GPU-driven descriptor set.");
+			}
+
+			// the count buffer never grows, it only holds the atomic draw counter of each list
+			frame.drawCountBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(uint32_t), 2,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+			frame.uniformBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(CullUniforms), 1,
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.uniformBuffer->map();
+
+			// written with atomics and read on the host once the frame's fence signalled
+			frame.statsBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(CullStatsData), 1,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.statsBuffer->map();
+		}
+	}
+
+	void GpuDrivenRenderSystem::createPipelineLayouts(VkDescriptorSetLayout globalSetLayout)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(CullPushConstants);
+
+		VkDescriptorSetLayout cullSetLayout = _cullSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo cullLayoutInfo{};
+		cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		cullLayoutInfo.setLayoutCount = 1;
+		cullLayoutInfo.pSetLayouts = &cullSetLayout;
+		cullLayoutInfo.pushConstantRangeCount = 1;
+		cullLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(_lveDevice.device(), &cullLayoutInfo, nullptr,
+			&_cullPipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout.");
+		}
+
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, cullSetLayout };
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+		if (vkCreatePipelineLayout(_lveDevice.device(), &pipelineLayoutInfo, nullptr,
+			&_pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create pipeline layout.");
+		}
+	}
+
+	void GpuDrivenRenderSystem::createPipelines(LvePipelineCompiler& pipelineCompiler)
+	{
+		assert(_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout.");
+
+		_lvePipeline = pipelineCompiler.submit(
+			"shaders/gpu_driven.vert.spv", "shaders/simple_shader.frag.spv", makePipelineConfig());
+		_cullPipeline = makeCullPipeline();
+	}
+
+	std::unique_ptr<PipelineConfigInfo> GpuDrivenRenderSystem::makePipelineConfig() const
+	{
+		auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+		LvePipeline::defaultPipelineConfigInfo(*pipelineConfig);
+		LvePipeline::setTarget(*pipelineConfig, _target);
+		pipelineConfig->pipelineLayout = _pipelineLayout;
+		return pipelineConfig;
+	}
+
+	std::unique_ptr<LveComputePipeline> GpuDrivenRenderSystem::makeCullPipeline() const
+	{
+		return std::make_unique<LveComputePipeline>(
+			_lveDevice, "shaders/gpu_cull.comp.spv", _cullPipelineLayout,
+			LveSpecializationConstants{}, _pipelineCache);
+	}
+
+	void GpuDrivenRenderSystem::watchShaders(LveShaderHotReloader& hotReloader)
+	{
+		_hotReloader = &hotReloader;
+		hotReloader.watchPipeline(_lvePipeline,
+			"shaders/gpu_driven.vert.spv", "shaders/simple_shader.frag.spv",
+			[this]() { return makePipelineConfig(); });
+		hotReloader.watchComputePipeline(_cullPipeline, "shaders/gpu_cull.comp.spv",
+			[this]() { return makeCullPipeline(); });
+	}
+
+	void GpuDrivenRenderSystem::rebuildMeshPool(LveGameObject::Map& gameObjects, VkCommandBuffer commandBuffer)
+	{
+		std::vector<LveModel*> models;
+		std::unordered_map<LveModel::id_t, uint32_t> meshIndices;
+		uint32_t vertexCount = 0;
+		uint32_t indexCount = 0;
+		for (auto& kv : gameObjects) {
+			LveModel* model = kv.second.model.get();
+			if (model == nullptr || meshIndices.count(model->getId()) != 0) continue;
+
+			assert(model->hasIndices() && "GPU-driven rendering only supports indexed models.");
+			meshIndices.emplace(model->getId(), static_cast<uint32_t>(models.size()));
+			models.push_back(model);
+			vertexCount += model->getVertexCount();
+			indexCount += model->getIndexCount();
+		}
+		if (models.empty()) return;
+
+		// the frames in flight keep drawing from the old pool
+		retire(std::move(_positionBuffer));
+		retire(std::move(_attributeBuffer));
+		retire(std::move(_indexBuffer));
+		retire(std::move(_meshBuffer));
+
+		_positionBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(glm::vec3), vertexCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		_attributeBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(LveModel::VertexAttributes), vertexCount,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		_indexBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(uint32_t), indexCount,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// copied in this frame's command buffer, ahead of its draws
+		std::vector<MeshData> meshes;
+		uint32_t firstVertex = 0;
+		uint32_t firstIndex = 0;
+		for (LveModel* model : models) {
+			VkBufferCopy positionRegion{ 0, sizeof(glm::vec3) * firstVertex, sizeof(glm::vec3) * model->getVertexCount() };
+			vkCmdCopyBuffer(commandBuffer, model->getPositionBuffer(), _positionBuffer->getBuffer(), 1, &positionRegion);
+			VkBufferCopy attributeRegion{ 0, sizeof(LveModel::VertexAttributes) * firstVertex,
+				sizeof(LveModel::VertexAttributes) * model->getVertexCount() };
+			vkCmdCopyBuffer(commandBuffer, model->getAttributeBuffer(), _attributeBuffer->getBuffer(), 1, &attributeRegion);
+			VkBufferCopy indexRegion{ 0, sizeof(uint32_t) * firstIndex, sizeof(uint32_t) * model->getIndexCount() };
+			vkCmdCopyBuffer(commandBuffer, model->getIndexBuffer(), _indexBuffer->getBuffer(), 1, &indexRegion);
+
+			meshes.push_back({ model->getIndexCount(), firstIndex, static_cast<int32_t>(firstVertex) });
+			firstVertex += model->getVertexCount();
+			firstIndex += model->getIndexCount();
+		}
+
+		VkMemoryBarrier copyBarrier{};
+		copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		copyBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+
+		_meshBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(MeshData), static_cast<uint32_t>(meshes.size()),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		_meshBuffer->map();
+		_meshBuffer->writeToBuffer(meshes.data());
+
+		_meshIndices = std::move(meshIndices);
+		for (auto& frame : _frames) {
+			frame.descriptorsDirty = true;
+		}
+	}
+
+	void GpuDrivenRenderSystem::retire(std::unique_ptr<LveBuffer> buffer)
+	{
+		if (buffer != nullptr) {
+			_retiredBuffers.push_back({ std::move(buffer), _frameNumber + LveSwapChain::MAX_FRAMES_IN_FLIGHT });
+		}
+	}
+
+	void GpuDrivenRenderSystem::ensureFrameCapacity(FrameResources& frame, uint32_t objectCount)
+	{
+		// the fence for this frame index was waited on in beginFrame, so its old buffers are free
+		if (frame.objectBuffer != nullptr && frame.objectBuffer->getInstanceCount() >= objectCount) {
+			return;
+		}
+
+		uint32_t capacity = frame.objectBuffer == nullptr ? 1024 : frame.objectBuffer->getInstanceCount();
+		while (capacity < objectCount) {
+			capacity *= 2;
+		}
+
+		frame.objectBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(ObjectData), capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.objectBuffer->map();
+
+		frame.drawBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(VkDrawIndexedIndirectCommand), 2 * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// both draw counts followed by both draw lists
+		frame.readbackBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, 1,
+			static_cast<uint32_t>(2 * sizeof(uint32_t) + 2 * sizeof(VkDrawIndexedIndirectCommand) * capacity),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		frame.readbackBuffer->map();
+		std::memset(frame.readbackBuffer->getMappedMemory(), 0, 2 * sizeof(uint32_t));
+		frame.readbackDrawCount = 0;
+
+		frame.descriptorsDirty = true;
+	}
+
+	void GpuDrivenRenderSystem::ensureVisibilityCapacity(uint32_t objectCount)
+	{
+		if (_visibilityBuffer != nullptr && _visibilityBuffer->getInstanceCount() >= objectCount) {
+			return;
+		}
+
+		uint32_t capacity = _visibilityBuffer == nullptr ? 1024 : _visibilityBuffer->getInstanceCount();
+		while (capacity < objectCount) {
+			capacity *= 2;
+		}
+
+		// every frame in flight uses it, same as the mesh pool
+		retire(std::move(_visibilityBuffer));
+		_visibilityBuffer = std::make_unique<LveBuffer>(
+			_lveDevice, sizeof(uint32_t), capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		_visibilityValid = false;
+		for (auto& frame : _frames) {
+			frame.descriptorsDirty = true;
+		}
+	}
+
+	void GpuDrivenRenderSystem::setDepthTargets(VkExtent2D depthExtent, const std::vector<VkImageView>& depthViews)
+	{
+		_depthPyramid->resize(depthExtent, depthViews);
+		for (auto& frame : _frames) {
+			frame.descriptorsDirty = true;
+		}
+	}
+
+	void GpuDrivenRenderSystem::writeDescriptors(FrameResources& frame)
+	{
+		auto objectInfo = frame.objectBuffer->descriptorInfo();
+		auto meshInfo = _meshBuffer->descriptorInfo();
+		auto drawInfo = frame.drawBuffer->descriptorInfo();
+		auto drawCountInfo = frame.drawCountBuffer->descriptorInfo();
+		auto visibilityInfo = _visibilityBuffer->descriptorInfo();
+		auto pyramidInfo = _depthPyramid->descriptorInfo();
+		auto uniformInfo = frame.uniformBuffer->descriptorInfo();
+		auto statsInfo = frame.statsBuffer->descriptorInfo();
+		LveDescriptorWriter(*_cullSetLayout, *_descriptorPool)
+			.writeBuffer(0, &objectInfo)
+			.writeBuffer(1, &meshInfo)
+			.writeBuffer(2, &drawInfo)
+			.writeBuffer(3, &drawCountInfo)
+			.writeBuffer(4, &visibilityInfo)
+			.writeImage(5, &pyramidInfo)
+			.writeBuffer(6, &uniformInfo)
+			.writeBuffer(7, &statsInfo)
+			.overwrite(frame.descriptorSet);
+		frame.descriptorsDirty = false;
+	}
+
+	void GpuDrivenRenderSystem::cull(FrameInfo& frameInfo)
+	{
+		// called once per frame after its fence, the frames that used a retired buffer are complete
+		_frameNumber++;
+		_retiredBuffers.erase(
+			std::remove_if(_retiredBuffers.begin(), _retiredBuffers.end(),
+				[this](const RetiredBuffer& retired) { return retired.destroyAfterFrame <= _frameNumber; }),
+			_retiredBuffers.end());
+		_drawCallCount = 0;
+
+		uint32_t objectCount = 0;
+		bool meshPoolStale = false;
+		for (auto& kv : frameInfo.gameObjects) {
+			LveModel* model = kv.second.model.get();
+			if (model == nullptr) continue;
+			objectCount++;
+			meshPoolStale = meshPoolStale || _meshIndices.count(model->getId()) == 0;
+		}
+		if (meshPoolStale) {
+			rebuildMeshPool(frameInfo.gameObjects, frameInfo.commandBuffer);
+		}
+
+		_objectCount = objectCount;
+		_frames[frameInfo.frameIndex].statsObjectCount = objectCount;
+		if (objectCount == 0) return;
+
+		assert(_depthPyramid->isCreated() && "Call setDepthTargets before culling.");
+		bool occlusionCulling = isOcclusionCullingEnabled();
+
+		auto& frame = _frames[frameInfo.frameIndex];
+		ensureFrameCapacity(frame, objectCount);
+		ensureVisibilityCapacity(objectCount);
+		if (frame.descriptorsDirty) {
+			writeDescriptors(frame);
+		}
+
+		auto* objects = static_cast<ObjectData*>(frame.objectBuffer->getMappedMemory());
+		uint32_t objectIndex = 0;
+		for (auto& kv : frameInfo.gameObjects) {
+			auto& obj = kv.second;
+			if (obj.model == nullptr) continue;
+
+			ObjectData& object = objects[objectIndex++];
+			object.transform = obj.transform.packed();
+			object.boundingSphere = obj.model->getBoundingSphere();
+			object.meshIndex = _meshIndices.at(obj.model->getId());
+		}
+
+		CullUniforms uniforms{};
+		const glm::mat4& projection = frameInfo.camera.getProjection();
+		LveFrustum frustum = frameInfo.camera.getFrustum();
+		std::copy(std::begin(frustum.planes), std::end(frustum.planes), std::begin(uniforms.frustumPlanes));
+		uniforms.view = frameInfo.camera.getView();
+		uniforms.projection = { projection[0][0], projection[1][1], projection[2][2], projection[3][2] };
+		uniforms.depthSize = {
+			static_cast<float>(_depthPyramid->getDepthExtent().width),
+			static_cast<float>(_depthPyramid->getDepthExtent().height) };
+		uniforms.pyramidLevels = _depthPyramid->getLevelCount();
+		uniforms.objectCount = objectCount;
+		// past the draw count limit the list keeps every slot and is drawn in several calls
+		frame.compact = _compactDraws && objectCount <= _maxDrawsPerCall;
+		uniforms.compact = frame.compact ? 1 : 0;
+		frame.uniformBuffer->writeToBuffer(&uniforms);
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		LveGpuScope gpuScope{ frameInfo.gpuProfiler, commandBuffer, "GPU cull" };
+
+		// last frame's late phase wrote the visibility buffer
+		VkMemoryBarrier visibilityBarrier{};
+		visibilityBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		visibilityBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		visibilityBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &visibilityBarrier, 0, nullptr, 0, nullptr);
+
+		// a changed object set reorders the objects, start over with everything drawn late
+		if (occlusionCulling && (!_visibilityValid || _visibilityObjectCount != objectCount)) {
+			vkCmdFillBuffer(commandBuffer, _visibilityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+			_visibilityObjectCount = objectCount;
+		}
+		_visibilityValid = occlusionCulling;
+
+		vkCmdFillBuffer(commandBuffer, frame.drawCountBuffer->getBuffer(), 0, 2 * sizeof(uint32_t), 0);
+		vkCmdFillBuffer(commandBuffer, frame.statsBuffer->getBuffer(), 0, sizeof(CullStatsData), 0);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		dispatchCull(frameInfo, occlusionCulling ? CULL_PHASE_EARLY : CULL_PHASE_FRUSTUM);
+		if (!occlusionCulling && _readbackEnabled) {
+			recordReadback(frame, commandBuffer, 1);
+		}
+	}
+
+	void GpuDrivenRenderSystem::cullOccluded(FrameInfo& frameInfo, uint32_t imageIndex)
+	{
+		if (_objectCount == 0 || !isOcclusionCullingEnabled()) return;
+
+		auto& frame = _frames[frameInfo.frameIndex];
+		LveGpuScope gpuScope{ frameInfo.gpuProfiler, frameInfo.commandBuffer, "occlusion cull" };
+		_depthPyramid->build(frameInfo.commandBuffer, imageIndex);
+		dispatchCull(frameInfo, CULL_PHASE_LATE);
+		if (_readbackEnabled) {
+			recordReadback(frame, frameInfo.commandBuffer, 2);
+		}
+	}
+
+	void GpuDrivenRenderSystem::dispatchCull(FrameInfo& frameInfo, CullPhase phase)
+	{
+		auto& frame = _frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		CullPushConstants push{};
+		push.phase = phase;
+
+		_cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+			_cullPipelineLayout, 0, 1, &frame.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT,
+			0, sizeof(CullPushConstants), &push);
+		vkCmdDispatch(commandBuffer, LveComputePipeline::groupCount(_objectCount, CULL_LOCAL_SIZE), 1, 1);
+
+		// the stats are read on the host after the frame's fence
+		VkMemoryBarrier cullBarrier{};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask =
+			VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GpuDrivenRenderSystem::recordReadback(
+		FrameResources& frame, VkCommandBuffer commandBuffer, uint32_t listCount)
+	{
+		std::array<VkBufferCopy, 1> countRegion{ VkBufferCopy{ 0, 0, 2 * sizeof(uint32_t) } };
+		std::array<VkBufferCopy, 1> drawRegion{ VkBufferCopy{
+			0, 2 * sizeof(uint32_t), sizeof(VkDrawIndexedIndirectCommand) * listCount * _objectCount } };
+		vkCmdCopyBuffer(commandBuffer, frame.drawCountBuffer->getBuffer(),
+			frame.readbackBuffer->getBuffer(), 1, countRegion.data());
+		vkCmdCopyBuffer(commandBuffer, frame.drawBuffer->getBuffer(),
+			frame.readbackBuffer->getBuffer(), 1, drawRegion.data());
+		frame.readbackDrawCount = _objectCount;
+		frame.readbackListCount = listCount;
+	}
+
+	std::vector<VkDrawIndexedIndirectCommand> GpuDrivenRenderSystem::readBackDrawList(int frameIndex)
+	{
+		auto& frame = _frames[frameIndex];
+		if (frame.readbackBuffer == nullptr || frame.readbackDrawCount == 0) return {};
+
+		auto* mapped = static_cast<const uint8_t*>(frame.readbackBuffer->getMappedMemory());
+		const uint8_t* lists = mapped + 2 * sizeof(uint32_t);
+		const size_t listSize = sizeof(VkDrawIndexedIndirectCommand) * frame.readbackDrawCount;
+
+		std::vector<VkDrawIndexedIndirectCommand> draws;
+		for (uint32_t list = 0; list < frame.readbackListCount; ++list) {
+			uint32_t drawCount = frame.readbackDrawCount;
+			if (frame.compact) {
+				std::memcpy(&drawCount, mapped + list * sizeof(uint32_t), sizeof(uint32_t));
+				drawCount = std::min(drawCount, frame.readbackDrawCount);
+			}
+
+			size_t first = draws.size();
+			draws.resize(first + drawCount);
+			std::memcpy(draws.data() + first, lists + list * listSize, sizeof(VkDrawIndexedIndirectCommand) * drawCount);
+		}
+		return draws;
+	}
+
+	GpuDrivenRenderSystem::CullStats GpuDrivenRenderSystem::readBackCullStats(int frameIndex)
+	{
+		auto& frame = _frames[frameIndex];
+		if (frame.statsObjectCount == 0) return {};
+
+		CullStatsData data{};
+		std::memcpy(&data, frame.statsBuffer->getMappedMemory(), sizeof(CullStatsData));
+
+		CullStats stats{};
+		stats.tested = frame.statsObjectCount;
+		stats.frustumCulled = data.frustumCulled;
+		stats.occlusionCulled = data.occlusionCulled;
+		stats.drawnEarly = data.drawn[0];
+		stats.drawnLate = data.drawn[1];
+		return stats;
+	}
+
+	void GpuDrivenRenderSystem::renderGameObjects(FrameInfo& frameInfo)
+	{
+		drawList(frameInfo, 0);
+	}
+
+	void GpuDrivenRenderSystem::renderOccludedObjects(FrameInfo& frameInfo)
+	{
+		if (!isOcclusionCullingEnabled()) return;
+		drawList(frameInfo, 1);
+	}
+
+	void GpuDrivenRenderSystem::drawList(FrameInfo& frameInfo, uint32_t list)
+	{
+		if (_objectCount == 0) return;
+
+		auto& frame = _frames[frameInfo.frameIndex];
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		_lvePipeline.wait().bind(commandBuffer);
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.globalDescriptorSet, frame.descriptorSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout,
+			0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+
+		VkBuffer vertexBuffers[] = { _positionBuffer->getBuffer(), _attributeBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0, 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, _indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const VkDeviceSize listOffset = static_cast<VkDeviceSize>(list) * _objectCount * stride;
+		if (frame.compact) {
+			_lveDevice.functions().cmdDrawIndexedIndirectCount(commandBuffer,
+				frame.drawBuffer->getBuffer(), listOffset,
+				frame.drawCountBuffer->getBuffer(), list * sizeof(uint32_t), _objectCount, stride);
+			_drawCallCount++;
+		}
+		else {
+			// culled objects were written with instanceCount 0
+			for (uint32_t first = 0; first < _objectCount; first += _maxDrawsPerCall) {
+				uint32_t drawCount = std::min(_objectCount - first, _maxDrawsPerCall);
+				vkCmdDrawIndexedIndirect(commandBuffer, frame.drawBuffer->getBuffer(),
+					listOffset + static_cast<VkDeviceSize>(first) * stride, drawCount, stride);
+				_drawCallCount++;
+			}
+		}
+	}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "lve_device.h"
+#include "lve_buffer.h"
+#include "lve_camera.h"
+#include "lve_compute_pipeline.h"
+#include "lve_depth_pyramid.h"
+#include "lve_descriptors.h"
+#include "lve_game_object.h"
+#include "lve_model.h"
+#include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_shader_hot_reload.h"
+#include "lve_frame_info.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+	// Renders every object with a model through one indirect draw. Transforms, bounds and mesh
+	// ranges live in storage buffers, a compute pass culls them against the camera frustum and
+	// writes the draw commands, so recording cost does not grow with the object count.
+	// Render states are ignored, all objects use the default state.
+	//
+	// With occlusion culling the frame is drawn in two phases. Objects visible last frame are drawn
+	// first, a depth pyramid is built from the result and everything else inside the frustum is
+	// tested against it, so only objects that became visible are drawn in the second phase.
+	class GpuDrivenRenderSystem {
+	public:
+		static constexpr uint32_t CULL_LOCAL_SIZE = 64;
+
+		// keep in sync with gpu_cull.comp
+		enum CullPhase {
+			CULL_PHASE_FRUSTUM = 0,
+			CULL_PHASE_EARLY = 1,
+			CULL_PHASE_LATE = 2,
+		};
+
+		// Counted on the GPU, drawnLate is only non-zero with occlusion culling. 64-bit so the
+		// counts of many frames can be summed.
+		struct CullStats {
+			uint64_t tested = 0;
+			uint64_t frustumCulled = 0;
+			uint64_t occlusionCulled = 0;
+			uint64_t drawnEarly = 0;
+			uint64_t drawnLate = 0;
+		};
+
+		GpuDrivenRenderSystem(LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+			const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout);
+		~GpuDrivenRenderSystem();
+
+		GpuDrivenRenderSystem(const GpuDrivenRenderSystem&) = delete;
+		GpuDrivenRenderSystem& operator=(const GpuDrivenRenderSystem&) = delete;
+
+		// Rebuilds the draw and cull pipelines when their shaders change. The reloader must stay
+		// alive until the system is destroyed.
+		void watchShaders(LveShaderHotReloader& hotReloader);
+
+		// The depth attachments the pyramid is built from, one view per swap chain image. Call before
+		// the first cull and whenever the swap chain was recreated. Without views (depth that cannot
+		// be sampled) occlusion culling stays off.
+		void setDepthTargets(VkExtent2D depthExtent, const std::vector<VkImageView>& depthViews);
+
+		void setOcclusionCullingEnabled(bool enabled) { _occlusionCulling = enabled; }
+		bool isOcclusionCullingEnabled() const { return _occlusionCulling && _depthPyramid->canBuild(); }
+
+		// Uploads objects and records the culling dispatch, call before the render pass begins.
+		// With occlusion culling this is the early phase.
+		void cull(FrameInfo& frameInfo);
+		void renderGameObjects(FrameInfo& frameInfo);
+
+		// Late phase, call between the early and late render passes. Builds the depth pyramid from
+		// the depth attachment of imageIndex and culls against it.
+		void cullOccluded(FrameInfo& frameInfo, uint32_t imageIndex);
+		void renderOccludedObjects(FrameInfo& frameInfo);
+
+		// Copies the compacted draw list of each frame to host memory for inspection.
+		void setReadbackEnabled(bool enabled) { _readbackEnabled = enabled; }
+		// Draw list written by the last completed frame with this index, call after beginFrame.
+		std::vector<VkDrawIndexedIndirectCommand> readBackDrawList(int frameIndex);
+		// Counts of the last completed frame with this index, call after beginFrame.
+		CullStats readBackCullStats(int frameIndex);
+
+		uint32_t getObjectCount() const { return _objectCount; }
+		// indirect draw calls recorded since the last cull
+		uint32_t getDrawCallCount() const { return _drawCallCount.load(); }
+
+	private:
+		struct ObjectData {
+			PackedTransform transform;
+			glm::vec4 boundingSphere{ 0.f };
+			uint32_t meshIndex = 0;
+			uint32_t padding[3]{};
+		};
+
+		struct MeshData {
+			uint32_t indexCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+		};
+
+		struct FrameResources {
+			std::unique_ptr<LveBuffer> objectBuffer;
+			// the early (or only) draw list followed by the late one
+			std::unique_ptr<LveBuffer> drawBuffer;
+			std::unique_ptr<LveBuffer> drawCountBuffer;
+			std::unique_ptr<LveBuffer> readbackBuffer;
+			std::unique_ptr<LveBuffer> uniformBuffer;
+			std::unique_ptr<LveBuffer> statsBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+			uint32_t readbackDrawCount = 0;
+			uint32_t readbackListCount = 0;
+			uint32_t statsObjectCount = 0;
+			// the cull compacted the draw lists, their lengths are in drawCountBuffer
+			bool compact = false;
+			bool descriptorsDirty = true;
+		};
+
+		struct RetiredBuffer {
+			std::unique_ptr<LveBuffer> buffer;
+			uint64_t destroyAfterFrame;
+		};
+
+		void createDescriptorResources();
+		void createPipelineLayouts(VkDescriptorSetLayout globalSetLayout);
+		void createPipelines(LvePipelineCompiler& pipelineCompiler);
+		std::unique_ptr<PipelineConfigInfo> makePipelineConfig() const;
+		std::unique_ptr<LveComputePipeline> makeCullPipeline() const;
+		void rebuildMeshPool(LveGameObject::Map& gameObjects, VkCommandBuffer commandBuffer);
+		void retire(std::unique_ptr<LveBuffer> buffer);
+		void ensureFrameCapacity(FrameResources& frame, uint32_t objectCount);
+		void ensureVisibilityCapacity(uint32_t objectCount);
+		void writeDescriptors(FrameResources& frame);
+		void dispatchCull(FrameInfo& frameInfo, CullPhase phase);
+		void recordReadback(FrameResources& frame, VkCommandBuffer commandBuffer, uint32_t listCount);
+		void drawList(FrameInfo& frameInfo, uint32_t list);
+
+		LveDevice& _lveDevice;
+		LvePipelineTarget _target;
+		VkPipelineCache _pipelineCache;
+		LveShaderHotReloader* _hotReloader = nullptr;
+		bool _compactDraws;
+		// maxDrawIndirectCount, 1 without multiDrawIndirect
+		uint32_t _maxDrawsPerCall;
+
+		std::unique_ptr<LveDescriptorSetLayout> _cullSetLayout;
+		std::unique_ptr<LveDescriptorPool> _descriptorPool;
+		std::vector<FrameResources> _frames;
+		// replaced buffers the frames in flight may still read
+		std::vector<RetiredBuffer> _retiredBuffers;
+		uint64_t _frameNumber = 0;
+
+		// every model referenced by the scene, merged so one draw can reach all of them
+		std::unordered_map<LveModel::id_t, uint32_t> _meshIndices;
+		std::unique_ptr<LveBuffer> _positionBuffer;
+		std::unique_ptr<LveBuffer> _attributeBuffer;
+		std::unique_ptr<LveBuffer> _indexBuffer;
+		std::unique_ptr<LveBuffer> _meshBuffer;
+
+		uint32_t _objectCount = 0;
+		// the late list may be recorded on a worker thread
+		std::atomic<uint32_t> _drawCallCount{ 0 };
+		bool _readbackEnabled = false;
+
+		// shared by all frames in flight, each frame's late phase feeds the next frame's early one
+		std::unique_ptr<LveDepthPyramid> _depthPyramid;
+		std::unique_ptr<LveBuffer> _visibilityBuffer;
+		uint32_t _visibilityObjectCount = 0;
+		bool _visibilityValid = false;
+		bool _occlusionCulling = false;
+
+		VkPipelineLayout _cullPipelineLayout;
+		VkPipelineLayout _pipelineLayout;
+		std::unique_ptr<LveComputePipeline> _cullPipeline;
+		LvePipelineHandle _lvePipeline;
+	};
+}
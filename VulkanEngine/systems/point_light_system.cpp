@@ -1,50 +1,66 @@
 #include "point_light_system.h"
 
+#include "lve_swap_chain.h"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
 #include <array>
+#include <cassert>
 #include <stdexcept>
 
 namespace lve {
 
-	struct PointLightPushConstants {
-		glm::vec4 position{};
-		glm::vec4 color{};
-		float radius;
-	};
-
 	PointLightSystem::PointLightSystem(
-		LveDevice& device, VkRenderPass renderPass,
-		VkDescriptorSetLayout globalSetLayout)
-		: _lveDevice{ device }
+		LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+		const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout)
+		: _lveDevice{ device }, _target{ target }
 	{
+		createBillboardDescriptors();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(pipelineCompiler);
 	}
 
 	PointLightSystem::~PointLightSystem() {
+		if (_hotReloader != nullptr) {
+			_hotReloader->unwatchPipeline(_lvePipeline);
+		}
+		_lvePipeline.reset();
 		vkDestroyPipelineLayout(_lveDevice.device(), _pipelineLayout, nullptr);
 	}
 
-	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void PointLightSystem::createBillboardDescriptors()
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(PointLightPushConstants);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout };
+		_billboardSetLayout = LveDescriptorSetLayout::Builder(_lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
+
+		_billboardPool = LveDescriptorPool::Builder(_lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		_billboardFrames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : _billboardFrames) {
+			if (!_billboardPool->allocateDescriptorSet(_billboardSetLayout->getDescriptorSetLayout(), frame.descriptorSet)) {
+				throw std::runtime_error("Failed to allocate billboard descriptor set.");
+			}
+		}
+	}
 
+	void PointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+			globalSetLayout, _billboardSetLayout->getDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
 		if (vkCreatePipelineLayout(_lveDevice.device(), &pipelineLayoutInfo, nullptr,
 			&_pipelineLayout) != VK_SUCCESS)
@@ -53,68 +69,127 @@ namespace lve {
 		}
 	}
 
-	void PointLightSystem::createPipeline(VkRenderPass renderPass)
+	void PointLightSystem::createPipeline(LvePipelineCompiler& pipelineCompiler)
 	{
 		assert(_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout.");
 
-		PipelineConfigInfo pipelineConfig{};
-		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.attributeDescription.clear();
-		pipelineConfig.bindingDescription.clear();
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.pipelineLayout = _pipelineLayout;
-		_lvePipeline = std::make_unique<LvePipeline>(_lveDevice,
-			"shaders/point_light_shader.vert.spv", "shaders/point_light_shader.frag.spv", pipelineConfig);
+		_lvePipeline = pipelineCompiler.submit(
+			"shaders/point_light_shader.vert.spv", "shaders/point_light_shader.frag.spv", makePipelineConfig());
 	}
 
-	void PointLightSystem::update(FrameInfo& frameInfo, GlobalUbo& ubo) {
+	std::unique_ptr<PipelineConfigInfo> PointLightSystem::makePipelineConfig() const
+	{
+		auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+		LvePipeline::defaultPipelineConfigInfo(*pipelineConfig);
+		pipelineConfig->attributeDescription.clear();
+		pipelineConfig->bindingDescription.clear();
+		LvePipeline::setTarget(*pipelineConfig, _target);
+		pipelineConfig->pipelineLayout = _pipelineLayout;
+		return pipelineConfig;
+	}
+
+	void PointLightSystem::watchShaders(LveShaderHotReloader& hotReloader)
+	{
+		_hotReloader = &hotReloader;
+		hotReloader.watchPipeline(_lvePipeline,
+			"shaders/point_light_shader.vert.spv", "shaders/point_light_shader.frag.spv",
+			[this]() { return makePipelineConfig(); });
+	}
+
+	void PointLightSystem::update(FrameInfo& frameInfo) {
 		auto rotateLight = glm::rotate(glm::mat4(1.f), frameInfo.frameTime, { 0.0f, -1.f, 0.0f });
 
-		int lightIndex = 0;
+		_lights.clear();
+		_lightRadii.clear();
 		for (auto& kv : frameInfo.gameObjects) {
 			auto& obj = kv.second;
 			if (obj.pointLight == nullptr) continue;
 
-			assert(lightIndex < MAX_LIGHTS && "Point lights exceed maximum specified.");
-
 			obj.transform.translation = glm::vec3(rotateLight * glm::vec4(obj.transform.translation, 1.f));
 
-			// copy light to ubo
-			ubo.pointLights[lightIndex].position = glm::vec4(obj.transform.translation, 1.0f);
-			ubo.pointLights[lightIndex].color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			lightIndex += 1;
+			PointLight light{};
+			light.position = glm::vec4(obj.transform.translation, obj.pointLight->range);
+			light.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
+			_lights.push_back(light);
+			_lightRadii.push_back(obj.transform.scale.x);
 		}
 
-		ubo.numLights = lightIndex;
+		if (_buildLightBvh) {
+			_lightBvh.build(_lights);
+		}
 	}
 
-	void PointLightSystem::render(FrameInfo& frameInfo)
+	PointLightSystem::BillboardFrame& PointLightSystem::getBillboardFrame(int frameIndex, uint32_t billboardCount)
 	{
-		_lvePipeline->bind(frameInfo.commandBuffer);
+		// the fence for this frame index was waited on in beginFrame, so the old buffer is free
+		auto& frame = _billboardFrames[frameIndex];
+		if (frame.billboardBuffer == nullptr || frame.billboardBuffer->getInstanceCount() < billboardCount) {
+			uint32_t capacity = frame.billboardBuffer == nullptr ? 64 : frame.billboardBuffer->getInstanceCount();
+			while (capacity < billboardCount) {
+				capacity *= 2;
+			}
+
+			frame.billboardBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(Billboard), capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.billboardBuffer->map();
+
+			auto bufferInfo = frame.billboardBuffer->descriptorInfo();
+			LveDescriptorWriter(*_billboardSetLayout, *_billboardPool)
+				.writeBuffer(0, &bufferInfo)
+				.overwrite(frame.descriptorSet);
+		}
+		return frame;
+	}
+
+	void PointLightSystem::submit(FrameInfo& frameInfo, LveDrawQueue& drawQueue)
+	{
+		_billboardCount = 0;
+
+		// light gizmos are optional, skip them until the worker has the pipeline ready
+		LvePipeline* pipeline = _lvePipeline.tryGet();
+		if (pipeline == nullptr || _lights.empty()) return;
+
+		// one sort of every billboard by camera depth, farthest first so blending composites in order
+		const glm::mat4& view = frameInfo.camera.getView();
+		_sortPackets.clear();
+		for (uint32_t i = 0; i < _lights.size(); ++i) {
+			float viewDepth = (view * glm::vec4(glm::vec3(_lights[i].position), 1.f)).z;
+			_sortPackets.push_back({ LveDrawQueue::quantizeDepthBackToFront(viewDepth), i });
+		}
+		LveDrawQueue::radixSort(_sortPackets, _sortScratch);
+
+		uint32_t billboardCount = static_cast<uint32_t>(_sortPackets.size());
+		_frameBillboards = &getBillboardFrame(frameInfo.frameIndex, billboardCount);
+		auto* billboards = static_cast<Billboard*>(_frameBillboards->billboardBuffer->getMappedMemory());
+		for (uint32_t i = 0; i < billboardCount; ++i) {
+			uint32_t light = _sortPackets[i].payload;
+			billboards[i].position = glm::vec4(glm::vec3(_lights[light].position), _lightRadii[light]);
+			billboards[i].color = _lights[light].color;
+		}
+		_billboardCount = billboardCount;
 
+		// every billboard in one packet, the order within it is the sort above
+		uint32_t pipelineSlot = drawQueue.pipelineSlot(*pipeline, *this);
+		drawQueue.submit(LveDrawQueue::makeKey(
+			LveDrawQueue::PASS_LIGHTS, pipelineSlot, 0, LveDrawQueue::NO_MODEL, 0), 0);
+	}
+
+	void PointLightSystem::onPipelineBound(FrameInfo& frameInfo)
+	{
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.globalDescriptorSet, _frameBillboards->descriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			_pipelineLayout,
-			0, 1, &frameInfo.globalDescriptorSet,
+			0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
 			0, nullptr);
+	}
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.pointLight == nullptr) continue;
-
-			PointLightPushConstants push{};
-			push.position = glm::vec4(obj.transform.translation, 1.0f);
-			push.color = glm::vec4(obj.color, obj.pointLight->lightIntensity);
-			push.radius = obj.transform.scale.x;
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				_pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0, sizeof(PointLightPushConstants), &push
-			);
-
-			vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
-		}
+	void PointLightSystem::drawPackets(FrameInfo& frameInfo, const LveDrawRun& run)
+	{
+		// the only packet stands for every billboard, drawn as one instance each in sorted order
+		assert(run.count == 1 && "Light billboards are submitted as a single packet.");
+		vkCmdDraw(frameInfo.commandBuffer, 6, _billboardCount, 0, 0);
 	}
 }
\ No newline at end of file
@@ -1,34 +1,87 @@
 #pragma once
 
 #include "lve_device.h"
+#include "lve_buffer.h"
 #include "lve_camera.h"
+#include "lve_descriptors.h"
+#include "lve_draw_queue.h"
 #include "lve_game_object.h"
 #include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_shader_hot_reload.h"
 #include "lve_frame_info.h"
+#include "lve_light_bvh.h"
 
 #include <memory>
 #include <vector>
 
 namespace lve {
-	class PointLightSystem {
+	class PointLightSystem : public LveDrawQueueClient {
 	public:
-		PointLightSystem(LveDevice& device, VkRenderPass renderPass,
-			VkDescriptorSetLayout globalSetLayout);
+		PointLightSystem(LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+			const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout);
 		~PointLightSystem();
 
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-		void update(FrameInfo& info, GlobalUbo& ubo);
-		void render(FrameInfo& frameInfo);
+		// Moves the lights and gathers them for LveLightClusters, and into the light BVH when enabled.
+		void update(FrameInfo& info);
+		const std::vector<PointLight>& getLights() const { return _lights; }
+
+		void setLightBvhEnabled(bool enabled) { _buildLightBvh = enabled; }
+		// Null unless enabled, rebuilt by update.
+		LveLightBvh* getLightBvh() { return _buildLightBvh ? &_lightBvh : nullptr; }
+		// Sorts the light billboards back to front into this frame's billboard buffer and queues
+		// them as one instanced draw after the opaque pass.
+		void submit(FrameInfo& frameInfo, LveDrawQueue& drawQueue);
+
+		void onPipelineBound(FrameInfo& frameInfo) override;
+		void drawPackets(FrameInfo& frameInfo, const LveDrawRun& run) override;
+
+		// The reloader must stay alive until the system is destroyed.
+		void watchShaders(LveShaderHotReloader& hotReloader);
 
 	private:
+		// element of the billboard buffer, read by point_light_shader.vert through gl_InstanceIndex
+		struct Billboard {
+			glm::vec4 position{};	// w is radius
+			glm::vec4 color{};	// w is intensity
+		};
+
+		// one buffer per frame in flight so a frame never overwrites in-flight billboards
+		struct BillboardFrame {
+			std::unique_ptr<LveBuffer> billboardBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+		BillboardFrame& getBillboardFrame(int frameIndex, uint32_t billboardCount);
+
+		void createBillboardDescriptors();
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(LvePipelineCompiler& pipelineCompiler);
+		std::unique_ptr<PipelineConfigInfo> makePipelineConfig() const;
 
 		LveDevice& _lveDevice;
+		LvePipelineTarget _target;
 
-		std::unique_ptr<LvePipeline> _lvePipeline;
+		LvePipelineHandle _lvePipeline;
 		VkPipelineLayout _pipelineLayout;
+		LveShaderHotReloader* _hotReloader = nullptr;
+
+		std::unique_ptr<LveDescriptorSetLayout> _billboardSetLayout;
+		std::unique_ptr<LveDescriptorPool> _billboardPool;
+		std::vector<BillboardFrame> _billboardFrames;
+		// set by submit, read by the recording threads
+		BillboardFrame* _frameBillboards = nullptr;
+		uint32_t _billboardCount = 0;
+
+		// rebuilt by update, billboard radii are parallel to the lights
+		std::vector<PointLight> _lights;
+		std::vector<float> _lightRadii;
+		LveLightBvh _lightBvh;
+		bool _buildLightBvh = false;
+		// per-frame sort scratch, kept to reuse its capacity
+		std::vector<LveDrawPacket> _sortPackets;
+		std::vector<LveDrawPacket> _sortScratch;
 	};
 }
\ No newline at end of file
@@ -1,48 +1,99 @@
 #include "simple_render_system.h"
 
+#include "lve_swap_chain.h"
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <algorithm>
 #include <array>
 #include <stdexcept>
 
 namespace lve {
 
-	struct SimplePushConstantData {
-		glm::mat4 modelMatrix{ 1.f };
-		glm::mat4 normalMatrix{ 1.f };
-	};
+	namespace {
+		void applyRenderState(PipelineConfigInfo& pipelineConfig, const RenderStateComponent& renderState) {
+			pipelineConfig.rasterizationInfo.cullMode = renderState.cullMode;
+			pipelineConfig.rasterizationInfo.frontFace = renderState.frontFace;
+			pipelineConfig.rasterizationInfo.polygonMode = renderState.polygonMode;
+			pipelineConfig.inputAssemblyInfo.topology = renderState.topology;
+			pipelineConfig.depthStencilInfo.depthTestEnable = renderState.depthTestEnable;
+			pipelineConfig.depthStencilInfo.depthWriteEnable = renderState.depthWriteEnable;
+			pipelineConfig.depthStencilInfo.depthCompareOp = renderState.depthCompareOp;
+		}
+
+		// without dynamicPrimitiveTopologyUnrestricted the topology set at record time must be of
+		// the class the pipeline was created with
+		VkPrimitiveTopology topologyClass(VkPrimitiveTopology topology) {
+			switch (topology) {
+			case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+				return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+			case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+			case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+				return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+			case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+				return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+			default:
+				return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			}
+		}
+	}
 
 	SimpleRenderSystem::SimpleRenderSystem(
-		LveDevice& device, VkRenderPass renderPass,
-		VkDescriptorSetLayout globalSetLayout)
-		: _lveDevice{device} 
+		LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+		LvePipelineStateCache& pipelineStateCache,
+		const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout,
+		bool allowExtendedDynamicState)
+		: _lveDevice{device}, _pipelineStateCache{ pipelineStateCache }, _target{ target },
+		_useExtendedDynamicState{ allowExtendedDynamicState && device.features().extendedDynamicState }
 	{
+		createObjectDescriptors();
 		createPipelineLayout(globalSetLayout);
-		createPipeline(renderPass);
+		createPipeline(pipelineCompiler);
 	}
 
 	SimpleRenderSystem::~SimpleRenderSystem() {
+		// the state cache outlives this system, its pipelines built with the layout go with it
+		_pipelineVariants->clear();
+		_pipelineStateCache.evict(_pipelineLayout);
 		vkDestroyPipelineLayout(_lveDevice.device(), _pipelineLayout, nullptr);
 	}
 
-	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	void SimpleRenderSystem::createObjectDescriptors()
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
+		_objectSetLayout = LveDescriptorSetLayout::Builder(_lveDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.build();
 
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
+		_objectPool = LveDescriptorPool::Builder(_lveDevice)
+			.setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * LveSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		_objectFrames.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+		for (auto& frame : _objectFrames) {
+			if (!_objectPool->allocateDescriptorSet(_objectSetLayout->getDescriptorSetLayout(), frame.descriptorSet)) {
+				throw std::runtime_error("Failed to allocate object descriptor set.");
+			}
+		}
+	}
+
+	void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+	{
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+			globalSetLayout, _objectSetLayout->getDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
 		if (vkCreatePipelineLayout( _lveDevice.device(), &pipelineLayoutInfo, nullptr,
 			&_pipelineLayout) != VK_SUCCESS)
@@ -51,41 +102,345 @@ namespace lve {
 		}
 	}
 
-	void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) 
+	void SimpleRenderSystem::createPipeline(LvePipelineCompiler& pipelineCompiler) 
 	{
 		assert(_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout.");
 
+		LvePipelineTarget target = _target;
+		VkPipelineLayout pipelineLayout = _pipelineLayout;
+		bool useDynamicState = _useExtendedDynamicState;
+		LveDeviceFeatures features = _lveDevice.features();
+		_pipelineVariants = std::make_unique<LvePipelineVariantCache>(pipelineCompiler,
+			"shaders/simple_shader.vert.spv", "shaders/simple_shader.frag.spv",
+			[target, pipelineLayout, useDynamicState, features](PipelineConfigInfo& pipelineConfig) {
+				LvePipeline::setTarget(pipelineConfig, target);
+				pipelineConfig.pipelineLayout = pipelineLayout;
+				if (useDynamicState) {
+					LvePipeline::enableExtendedDynamicState(pipelineConfig, features);
+				}
+			});
+
+		selectVariant(ShaderVariant{});
+	}
+
+	LvePermutationKey SimpleRenderSystem::selectVariant(const ShaderVariant& variant)
+	{
+		assert(variant.maxLights <= static_cast<int32_t>(LveLightClusters::MAX_LIGHTS_PER_CLUSTER)
+			&& "Variant light count exceeds the cluster light lists.");
+
+		LveSpecializationConstants constants{};
+		constants.set(SPEC_MAX_LIGHTS, variant.maxLights);
+		constants.setBool(SPEC_ENABLE_POINT_LIGHTS, variant.enablePointLights);
+		constants.setBool(SPEC_PER_OBJECT_LIGHTS, variant.perObjectLights);
+		_perObjectLights = variant.perObjectLights;
+		_activeVariant = _pipelineVariants->request(constants);
+		_activeConstants = constants;
+		_statePipelines.clear();
+		return _activeVariant;
+	}
+
+	void SimpleRenderSystem::watchShaders(LveShaderHotReloader& hotReloader)
+	{
+		// the state pipelines are rebuilt in place by the state cache, which the owner watches
+		_pipelineVariants->watchShaders(hotReloader);
+	}
+
+	RenderStateComponent SimpleRenderSystem::bakedState(const RenderStateComponent& renderState) const
+	{
+		if (!_useExtendedDynamicState) {
+			return renderState;
+		}
+
+		// everything set at record time collapses to the default, leaving only what is baked
+		RenderStateComponent baked{};
+		baked.topology = topologyClass(renderState.topology);
+		if (!_lveDevice.features().extendedDynamicState3PolygonMode) {
+			baked.polygonMode = renderState.polygonMode;
+		}
+		return baked;
+	}
+
+	LvePipeline& SimpleRenderSystem::getPipelineForState(const RenderStateComponent& renderState)
+	{
+		// the common state is the precompiled variant, anything else is created lazily by the state cache
+		RenderStateComponent baked = bakedState(renderState);
+		if (baked == RenderStateComponent{}) {
+			return _pipelineVariants->get(_activeVariant).wait();
+		}
+
+		for (auto& statePipeline : _statePipelines) {
+			if (statePipeline.first == baked) return statePipeline.second->wait();
+		}
+
 		PipelineConfigInfo pipelineConfig{};
 		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
+		LvePipeline::setTarget(pipelineConfig, _target);
 		pipelineConfig.pipelineLayout = _pipelineLayout;
-		_lvePipeline = std::make_unique<LvePipeline>(_lveDevice,
+		pipelineConfig.specializationConstants = _activeConstants;
+		applyRenderState(pipelineConfig, baked);
+		if (_useExtendedDynamicState) {
+			LvePipeline::enableExtendedDynamicState(pipelineConfig, _lveDevice.features());
+		}
+
+		LvePipelineHandle& pipeline = _pipelineStateCache.getPipeline(
 			"shaders/simple_shader.vert.spv", "shaders/simple_shader.frag.spv", pipelineConfig);
+		_statePipelines.emplace_back(baked, &pipeline);
+		return pipeline.wait();
+	}
+
+	LvePipeline& SimpleRenderSystem::getDepthPipelineForState(const RenderStateComponent& renderState)
+	{
+		RenderStateComponent baked = bakedState(renderState);
+		for (auto& depthPipeline : _depthPipelines) {
+			if (depthPipeline.first == baked) return depthPipeline.second->wait();
+		}
+
+		// reads stream 0 only and writes no color, so the pre-pass fetches 12 bytes per vertex
+		PipelineConfigInfo pipelineConfig{};
+		LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
+		pipelineConfig.bindingDescription = LveModel::Vertex::getPositionBindingDescriptions();
+		pipelineConfig.attributeDescription = LveModel::Vertex::getPositionAttributeDescriptions();
+		pipelineConfig.colorBlendAttachment.colorWriteMask = 0;
+		LvePipeline::setTarget(pipelineConfig, _target);
+		pipelineConfig.pipelineLayout = _pipelineLayout;
+		applyRenderState(pipelineConfig, baked);
+		if (_useExtendedDynamicState) {
+			LvePipeline::enableExtendedDynamicState(pipelineConfig, _lveDevice.features());
+		}
+
+		LvePipelineHandle& pipeline = _pipelineStateCache.getPipeline(
+			"shaders/depth_prepass.vert.spv", "shaders/depth_prepass.frag.spv", pipelineConfig);
+		_depthPipelines.emplace_back(baked, &pipeline);
+		return pipeline.wait();
+	}
+
+	void SimpleRenderSystem::setDynamicState(VkCommandBuffer commandBuffer,
+		const RenderStateComponent& renderState, const RenderStateComponent* previous)
+	{
+		// every pipeline this system binds has the same dynamic states, so values set for one
+		// object stay valid across pipeline binds and only the differences are recorded
+		const auto& features = _lveDevice.features();
+		const auto& vk = _lveDevice.functions();
+		uint32_t changes = 0;
+
+		if (previous == nullptr || previous->cullMode != renderState.cullMode) {
+			vk.cmdSetCullMode(commandBuffer, renderState.cullMode);
+			changes++;
+		}
+		if (previous == nullptr || previous->frontFace != renderState.frontFace) {
+			vk.cmdSetFrontFace(commandBuffer, renderState.frontFace);
+			changes++;
+		}
+		if (previous == nullptr || previous->topology != renderState.topology) {
+			vk.cmdSetPrimitiveTopology(commandBuffer, renderState.topology);
+			changes++;
+		}
+		if (previous == nullptr || previous->depthTestEnable != renderState.depthTestEnable) {
+			vk.cmdSetDepthTestEnable(commandBuffer, renderState.depthTestEnable);
+			changes++;
+		}
+		if (previous == nullptr || previous->depthWriteEnable != renderState.depthWriteEnable) {
+			vk.cmdSetDepthWriteEnable(commandBuffer, renderState.depthWriteEnable);
+			changes++;
+		}
+		if (previous == nullptr || previous->depthCompareOp != renderState.depthCompareOp) {
+			vk.cmdSetDepthCompareOp(commandBuffer, renderState.depthCompareOp);
+			changes++;
+		}
+		if (features.extendedDynamicState2 && previous == nullptr) {
+			// not part of RenderStateComponent, pinned to the defaultPipelineConfigInfo values
+			vk.cmdSetPrimitiveRestartEnable(commandBuffer, VK_FALSE);
+			vk.cmdSetDepthBiasEnable(commandBuffer, VK_FALSE);
+		}
+		if (features.extendedDynamicState3PolygonMode &&
+			(previous == nullptr || previous->polygonMode != renderState.polygonMode)) {
+			vk.cmdSetPolygonMode(commandBuffer, renderState.polygonMode);
+			changes++;
+		}
+
+		if (changes > 0) {
+			_dynamicStateChangeCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void SimpleRenderSystem::collectDrawItems(FrameInfo& frameInfo)
+	{
+		_drawItems.clear();
+		_frameStates.clear();
+
+		auto stateIndexOf = [this](const RenderStateComponent& renderState) {
+			// scenes use a handful of states, a linear scan beats hashing the component
+			uint32_t stateIndex = 0;
+			while (stateIndex < _frameStates.size() && _frameStates[stateIndex] != renderState) {
+				stateIndex++;
+			}
+			if (stateIndex == _frameStates.size()) {
+				_frameStates.push_back(renderState);
+			}
+			return stateIndex;
+		};
+
+		auto addObject = [this, &stateIndexOf](LveGameObject& obj) {
+			const RenderStateComponent& renderState = obj.renderState;
+			if (!_depthPrepass || !renderState.depthTestEnable || !renderState.depthWriteEnable) {
+				_drawItems.push_back({ &obj, stateIndexOf(renderState), NO_PREPASS });
+				return;
+			}
+
+			// the pre-pass lays down depth with the object's own state, the shaded pass then only
+			// runs the fragment shader where its depth matches exactly
+			RenderStateComponent shadedState = renderState;
+			shadedState.depthCompareOp = VK_COMPARE_OP_EQUAL;
+			shadedState.depthWriteEnable = VK_FALSE;
+			_drawItems.push_back({ &obj, stateIndexOf(shadedState), stateIndexOf(renderState) });
+		};
+
+		if (frameInfo.visibleObjects != nullptr) {
+			for (LveGameObject* obj : *frameInfo.visibleObjects) {
+				addObject(*obj);
+			}
+		}
+		else {
+			for (auto& kv : frameInfo.gameObjects) {
+				if (kv.second.model == nullptr) continue;
+				addObject(kv.second);
+			}
+		}
+	}
+
+	SimpleRenderSystem::ObjectFrame& SimpleRenderSystem::getObjectFrame(int frameIndex, uint32_t objectCount)
+	{
+		// the fence for this frame index was waited on in beginFrame, so the old buffer is free
+		auto& frame = _objectFrames[frameIndex];
+		if (frame.objectBuffer == nullptr || frame.objectBuffer->getInstanceCount() < objectCount) {
+			uint32_t capacity = frame.objectBuffer == nullptr ? 256 : frame.objectBuffer->getInstanceCount();
+			while (capacity < objectCount) {
+				capacity *= 2;
+			}
+
+			frame.objectBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(PackedTransform), capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.objectBuffer->map();
+
+			frame.lightBuffer = std::make_unique<LveBuffer>(
+				_lveDevice, sizeof(glm::uvec4), capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			frame.lightBuffer->map();
+
+			auto bufferInfo = frame.objectBuffer->descriptorInfo();
+			auto lightInfo = frame.lightBuffer->descriptorInfo();
+			LveDescriptorWriter(*_objectSetLayout, *_objectPool)
+				.writeBuffer(0, &bufferInfo)
+				.writeBuffer(1, &lightInfo)
+				.overwrite(frame.descriptorSet);
+		}
+		return frame;
+	}
+
+	void SimpleRenderSystem::selectObjectLights(FrameInfo& frameInfo)
+	{
+		_itemLights.assign(_drawItems.size(), glm::uvec4{ 0xffffffffu });
+		if (!_perObjectLights || frameInfo.lightBvh == nullptr) return;
+
+		LveLightBvh& lightBvh = *frameInfo.lightBvh;
+		assert(lightBvh.getStats().lights <= NO_LIGHT && "Too many lights for 16-bit light indices.");
+
+		std::array<uint32_t, MAX_OBJECT_LIGHTS> selected;
+		for (uint32_t i = 0; i < _drawItems.size(); ++i) {
+			// same world space bounds as LveObjectCuller
+			LveGameObject& obj = *_drawItems[i].object;
+			const glm::vec4& sphere = obj.model->getBoundingSphere();
+			glm::vec3 scale = glm::abs(obj.transform.scale);
+			float maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+			glm::vec3 center = glm::vec3(obj.transform.mat4() * glm::vec4(glm::vec3(sphere), 1.f));
+
+			uint32_t count = lightBvh.selectLights(center, sphere.w * maxScale, MAX_OBJECT_LIGHTS, selected.data());
+			glm::uvec4& packed = _itemLights[i];
+			for (uint32_t k = 0; k < count; ++k) {
+				uint32_t shift = 16 * (k % 2);
+				packed[k / 2] = (packed[k / 2] & ~(NO_LIGHT << shift)) | (selected[k] << shift);
+			}
+		}
 	}
 
-	void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) 
+	void SimpleRenderSystem::submit(FrameInfo& frameInfo, LveDrawQueue& drawQueue)
 	{
-		_lvePipeline->bind(frameInfo.commandBuffer);
+		_instanceCount = 0;
+		_drawCallCount = 0;
+		_dynamicStateChangeCount = 0;
+		collectDrawItems(frameInfo);
+		if (_drawItems.empty()) return;
+		selectObjectLights(frameInfo);
+
+		// every packet gets its own transform slot, pre-pass packets included
+		uint32_t packetCount = 0;
+		for (const auto& item : _drawItems) {
+			packetCount += item.prepassStateIndex == NO_PREPASS ? 1 : 2;
+		}
+		_frameObjects = &getObjectFrame(frameInfo.frameIndex, packetCount);
 
+		// the state index doubles as the material, so objects sharing a state stay adjacent
+		const glm::mat4& view = frameInfo.camera.getView();
+		for (uint32_t i = 0; i < _drawItems.size(); ++i) {
+			const DrawItem& item = _drawItems[i];
+			LveGameObject& obj = *item.object;
+			uint32_t modelSlot = drawQueue.modelSlot(*obj.model);
+			uint32_t depth = LveDrawQueue::quantizeDepth((view * glm::vec4(obj.transform.translation, 1.f)).z);
+
+			if (item.prepassStateIndex != NO_PREPASS) {
+				LvePipeline& depthPipeline = getDepthPipelineForState(_frameStates[item.prepassStateIndex]);
+				drawQueue.submit(LveDrawQueue::makeKey(
+					LveDrawQueue::PASS_DEPTH_PREPASS,
+					drawQueue.pipelineSlot(depthPipeline, *this),
+					item.prepassStateIndex, modelSlot, depth), i);
+			}
+
+			// the scene has no fallback look, block until the worker finishes the compile
+			LvePipeline& pipeline = getPipelineForState(_frameStates[item.stateIndex]);
+			drawQueue.submit(LveDrawQueue::makeKey(
+				LveDrawQueue::PASS_OPAQUE,
+				drawQueue.pipelineSlot(pipeline, *this),
+				item.stateIndex, modelSlot, depth), i);
+		}
+	}
+
+	void SimpleRenderSystem::onPipelineBound(FrameInfo& frameInfo)
+	{
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.globalDescriptorSet, _frameObjects->descriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			_pipelineLayout, 
-			0, 1, &frameInfo.globalDescriptorSet,
+			0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(),
 			0, nullptr);
+	}
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-			if (obj.model == nullptr) continue;
-			SimplePushConstantData push{};
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(frameInfo.commandBuffer,
-				_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0, sizeof(SimplePushConstantData), &push);
+	void SimpleRenderSystem::drawPackets(FrameInfo& frameInfo, const LveDrawRun& run)
+	{
+		// transforms sit at the run's position among this system's sorted packets, so runs are
+		// contiguous in the buffer whichever thread records them and firstInstance indexes them
+		auto* objects = static_cast<PackedTransform*>(_frameObjects->objectBuffer->getMappedMemory()) + run.clientIndex;
+		auto* objectLights = static_cast<glm::uvec4*>(_frameObjects->lightBuffer->getMappedMemory()) + run.clientIndex;
+		for (uint32_t i = 0; i < run.count; ++i) {
+			objects[i] = _drawItems[run.packets[i].payload].object->transform.packed();
+			objectLights[i] = _itemLights[run.packets[i].payload];
+		}
 
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+		if (_useExtendedDynamicState) {
+			// another client's pipeline may have baked the states in between, the queue then
+			// reports no previous packet
+			const RenderStateComponent* previous = run.previous != nullptr
+				? &_frameStates[LveDrawQueue::keyMaterial(run.previous->key)] : nullptr;
+			setDynamicState(frameInfo.commandBuffer,
+				_frameStates[LveDrawQueue::keyMaterial(run.packets[0].key)], previous);
 		}
+
+		LveModel& model = *_drawItems[run.packets[0].payload].object->model;
+		model.draw(frameInfo.commandBuffer, run.count, run.clientIndex);
+
+		_instanceCount.fetch_add(run.count, std::memory_order_relaxed);
+		_drawCallCount.fetch_add(1, std::memory_order_relaxed);
 	}
 }
\ No newline at end of file
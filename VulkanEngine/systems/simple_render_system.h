@@ -1,33 +1,148 @@
 #pragma once
 
 #include "lve_device.h"
+#include "lve_buffer.h"
 #include "lve_camera.h"
+#include "lve_descriptors.h"
+#include "lve_draw_queue.h"
 #include "lve_game_object.h"
 #include "lve_pipeline.h"
+#include "lve_pipeline_compiler.h"
+#include "lve_pipeline_variants.h"
+#include "lve_pipeline_state_cache.h"
 #include "lve_frame_info.h"
+#include "lve_light_bvh.h"
+#include "lve_light_clusters.h"
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
 namespace lve {
-	class SimpleRenderSystem {
+	class SimpleRenderSystem : public LveDrawQueueClient {
 	public:
-		SimpleRenderSystem(LveDevice& device, VkRenderPass renderPass,
-			VkDescriptorSetLayout globalSetLayout);
+		// Specialization constant ids declared in simple_shader.frag
+		static constexpr uint32_t SPEC_MAX_LIGHTS = 0;
+		static constexpr uint32_t SPEC_ENABLE_POINT_LIGHTS = 1;
+		static constexpr uint32_t SPEC_PER_OBJECT_LIGHTS = 2;
+
+		// per-object light lists hold this many 16-bit light indices in a uvec4, NO_LIGHT ends a list
+		static constexpr uint32_t MAX_OBJECT_LIGHTS = 8;
+		static constexpr uint32_t NO_LIGHT = 0xffff;
+
+		struct ShaderVariant {
+			// lights shaded per cluster
+			int32_t maxLights = LveLightClusters::MAX_LIGHTS_PER_CLUSTER;
+			bool enablePointLights = true;
+			// shade each object's MAX_OBJECT_LIGHTS most influential lights from FrameInfo::lightBvh
+			// instead of the cluster lists
+			bool perObjectLights = false;
+		};
+
+		// Counters for the last frame, pipeline binds are counted by the draw queue
+		struct RenderStats {
+			uint32_t instances = 0;
+			uint32_t drawCalls = 0;
+			uint32_t dynamicStateChanges = 0;
+		};
+
+		SimpleRenderSystem(LveDevice& device, LvePipelineCompiler& pipelineCompiler,
+			LvePipelineStateCache& pipelineStateCache,
+			const LvePipelineTarget& target, VkDescriptorSetLayout globalSetLayout,
+			bool allowExtendedDynamicState = true);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
-		void renderGameObjects(FrameInfo& frameInfo);
+		// Queues one packet per object, objects sharing pipeline, state and model become one
+		// instanced draw when the queue executes.
+		void submit(FrameInfo& frameInfo, LveDrawQueue& drawQueue);
+
+		void onPipelineBound(FrameInfo& frameInfo) override;
+		void drawPackets(FrameInfo& frameInfo, const LveDrawRun& run) override;
+
+		// Requests the variant (compiling it in the background if new) and renders with it from now on.
+		LvePermutationKey selectVariant(const ShaderVariant& variant);
+		LvePermutationKey getActiveVariant() const { return _activeVariant; }
+		LvePipelineVariantCache& getPipelineVariants() { return *_pipelineVariants; }
+
+		// The reloader must stay alive until the system is destroyed.
+		void watchShaders(LveShaderHotReloader& hotReloader);
+
+		// Draws depth for every depth-writing object first with a position-only pipeline, then shades
+		// with depthCompareOp EQUAL and depth writes off so each pixel runs the light loop once.
+		void setDepthPrepassEnabled(bool enabled) { _depthPrepass = enabled; }
+		bool isDepthPrepassEnabled() const { return _depthPrepass; }
+
+		bool usesExtendedDynamicState() const { return _useExtendedDynamicState; }
+		RenderStats getRenderStats() const {
+			return { _instanceCount.load(), _drawCallCount.load(), _dynamicStateChangeCount.load() };
+		}
+		// Distinct pipelines the render states have resolved to for the active variant
+		size_t getPipelineCount() const { return 1 + _statePipelines.size(); }
 
 	private:
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipeline(LvePipelineCompiler& pipelineCompiler);
+		LvePipeline& getPipelineForState(const RenderStateComponent& renderState);
+		LvePipeline& getDepthPipelineForState(const RenderStateComponent& renderState);
+		RenderStateComponent bakedState(const RenderStateComponent& renderState) const;
+		void setDynamicState(VkCommandBuffer commandBuffer,
+			const RenderStateComponent& renderState, const RenderStateComponent* previous);
+		void collectDrawItems(FrameInfo& frameInfo);
+		void selectObjectLights(FrameInfo& frameInfo);
+		void createObjectDescriptors();
+
+		// per-object transforms and light lists read by the vertex shader through gl_InstanceIndex,
+		// one set of buffers per frame in flight so a frame never overwrites in-flight data
+		struct ObjectFrame {
+			std::unique_ptr<LveBuffer> objectBuffer;
+			std::unique_ptr<LveBuffer> lightBuffer;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+		ObjectFrame& getObjectFrame(int frameIndex, uint32_t objectCount);
+
+		static constexpr uint32_t NO_PREPASS = UINT32_MAX;
+
+		// one entry per object, packet payloads index into these
+		struct DrawItem {
+			LveGameObject* object;
+			uint32_t stateIndex;
+			// state of the depth pre-pass draw, NO_PREPASS when the object has none
+			uint32_t prepassStateIndex;
+		};
 
 		LveDevice& _lveDevice;
+		LvePipelineStateCache& _pipelineStateCache;
+		LvePipelineTarget _target;
+		bool _useExtendedDynamicState;
+
+		// written by drawPackets, which may run on several recording threads at once
+		std::atomic<uint32_t> _instanceCount{ 0 };
+		std::atomic<uint32_t> _drawCallCount{ 0 };
+		std::atomic<uint32_t> _dynamicStateChangeCount{ 0 };
+
+		std::unique_ptr<LvePipelineVariantCache> _pipelineVariants;
+		LvePermutationKey _activeVariant{ 0 };
+		LveSpecializationConstants _activeConstants{};
+
+		// per-system memo in front of the state cache keyed by baked state, so hashing only
+		// happens for new states. Holds the handles, hot reload swaps the pipelines inside.
+		std::vector<std::pair<RenderStateComponent, LvePipelineHandle*>> _statePipelines;
+		std::vector<std::pair<RenderStateComponent, LvePipelineHandle*>> _depthPipelines;
+		bool _depthPrepass = false;
 
-		std::unique_ptr<LvePipeline> _lvePipeline;
+		// per-frame scratch, kept to reuse its capacity
+		std::vector<DrawItem> _drawItems;
+		std::vector<RenderStateComponent> _frameStates;
+		// packed light list of each draw item
+		std::vector<glm::uvec4> _itemLights;
+		bool _perObjectLights = false;
+		std::unique_ptr<LveDescriptorSetLayout> _objectSetLayout;
+		std::unique_ptr<LveDescriptorPool> _objectPool;
+		std::vector<ObjectFrame> _objectFrames;
+		ObjectFrame* _frameObjects = nullptr;
 		VkPipelineLayout _pipelineLayout;
 	};
 }
\ No newline at end of file